@@ -0,0 +1,624 @@
+/* bench/bench_parser.c - Per-stage parsing benchmark outside PostgreSQL
+ *
+ * Replays names through the extension's parsing path (tokenizer, feature
+ * extraction, attribute lookup, state scoring and Viterbi) and reports the
+ * time and heap allocations of each stage as JSON. The tokenizer and feature
+ * extractor are the extension's own sources built against bench/shim.
+ * Allocations are counted by wrapping malloc, calloc and realloc at link
+ * time (-Wl,--wrap), so they include those made inside CRFsuite.
+ */
+#define _GNU_SOURCE
+#include "feature_extractor.h"
+#include "name_features.h"
+#include "name_tokenizer.h"
+#include "training_data_parser.h"
+
+#include <crfsuite.h>
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_MODEL "include/generic_learned_settings.crfsuite"
+#define DEFAULT_PASSES 5
+#define DEFAULT_THRESHOLD 10.0
+
+/* Latency histogram: 64 buckets per power of two (about 1.1% wide) up to
+ * 2^40 ns, so percentiles need no per-sample storage */
+#define BUCKETS_PER_OCTAVE 64
+#define NUM_BUCKETS (40 * BUCKETS_PER_OCTAVE)
+
+typedef enum {
+  STAGE_TOKENIZE,
+  STAGE_FEATURES,
+  STAGE_LOOKUP,
+  STAGE_SCORE,
+  STAGE_VITERBI,
+  STAGE_TOTAL,
+  NUM_STAGES
+} Stage;
+
+static const char *const stage_names[NUM_STAGES] = {
+    "tokenize", "features", "lookup", "score", "viterbi", "total"};
+
+typedef struct {
+  unsigned long long ops;
+  double total_ns;
+  double max_ns;
+  unsigned long long allocations;
+  unsigned long long histogram[NUM_BUCKETS];
+} StageStats;
+
+/* Baseline values of one stage */
+typedef struct {
+  int found;
+  double ns_per_op;
+  double p99_ns;
+  double allocs_per_op;
+} BaselineStage;
+
+/* Heap allocations so far, counted by the --wrap'ed allocators */
+static unsigned long long allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  allocations++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+  allocations++;
+  return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+  allocations++;
+  return __real_realloc(pointer, size);
+}
+
+static void print_usage(const char *prog) {
+  printf("Usage: %s [options] [names.xml|names.txt ...]\n", prog);
+  printf("\nTime the extension's parsing stages on names read from labeled "
+         "XML files or\ntext files with one name per line (default: "
+         "name_data/*.xml) and print the\nresults as JSON.\n");
+  printf("\nOptions:\n");
+  printf("  -m, --model FILE       Model to tag with (default: %s)\n",
+         DEFAULT_MODEL);
+  printf("  -n, --passes N         Timed passes over the names (default: "
+         "%d)\n",
+         DEFAULT_PASSES);
+  printf("  -o, --output FILE      Write the JSON to FILE instead of "
+         "stdout\n");
+  printf("  -b, --baseline FILE    Compare with a saved result and exit 1 "
+         "on regressions\n");
+  printf("  -t, --threshold PCT    Slowdown of ns/op that counts as a "
+         "regression\n                         (default: %.0f)\n",
+         DEFAULT_THRESHOLD);
+  printf("  -h, --help             Show this help message\n");
+}
+
+static double elapsed_ns(const struct timespec *start,
+                         const struct timespec *end) {
+  return (end->tv_sec - start->tv_sec) * 1e9 +
+         (end->tv_nsec - start->tv_nsec);
+}
+
+static void record(StageStats *stats, double ns,
+                   unsigned long long allocs) {
+  int bucket = ns >= 1 ? (int)(log2(ns) * BUCKETS_PER_OCTAVE) : 0;
+
+  if (bucket >= NUM_BUCKETS)
+    bucket = NUM_BUCKETS - 1;
+  stats->histogram[bucket]++;
+  stats->ops++;
+  stats->total_ns += ns;
+  stats->allocations += allocs;
+  if (ns > stats->max_ns)
+    stats->max_ns = ns;
+}
+
+/* Latency below which a share q of the operations fall (bucket midpoint) */
+static double percentile(const StageStats *stats, double q) {
+  unsigned long long rank = (unsigned long long)ceil(q * stats->ops);
+  unsigned long long seen = 0;
+
+  for (int b = 0; b < NUM_BUCKETS; b++) {
+    seen += stats->histogram[b];
+    if (seen >= rank && seen > 0)
+      return exp2((b + 0.5) / BUCKETS_PER_OCTAVE);
+  }
+  return stats->max_ns;
+}
+
+/* Names to replay */
+typedef struct {
+  char **names;
+  int num_names;
+  int capacity;
+} NameList;
+
+static int add_name(NameList *list, char *name) {
+  if (list->num_names == list->capacity) {
+    int capacity = list->capacity ? list->capacity * 2 : 1024;
+    char **names = realloc(list->names, capacity * sizeof(char *));
+
+    if (!names)
+      return -1;
+    list->names = names;
+    list->capacity = capacity;
+  }
+  list->names[list->num_names++] = name;
+  return 0;
+}
+
+/* Labeled XML: each sequence's tokens joined by single spaces */
+static int read_xml_names(const char *filename, NameList *list) {
+  TrainingData *data = parse_training_file(filename);
+
+  if (!data) {
+    fprintf(stderr, "Error: Failed to parse %s\n", filename);
+    return -1;
+  }
+  for (int i = 0; i < data->num_sequences; i++) {
+    LabeledSequence *seq = &data->sequences[i];
+    size_t len = 0;
+    char *name;
+
+    for (int j = 0; j < seq->num_tokens; j++)
+      len += strlen(seq->tokens[j].text) + 1;
+    name = malloc(len + 1);
+    if (!name)
+      goto oom;
+    name[0] = '\0';
+    for (int j = 0; j < seq->num_tokens; j++) {
+      if (j > 0)
+        strcat(name, " ");
+      strcat(name, seq->tokens[j].text);
+    }
+    if (add_name(list, name) != 0) {
+      free(name);
+      goto oom;
+    }
+  }
+  free_training_data(data);
+  return 0;
+
+oom:
+  fprintf(stderr, "Error: Out of memory\n");
+  free_training_data(data);
+  return -1;
+}
+
+/* Plain text: one name per line, blank lines skipped */
+static int read_text_names(const char *filename, NameList *list) {
+  FILE *fp = fopen(filename, "r");
+  char *line = NULL;
+  size_t size = 0;
+  ssize_t len;
+
+  if (!fp) {
+    fprintf(stderr, "Error: Could not open %s\n", filename);
+    return -1;
+  }
+  while ((len = getline(&line, &size, fp)) != -1) {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+      line[--len] = '\0';
+    if (len == 0)
+      continue;
+    if (add_name(list, strdup(line)) != 0 ||
+        list->names[list->num_names - 1] == NULL) {
+      fprintf(stderr, "Error: Out of memory\n");
+      free(line);
+      fclose(fp);
+      return -1;
+    }
+  }
+  free(line);
+  fclose(fp);
+  return 0;
+}
+
+static int read_names(const char *filename, NameList *list) {
+  size_t len = strlen(filename);
+
+  if (len > 4 && strcmp(filename + len - 4, ".xml") == 0)
+    return read_xml_names(filename, list);
+  return read_text_names(filename, list);
+}
+
+/* Per-name scratch space, grown outside the timed stages */
+typedef struct {
+  NameFeatureList *features;
+  const char **texts;
+  int *labels;
+  int capacity;
+} Scratch;
+
+static int reserve(Scratch *scratch, int num_tokens) {
+  if (num_tokens <= scratch->capacity)
+    return 0;
+  free(scratch->features);
+  free(scratch->texts);
+  free(scratch->labels);
+  scratch->features = malloc(num_tokens * sizeof(NameFeatureList));
+  scratch->texts = malloc(num_tokens * sizeof(const char *));
+  scratch->labels = malloc(num_tokens * sizeof(int));
+  scratch->capacity = num_tokens;
+  return scratch->features && scratch->texts && scratch->labels ? 0 : -1;
+}
+
+/*
+ * Parse one name, timing each stage into stats (if not NULL)
+ *
+ * The features and lookup stages split create_crf_instance_from_tokens in
+ * two: features builds the attribute strings of every token, and lookup maps
+ * them to model IDs and appends them to the instance.
+ */
+static int parse_one(const char *name, crfsuite_dictionary_t *attrs,
+                     uint64_t templates, crfsuite_tagger_t *tagger,
+                     Scratch *scratch, StageStats *stats) {
+  struct timespec t[NUM_STAGES];
+  unsigned long long allocs[NUM_STAGES];
+  struct timespec end;
+  crfsuite_instance_t instance;
+  TokenInfo *tokens;
+  floatval_t score;
+  int num_tokens;
+  bool truncated;
+  int s = 0;
+
+  /* Tokenize */
+  allocs[s] = allocations;
+  clock_gettime(CLOCK_MONOTONIC, &t[s++]);
+  tokens = tokenize_name_string(name, 0, 0, &num_tokens, &truncated);
+  allocs[s] = allocations;
+  clock_gettime(CLOCK_MONOTONIC, &t[s++]);
+  if (tokens == NULL || num_tokens == 0)
+    return 0;
+  if (reserve(scratch, num_tokens) != 0) {
+    free_token_info_array(tokens, num_tokens);
+    return -1;
+  }
+
+  /* Feature strings */
+  for (int i = 0; i < num_tokens; i++)
+    scratch->texts[i] = tokens[i].text;
+  for (int i = 0; i < num_tokens; i++)
+    extract_name_features(scratch->texts, num_tokens, i, templates,
+                          &scratch->features[i]);
+  allocs[s] = allocations;
+  clock_gettime(CLOCK_MONOTONIC, &t[s++]);
+
+  /* Attribute lookup into a CRFsuite instance */
+  crfsuite_instance_init(&instance);
+  for (int i = 0; i < num_tokens; i++) {
+    NameFeatureList *features = &scratch->features[i];
+    crfsuite_item_t item;
+
+    crfsuite_item_init(&item);
+    for (int j = 0; j < features->num_features; j++) {
+      int aid = attrs->to_id(attrs, features->features[j].name);
+
+      if (aid >= 0) {
+        crfsuite_attribute_t attr;
+
+        crfsuite_attribute_set(&attr, aid, features->features[j].value);
+        crfsuite_item_append_attribute(&item, &attr);
+      }
+    }
+    crfsuite_instance_append(&instance, &item, 0);
+    crfsuite_item_finish(&item);
+  }
+  allocs[s] = allocations;
+  clock_gettime(CLOCK_MONOTONIC, &t[s++]);
+
+  /* State scoring */
+  tagger->set(tagger, &instance);
+  allocs[s] = allocations;
+  clock_gettime(CLOCK_MONOTONIC, &t[s++]);
+
+  /* Viterbi */
+  tagger->viterbi(tagger, scratch->labels, &score);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  if (stats) {
+    unsigned long long now = allocations;
+
+    for (int i = 0; i < STAGE_TOTAL; i++) {
+      const struct timespec *stop = i + 1 < STAGE_TOTAL ? &t[i + 1] : &end;
+      unsigned long long until = i + 1 < STAGE_TOTAL ? allocs[i + 1] : now;
+
+      record(&stats[i], elapsed_ns(&t[i], stop), until - allocs[i]);
+    }
+    record(&stats[STAGE_TOTAL], elapsed_ns(&t[0], &end), now - allocs[0]);
+  }
+
+  crfsuite_instance_finish(&instance);
+  free_token_info_array(tokens, num_tokens);
+  return 0;
+}
+
+static void write_json(FILE *fp, const char *model_file, int num_names,
+                       long long num_tokens, int passes,
+                       const StageStats *stats) {
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"model\": \"%s\",\n", model_file);
+  fprintf(fp, "  \"names\": %d,\n", num_names);
+  fprintf(fp, "  \"tokens\": %lld,\n", num_tokens);
+  fprintf(fp, "  \"passes\": %d,\n", passes);
+  fprintf(fp, "  \"stages\": {\n");
+  for (int i = 0; i < NUM_STAGES; i++) {
+    const StageStats *st = &stats[i];
+    double ops = st->ops > 0 ? (double)st->ops : 1;
+
+    fprintf(fp,
+            "    \"%s\": {\"ops\": %llu, \"ns_per_op\": %.1f, "
+            "\"p50_ns\": %.0f, \"p90_ns\": %.0f, \"p99_ns\": %.0f, "
+            "\"max_ns\": %.0f, \"allocs_per_op\": %.2f}%s\n",
+            stage_names[i], st->ops, st->total_ns / ops,
+            percentile(st, 0.50), percentile(st, 0.90), percentile(st, 0.99),
+            st->max_ns, st->allocations / ops,
+            i + 1 < NUM_STAGES ? "," : "");
+  }
+  fprintf(fp, "  }\n}\n");
+}
+
+/* Value of "key": in text, or -1 if missing */
+static double json_number(const char *text, const char *key) {
+  char pattern[64];
+  const char *p;
+
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+  p = strstr(text, pattern);
+  return p ? strtod(p + strlen(pattern), NULL) : -1;
+}
+
+/* Read the stage values of a result written by write_json */
+static int read_baseline(const char *filename, BaselineStage *baseline) {
+  FILE *fp = fopen(filename, "r");
+  char *text;
+  long size;
+
+  if (!fp) {
+    fprintf(stderr, "Error: Could not open baseline %s\n", filename);
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  text = malloc(size + 1);
+  if (!text || fread(text, 1, size, fp) != (size_t)size) {
+    fprintf(stderr, "Error: Could not read baseline %s\n", filename);
+    free(text);
+    fclose(fp);
+    return -1;
+  }
+  text[size] = '\0';
+  fclose(fp);
+
+  for (int i = 0; i < NUM_STAGES; i++) {
+    char pattern[64];
+    const char *stage;
+    char *end;
+
+    memset(&baseline[i], 0, sizeof(BaselineStage));
+    snprintf(pattern, sizeof(pattern), "\"%s\": {", stage_names[i]);
+    stage = strstr(text, pattern);
+    if (!stage)
+      continue;
+    end = strchr(stage, '}');
+    if (end)
+      *end = '\0';
+    baseline[i].found = 1;
+    baseline[i].ns_per_op = json_number(stage, "ns_per_op");
+    baseline[i].p99_ns = json_number(stage, "p99_ns");
+    baseline[i].allocs_per_op = json_number(stage, "allocs_per_op");
+    if (end)
+      *end = '}';
+  }
+  free(text);
+  return 0;
+}
+
+/* Print a comparison table to stderr; returns the number of regressions
+ *
+ * A stage regresses when its mean time grows by more than threshold percent
+ * or it allocates more per operation. Percentiles are shown but not judged,
+ * since a single pass makes them noisy.
+ */
+static int compare_baseline(const BaselineStage *baseline,
+                            const StageStats *stats, double threshold) {
+  int regressions = 0;
+
+  fprintf(stderr, "\n%-10s %12s %12s %8s %10s %10s %11s %9s\n", "stage",
+          "base ns/op", "ns/op", "change", "base p99", "p99", "base allocs",
+          "allocs");
+  for (int i = 0; i < NUM_STAGES; i++) {
+    const StageStats *st = &stats[i];
+    double ops = st->ops > 0 ? (double)st->ops : 1;
+    double ns = st->total_ns / ops, allocs = st->allocations / ops;
+    double change;
+    int slower, more_allocs;
+
+    if (!baseline[i].found || baseline[i].ns_per_op <= 0) {
+      fprintf(stderr, "%-10s %12s %12.1f\n", stage_names[i], "-", ns);
+      continue;
+    }
+    change = 100.0 * (ns - baseline[i].ns_per_op) / baseline[i].ns_per_op;
+    slower = change > threshold;
+    more_allocs = allocs > baseline[i].allocs_per_op + 0.005;
+    fprintf(stderr,
+            "%-10s %12.1f %12.1f %+7.1f%% %10.0f %10.0f %11.2f %9.2f%s\n",
+            stage_names[i], baseline[i].ns_per_op, ns, change,
+            baseline[i].p99_ns, percentile(st, 0.99),
+            baseline[i].allocs_per_op, allocs,
+            slower || more_allocs ? "  REGRESSION" : "");
+    regressions += slower || more_allocs;
+  }
+  return regressions;
+}
+
+int main(int argc, char *argv[]) {
+  static char *default_files[] = {"name_data/person_labeled.xml",
+                                  "name_data/company_labeled.xml"};
+  const char *model_file = DEFAULT_MODEL;
+  const char *output_file = NULL;
+  const char *baseline_file = NULL;
+  double threshold = DEFAULT_THRESHOLD;
+  int passes = DEFAULT_PASSES;
+  char **files;
+  int num_files;
+  NameList list = {0};
+  Scratch scratch = {0};
+  StageStats *stats;
+  BaselineStage baseline[NUM_STAGES];
+  crfsuite_model_t *model = NULL;
+  crfsuite_dictionary_t *attrs = NULL;
+  crfsuite_tagger_t *tagger = NULL;
+  uint64_t templates;
+  long long num_tokens = 0;
+  FILE *out = stdout;
+  int ret = 1;
+
+  static struct option long_options[] = {
+      {"model", required_argument, 0, 'm'},
+      {"passes", required_argument, 0, 'n'},
+      {"output", required_argument, 0, 'o'},
+      {"baseline", required_argument, 0, 'b'},
+      {"threshold", required_argument, 0, 't'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "m:n:o:b:t:h", long_options,
+                            NULL)) != -1) {
+    switch (opt) {
+    case 'm':
+      model_file = optarg;
+      break;
+    case 'n':
+      passes = atoi(optarg);
+      break;
+    case 'o':
+      output_file = optarg;
+      break;
+    case 'b':
+      baseline_file = optarg;
+      break;
+    case 't':
+      threshold = atof(optarg);
+      break;
+    case 'h':
+      print_usage(argv[0]);
+      return 0;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (passes < 1) {
+    fprintf(stderr, "Error: --passes must be at least 1\n");
+    return 1;
+  }
+  if (optind < argc) {
+    files = &argv[optind];
+    num_files = argc - optind;
+  } else {
+    files = default_files;
+    num_files = 2;
+  }
+
+  if (baseline_file && read_baseline(baseline_file, baseline) != 0)
+    return 1;
+
+  stats = calloc(NUM_STAGES, sizeof(StageStats));
+  if (!stats) {
+    fprintf(stderr, "Error: Out of memory\n");
+    return 1;
+  }
+
+  for (int i = 0; i < num_files; i++) {
+    if (read_names(files[i], &list) != 0)
+      goto cleanup;
+  }
+  if (list.num_names == 0) {
+    fprintf(stderr, "Error: No names to replay\n");
+    goto cleanup;
+  }
+
+  if (crfsuite_create_instance_from_file(model_file, (void **)&model) != 0) {
+    fprintf(stderr, "Error: Could not load model: %s\n", model_file);
+    goto cleanup;
+  }
+  model->get_attrs(model, &attrs);
+  templates = name_model_templates(attrs);
+  if (model->get_tagger(model, &tagger) != 0) {
+    fprintf(stderr, "Error: Could not create a tagger\n");
+    goto cleanup;
+  }
+
+  /* One untimed pass warms caches and sizes the scratch buffers */
+  for (int i = 0; i < list.num_names; i++) {
+    if (parse_one(list.names[i], attrs, templates, tagger, &scratch, NULL) !=
+        0)
+      goto oom;
+  }
+
+  for (int pass = 0; pass < passes; pass++) {
+    for (int i = 0; i < list.num_names; i++) {
+      unsigned long long before = stats[STAGE_TOTAL].ops;
+
+      if (parse_one(list.names[i], attrs, templates, tagger, &scratch,
+                    stats) != 0)
+        goto oom;
+      if (pass == 0 && stats[STAGE_TOTAL].ops > before)
+        num_tokens += tagger->length(tagger);
+    }
+  }
+
+  if (output_file) {
+    out = fopen(output_file, "w");
+    if (!out) {
+      fprintf(stderr, "Error: Could not open %s for writing\n", output_file);
+      goto cleanup;
+    }
+  }
+  write_json(out, model_file, list.num_names, num_tokens, passes, stats);
+  if (out != stdout)
+    fclose(out);
+
+  ret = 0;
+  if (baseline_file) {
+    int regressions = compare_baseline(baseline, stats, threshold);
+
+    if (regressions > 0) {
+      fprintf(stderr, "%d stage%s regressed against %s\n", regressions,
+              regressions == 1 ? "" : "s", baseline_file);
+      ret = 1;
+    }
+  }
+  goto cleanup;
+
+oom:
+  fprintf(stderr, "Error: Out of memory\n");
+cleanup:
+  if (tagger)
+    tagger->release(tagger);
+  if (model)
+    model->release(model);
+  for (int i = 0; i < list.num_names; i++)
+    free(list.names[i]);
+  free(list.names);
+  free(scratch.features);
+  free(scratch.texts);
+  free(scratch.labels);
+  free(stats);
+  return ret;
+}
@@ -0,0 +1,48 @@
+/* bench/pg_shim.c - palloc and friends on top of malloc for bench_parser */
+#include "postgres.h"
+#include "mb/pg_wchar.h"
+
+#include <stdio.h>
+
+static void *check(void *pointer, size_t size) {
+  if (pointer == NULL) {
+    fprintf(stderr, "Error: Out of memory allocating %zu bytes\n", size);
+    abort();
+  }
+  return pointer;
+}
+
+void *palloc(size_t size) { return check(malloc(size), size); }
+
+void *palloc0(size_t size) { return check(calloc(1, size), size); }
+
+void *repalloc(void *pointer, size_t size) {
+  return check(realloc(pointer, size), size);
+}
+
+void pfree(void *pointer) { free(pointer); }
+
+char *pstrdup(const char *in) {
+  size_t len = strlen(in) + 1;
+
+  return memcpy(palloc(len), in, len);
+}
+
+char *pnstrdup(const char *in, size_t len) {
+  char *out;
+
+  len = strnlen(in, len);
+  out = palloc(len + 1);
+  memcpy(out, in, len);
+  out[len] = '\0';
+  return out;
+}
+
+/* Bytes of whole UTF-8 characters within limit */
+int pg_mbcliplen(const char *mbstr, int len, int limit) {
+  int clip = len < limit ? len : limit;
+
+  while (clip > 0 && clip < len && ((unsigned char)mbstr[clip] & 0xC0) == 0x80)
+    clip--;
+  return clip;
+}
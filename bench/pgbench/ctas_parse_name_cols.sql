@@ -0,0 +1,8 @@
+-- Bulk: parse_name_cols over the whole table into a new table
+-- Run once with psql; the driver times it. The lateral call keeps the
+-- function from being evaluated once per output column.
+\set ON_ERROR_STOP on
+DROP TABLE IF EXISTS bench_parsed;
+CREATE TABLE bench_parsed AS
+SELECT n.id, c.*
+FROM bench_names n, LATERAL parse_name_cols(n.name) c;
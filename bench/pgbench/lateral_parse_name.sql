@@ -0,0 +1,5 @@
+-- Batch: parse_name over 1000 consecutive rows through a lateral join
+\set start random(1, :rows - 999)
+SELECT count(*)
+FROM bench_names n, LATERAL parse_name(n.name) p
+WHERE n.id BETWEEN :start AND :start + 999;
@@ -0,0 +1,5 @@
+-- OLTP: one parse_name call on a random row
+\set id random(1, :rows)
+SELECT p.token, p.label
+FROM bench_names n, LATERAL parse_name(n.name) p
+WHERE n.id = :id;
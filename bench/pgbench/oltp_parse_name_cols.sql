@@ -0,0 +1,5 @@
+-- OLTP: one parse_name_cols call on a random row
+\set id random(1, :rows)
+SELECT c.*
+FROM bench_names n, LATERAL parse_name_cols(n.name) c
+WHERE n.id = :id;
@@ -0,0 +1,3 @@
+-- OLTP: one tag_name call on a random row
+\set id random(1, :rows)
+SELECT tag_name(name) FROM bench_names WHERE id = :id;
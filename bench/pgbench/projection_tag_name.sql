@@ -0,0 +1,5 @@
+-- Batch: tag_name over 1000 consecutive rows in the select list
+\set start random(1, :rows - 999)
+SELECT count(tag_name(name))
+FROM bench_names
+WHERE id BETWEEN :start AND :start + 999;
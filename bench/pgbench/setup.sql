@@ -0,0 +1,58 @@
+-- bench/pgbench/setup.sql - Load :rows synthetic names into bench_names
+--
+-- Usage: psql -v rows=1000000 -f bench/pgbench/setup.sql
+--
+-- Names are built from fixed word lists by row number, so every load of the
+-- same size gives the same table. About 70% are person names (with optional
+-- prefix, middle initial and suffix) and 30% corporations.
+
+\set ON_ERROR_STOP on
+
+CREATE EXTENSION IF NOT EXISTS pg_probablepeople;
+
+DROP TABLE IF EXISTS bench_names;
+CREATE TABLE bench_names (
+  id bigint PRIMARY KEY,
+  name text NOT NULL
+);
+
+INSERT INTO bench_names (id, name)
+SELECT i,
+       CASE WHEN i % 10 < 7 THEN
+         concat_ws(' ',
+           CASE WHEN i % 5 = 0 THEN prefixes[(1 + (i / 5) % array_length(prefixes, 1))::int] END,
+           given[(1 + (i * 7919) % array_length(given, 1))::int],
+           CASE WHEN i % 3 = 0 THEN chr((65 + (i * 31) % 26)::int) || '.' END,
+           surnames[(1 + (i * 104729) % array_length(surnames, 1))::int],
+           CASE WHEN i % 11 = 0 THEN suffixes[(1 + (i / 11) % array_length(suffixes, 1))::int] END)
+       ELSE
+         concat_ws(' ',
+           corp_words[(1 + (i * 7919) % array_length(corp_words, 1))::int],
+           CASE WHEN i % 2 = 0 THEN corp_words[(1 + (i * 15485863) % array_length(corp_words, 1))::int] END,
+           corp_types[(1 + (i / 10) % array_length(corp_types, 1))::int])
+       END
+FROM generate_series(1::bigint, :rows) AS i,
+     (SELECT ARRAY['Mr.', 'Mrs.', 'Ms.', 'Dr.', 'Prof.', 'Rev.'] AS prefixes,
+             ARRAY['James', 'Mary', 'John', 'Patricia', 'Robert', 'Jennifer',
+                   'Michael', 'Linda', 'William', 'Elizabeth', 'David', 'Barbara',
+                   'Richard', 'Susan', 'Joseph', 'Jessica', 'Thomas', 'Sarah',
+                   'Charles', 'Karen', 'Wei', 'Priya', 'Jose', 'Fatima',
+                   'Hiroshi', 'Olga', 'Mohammed', 'Aisha', 'Juan', 'Mei'] AS given,
+             ARRAY['Smith', 'Johnson', 'Williams', 'Brown', 'Jones', 'Garcia',
+                   'Miller', 'Davis', 'Rodriguez', 'Martinez', 'Hernandez',
+                   'Lopez', 'Gonzalez', 'Wilson', 'Anderson', 'Thomas', 'Taylor',
+                   'Moore', 'Jackson', 'Martin', 'Lee', 'Nguyen', 'Patel', 'Kim',
+                   'O''Brien', 'Smith-Jones', 'Van Buren', 'McDonald', 'Schmidt',
+                   'Ivanova', 'Tanaka', 'Okafor'] AS surnames,
+             ARRAY['Jr.', 'Sr.', 'II', 'III', 'PhD', 'MD', 'Esq.'] AS suffixes,
+             ARRAY['Acme', 'Global', 'United', 'Pacific', 'Summit', 'Pioneer',
+                   'Liberty', 'Northern', 'Blue', 'River', 'Golden', 'Eagle',
+                   'Harbor', 'Quantum', 'Apex', 'Cedar', 'Atlas', 'Evergreen',
+                   'Sterling', 'Metro', 'Engineering', 'Systems', 'Logistics',
+                   'Bakery', 'Holdings', 'Consulting', 'Foods', 'Partners'] AS corp_words,
+             ARRAY['Inc.', 'LLC', 'Corp.', 'Co.', 'Ltd.', 'Group', 'Company',
+                   'Corporation', '& Sons', 'L.P.'] AS corp_types) AS words;
+
+VACUUM ANALYZE bench_names;
+
+SELECT count(*) AS names, round(avg(length(name)), 1) AS avg_length FROM bench_names;
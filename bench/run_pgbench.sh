@@ -0,0 +1,154 @@
+#!/bin/sh
+# bench/run_pgbench.sh - SQL throughput and latency of the parsing functions
+#
+# Usage: bench/run_pgbench.sh [-s SIZES] [-c CLIENTS] [-T SECONDS] [-o DIR] [-r]
+#
+#   -s SIZES    Table sizes to load, in rows (default: "1000000 10000000")
+#   -c CLIENTS  Client counts for the pgbench workloads (default: "1 4 16 64")
+#   -T SECONDS  Duration of each pgbench run (default: 60)
+#   -o DIR      Directory for logs and results.csv (default: bench/results)
+#   -r          Reuse bench_names if it already has the requested size
+#
+# Connects with the usual PGHOST, PGPORT, PGDATABASE and PGUSER variables;
+# the extension must be installed. For every size, bench/pgbench/setup.sql
+# loads synthetic names, then each workload in bench/pgbench runs with each
+# client count, and parse_name_cols into CREATE TABLE AS runs once. Every
+# run adds a row to results.csv with its TPS, latency percentiles from the
+# pgbench transaction log, and the largest RSS seen for one of its backends.
+# RSS is sampled with ps, so the server must run on this host (it is left
+# empty otherwise).
+set -e
+
+sizes="1000000 10000000"
+clients="1 4 16 64"
+duration=60
+out=bench/results
+reuse=0
+
+while getopts "s:c:T:o:rh" opt; do
+  case "$opt" in
+    s) sizes=$OPTARG ;;
+    c) clients=$OPTARG ;;
+    T) duration=$OPTARG ;;
+    o) out=$OPTARG ;;
+    r) reuse=1 ;;
+    h)
+      sed -n '3,11s/^# \{0,1\}//p' "$0"
+      exit 0
+      ;;
+    *)
+      sed -n '3,11s/^# \{0,1\}//p' "$0" >&2
+      exit 1
+      ;;
+  esac
+done
+
+scripts=$(dirname "$0")/pgbench
+workloads="lateral_parse_name projection_tag_name oltp_parse_name oltp_tag_name oltp_parse_name_cols"
+
+for tool in psql pgbench; do
+  if ! command -v $tool > /dev/null; then
+    echo "Error: $tool not found in PATH" >&2
+    exit 1
+  fi
+done
+
+mkdir -p "$out"
+results=$out/results.csv
+if [ ! -f "$results" ]; then
+  echo "rows,workload,clients,seconds,transactions,tps,latency_avg_ms,latency_p50_ms,latency_p90_ms,latency_p99_ms,latency_max_ms,max_backend_rss_kb" > "$results"
+fi
+
+# Largest RSS (kB) of the backends whose application_name is $1, sampled
+# every half second into $2 until the sampler is killed
+sample_rss() {
+  echo 0 > "$2"
+  while :; do
+    for pid in $(psql -XAtq -c "SELECT pid FROM pg_stat_activity WHERE application_name = '$1'" 2> /dev/null); do
+      rss=$(ps -o rss= -p "$pid" 2> /dev/null | tr -d ' ')
+      if [ -n "$rss" ] && [ "$rss" -gt "$(cat "$2")" ]; then
+        echo "$rss" > "$2"
+      fi
+    done
+    sleep 0.5
+  done
+}
+
+stop_sampler() {
+  kill "$1" 2> /dev/null || true
+  wait "$1" 2> /dev/null || true
+  rss=$(cat "$2")
+  [ "$rss" -gt 0 ] || rss=
+  echo "$rss"
+}
+
+# Count, mean, p50, p90, p99 and max of the latencies (us) on stdin, in ms
+latency_stats() {
+  sort -n | awk '
+    { lat[NR] = $1; sum += $1 }
+    function pct(q,  i) { i = int(q * NR + 0.999999); if (i < 1) i = 1; return lat[i] / 1000 }
+    END {
+      if (NR == 0) { print "0,,,,,"; exit }
+      printf "%d,%.3f,%.3f,%.3f,%.3f,%.3f\n", NR, sum / NR / 1000, pct(0.50), pct(0.90), pct(0.99), lat[NR] / 1000
+    }'
+}
+
+for rows in $sizes; do
+  loaded=0
+  if [ "$reuse" = 1 ]; then
+    loaded=$(psql -XAtq -c "SELECT count(*) FROM bench_names" 2> /dev/null || echo 0)
+  fi
+  if [ "$loaded" != "$rows" ]; then
+    echo "Loading $rows names"
+    psql -Xq -v rows="$rows" -f "$scripts/setup.sql"
+  fi
+
+  for workload in $workloads; do
+    for c in $clients; do
+      echo "$workload: $rows rows, $c client(s), ${duration}s"
+      run=$out/$workload-$rows-$c
+      rm -f "$run".log "$run".log.*
+      app=ppl_bench_$$
+
+      sample_rss "$app" "$run.rss" &
+      sampler=$!
+      PGAPPNAME=$app pgbench -n -M prepared -c "$c" -j "$c" -T "$duration" \
+        -D rows="$rows" -f "$scripts/$workload.sql" \
+        -l --log-prefix="$run.log" > "$run.out" 2>&1 || {
+        stop_sampler "$sampler" "$run.rss" > /dev/null
+        echo "Error: pgbench failed, see $run.out" >&2
+        exit 1
+      }
+      rss=$(stop_sampler "$sampler" "$run.rss")
+
+      # The last tps line excludes connection time on every pgbench version
+      tps=$(sed -n 's/^tps = \([0-9.]*\).*/\1/p' "$run.out" | tail -n 1)
+      stats=$(cat "$run".log.* | awk '{ print $3 }' | latency_stats)
+      echo "$rows,$workload,$c,$duration,$(echo "$stats" | cut -d, -f1),$tps,$(echo "$stats" | cut -d, -f2-),$rss" >> "$results"
+      rm -f "$run".log.* "$run.rss"
+    done
+  done
+
+  echo "ctas_parse_name_cols: $rows rows"
+  run=$out/ctas_parse_name_cols-$rows
+  app=ppl_bench_$$
+  sample_rss "$app" "$run.rss" &
+  sampler=$!
+  start=$(date +%s.%N)
+  PGAPPNAME=$app psql -Xq -f "$scripts/ctas_parse_name_cols.sql" > "$run.out" 2>&1 || {
+    stop_sampler "$sampler" "$run.rss" > /dev/null
+    echo "Error: CREATE TABLE AS failed, see $run.out" >&2
+    exit 1
+  }
+  end=$(date +%s.%N)
+  rss=$(stop_sampler "$sampler" "$run.rss")
+  rm -f "$run.rss"
+  psql -Xq -c "DROP TABLE IF EXISTS bench_parsed"
+  awk -v rows="$rows" -v s="$start" -v e="$end" -v rss="$rss" 'BEGIN {
+    t = e - s
+    printf "%d,ctas_parse_name_cols,1,%.3f,1,%.6f,%.3f,,,,,%s\n", rows, t, 1 / t, t * 1000, rss
+  }' >> "$results"
+done
+
+echo "Results: $results"
+column -s, -t < "$results" 2> /dev/null || cat "$results"
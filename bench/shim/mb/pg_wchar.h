@@ -0,0 +1,8 @@
+/* bench/shim/mb/pg_wchar.h - The multibyte helpers the tokenizer uses,
+ * for UTF-8 input; see bench/pg_shim.c */
+#ifndef BENCH_SHIM_PG_WCHAR_H
+#define BENCH_SHIM_PG_WCHAR_H
+
+int pg_mbcliplen(const char *mbstr, int len, int limit);
+
+#endif /* BENCH_SHIM_PG_WCHAR_H */
@@ -0,0 +1,24 @@
+/* bench/shim/postgres.h - Just enough of postgres.h to build the tokenizer
+ * and feature extractor outside the server; see bench/pg_shim.c */
+#ifndef BENCH_SHIM_POSTGRES_H
+#define BENCH_SHIM_POSTGRES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int64_t int64;
+typedef uint64_t uint64;
+typedef struct MemoryContextData *MemoryContext;
+
+/* Backed by malloc; allocation failure aborts, as ereport(ERROR) would */
+void *palloc(size_t size);
+void *palloc0(size_t size);
+void *repalloc(void *pointer, size_t size);
+void pfree(void *pointer);
+char *pstrdup(const char *in);
+char *pnstrdup(const char *in, size_t len);
+
+#endif /* BENCH_SHIM_POSTGRES_H */
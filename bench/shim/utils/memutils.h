@@ -0,0 +1,7 @@
+/* bench/shim/utils/memutils.h - Empty; postgres.h declares what is used */
+#ifndef BENCH_SHIM_MEMUTILS_H
+#define BENCH_SHIM_MEMUTILS_H
+
+#include "postgres.h"
+
+#endif /* BENCH_SHIM_MEMUTILS_H */
@@ -0,0 +1,455 @@
+/* bench/stress_parser.c - Worst-case latency and memory of pathological names
+ *
+ * Feeds the extension's parsing path (tokenizer, feature extraction,
+ * attribute lookup, scoring and Viterbi) with inputs a name column should
+ * never hold but sometimes does: megabyte-long tokens, tens of thousands of
+ * tokens, runs of titles or punctuation, a single token of punctuation
+ * longer than the 255-byte feature buffers, multibyte text and random bytes.
+ * Each category is parsed with the same input limits as the server
+ * (pg_probablepeople.max_input_bytes and max_tokens) and the slowest parse,
+ * the largest tokenized input and the peak heap of one parse are reported.
+ * Heap use is tracked by wrapping malloc, calloc, realloc, aligned_alloc and
+ * free at link time (-Wl,--wrap), as bench_parser does.
+ */
+#define _GNU_SOURCE
+#include "feature_extractor.h"
+#include "name_features.h"
+#include "name_tokenizer.h"
+
+#include <crfsuite.h>
+
+#include <getopt.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_MODEL "include/generic_learned_settings.crfsuite"
+#define DEFAULT_MAX_BYTES 1024 /* As pg_probablepeople.max_input_bytes */
+#define DEFAULT_MAX_TOKENS 64  /* As pg_probablepeople.max_tokens */
+#define DEFAULT_SIZE (1024 * 1024)
+#define DEFAULT_RANDOM 1000
+#define DEFAULT_REPEAT 3
+#define MAX_RANDOM_BYTES 4096
+
+/* Heap in use and allocations so far, kept by the --wrap'ed allocators */
+static unsigned long long allocations;
+static size_t live_bytes, peak_bytes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+void *__real_aligned_alloc(size_t alignment, size_t size);
+void __real_free(void *pointer);
+
+static void *track(void *pointer) {
+  if (pointer != NULL) {
+    live_bytes += malloc_usable_size(pointer);
+    if (live_bytes > peak_bytes)
+      peak_bytes = live_bytes;
+  }
+  return pointer;
+}
+
+void *__wrap_malloc(size_t size) {
+  allocations++;
+  return track(__real_malloc(size));
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+  allocations++;
+  return track(__real_calloc(nmemb, size));
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+  size_t old = pointer ? malloc_usable_size(pointer) : 0;
+  void *moved;
+
+  allocations++;
+  moved = __real_realloc(pointer, size);
+  if (moved == NULL)
+    return NULL;
+  live_bytes -= old;
+  return track(moved);
+}
+
+/* CRFsuite's vectors */
+void *__wrap_aligned_alloc(size_t alignment, size_t size) {
+  allocations++;
+  return track(__real_aligned_alloc(alignment, size));
+}
+
+void __wrap_free(void *pointer) {
+  if (pointer != NULL)
+    live_bytes -= malloc_usable_size(pointer);
+  __real_free(pointer);
+}
+
+/* Results of one category */
+typedef struct {
+  const char *name;
+  int inputs;
+  size_t max_input_bytes;
+  int max_tokens;
+  int truncated;
+  double total_us;
+  double max_us;
+  size_t peak_bytes;
+  unsigned long long allocations;
+} CategoryStats;
+
+/* xorshift64*, so a seed gives the same inputs everywhere */
+static uint64_t rng_state = 1;
+
+static uint64_t next_random(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static void print_usage(const char *prog) {
+  printf("Usage: %s [options]\n", prog);
+  printf("\nParse pathological names through the extension's parsing path "
+         "and report the\nslowest parse and peak heap of each kind of "
+         "input.\n");
+  printf("\nOptions:\n");
+  printf("  -m, --model FILE       Model to tag with (default: %s)\n",
+         DEFAULT_MODEL);
+  printf("  -B, --max-bytes N      Input bytes read, 0 for no limit "
+         "(default: %d)\n",
+         DEFAULT_MAX_BYTES);
+  printf("  -T, --max-tokens N     Tokens parsed, 0 for no limit "
+         "(default: %d)\n",
+         DEFAULT_MAX_TOKENS);
+  printf("  -S, --size N           Bytes of each generated input "
+         "(default: %d)\n",
+         DEFAULT_SIZE);
+  printf("  -n, --random N         Random byte strings to parse "
+         "(default: %d)\n",
+         DEFAULT_RANDOM);
+  printf("  -r, --repeat N         Parses of each fixed input "
+         "(default: %d)\n",
+         DEFAULT_REPEAT);
+  printf("  -s, --seed N           Seed of the random inputs (default: 1)\n");
+  printf("  -t, --budget US        Exit 1 if any parse takes longer than "
+         "US microseconds\n");
+  printf("  -h, --help             Show this help message\n");
+}
+
+/* Repeat unit until size bytes are filled, then end with last (if not
+ * NUL) */
+static char *repeat_unit(const char *unit, size_t size, char last) {
+  size_t unit_len = strlen(unit);
+  char *text = malloc(size + 1);
+
+  if (!text)
+    return NULL;
+  for (size_t i = 0; i < size; i++)
+    text[i] = unit[i % unit_len];
+  /* Don't end on half of a multibyte character */
+  while (size > 0 && ((unsigned char)unit[size % unit_len] & 0xC0) == 0x80)
+    size--;
+  if (last != '\0' && size > 0)
+    text[size - 1] = last;
+  text[size] = '\0';
+  return text;
+}
+
+/* Up to MAX_RANDOM_BYTES non-NUL bytes, a quarter of them whitespace */
+static char *random_bytes(void) {
+  size_t len = 1 + next_random() % MAX_RANDOM_BYTES;
+  char *text = malloc(len + 1);
+
+  if (!text)
+    return NULL;
+  for (size_t i = 0; i < len; i++) {
+    uint64_t r = next_random();
+
+    text[i] = (r & 3) == 0 ? ' ' : (char)(1 + (r >> 8) % 255);
+  }
+  text[len] = '\0';
+  return text;
+}
+
+/*
+ * Parse one name the way parse_name_string does and add it to stats
+ *
+ * Features are built one token at a time into a single buffer, as
+ * create_crf_instance_from_tokens does, so the heap of a parse grows with
+ * the tokens kept and not with the features of each.
+ */
+static int parse_one(const char *name, int max_bytes, int max_tokens,
+                     crfsuite_dictionary_t *attrs, uint64_t templates,
+                     crfsuite_tagger_t *tagger, CategoryStats *stats) {
+  struct timespec start, end;
+  unsigned long long allocs = allocations;
+  size_t live = live_bytes;
+  crfsuite_instance_t instance;
+  NameFeatureList *features;
+  const char **texts = NULL;
+  TokenInfo *tokens;
+  int *labels = NULL;
+  floatval_t score;
+  int num_tokens;
+  bool truncated;
+  double us;
+  int ret = 0;
+
+  peak_bytes = live_bytes;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  tokens = tokenize_name_string(name, max_bytes, max_tokens, &num_tokens,
+                                &truncated);
+  if (tokens != NULL && num_tokens > 0) {
+    features = malloc(sizeof(NameFeatureList));
+    texts = malloc(num_tokens * sizeof(const char *));
+    labels = malloc(num_tokens * sizeof(int));
+    if (!features || !texts || !labels) {
+      free(features);
+      ret = -1;
+      goto done;
+    }
+    for (int i = 0; i < num_tokens; i++)
+      texts[i] = tokens[i].text;
+
+    crfsuite_instance_init(&instance);
+    for (int i = 0; i < num_tokens; i++) {
+      crfsuite_item_t item;
+
+      crfsuite_item_init(&item);
+      extract_name_features(texts, num_tokens, i, templates, features);
+      for (int j = 0; j < features->num_features; j++) {
+        int aid = attrs->to_id(attrs, features->features[j].name);
+
+        if (aid >= 0) {
+          crfsuite_attribute_t attr;
+
+          crfsuite_attribute_set(&attr, aid, features->features[j].value);
+          crfsuite_item_append_attribute(&item, &attr);
+        }
+      }
+      crfsuite_instance_append(&instance, &item, 0);
+      crfsuite_item_finish(&item);
+    }
+    free(features);
+
+    tagger->set(tagger, &instance);
+    tagger->viterbi(tagger, labels, &score);
+    crfsuite_instance_finish(&instance);
+  }
+
+done:
+  free(labels);
+  free(texts);
+  if (tokens != NULL)
+    free_token_info_array(tokens, num_tokens);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  us = (end.tv_sec - start.tv_sec) * 1e6 +
+       (end.tv_nsec - start.tv_nsec) / 1e3;
+  stats->inputs++;
+  stats->total_us += us;
+  if (us > stats->max_us)
+    stats->max_us = us;
+  if (strlen(name) > stats->max_input_bytes)
+    stats->max_input_bytes = strlen(name);
+  if (num_tokens > stats->max_tokens)
+    stats->max_tokens = num_tokens;
+  stats->truncated += truncated;
+  if (peak_bytes - live > stats->peak_bytes)
+    stats->peak_bytes = peak_bytes - live;
+  stats->allocations += allocations - allocs;
+  return ret;
+}
+
+int main(int argc, char *argv[]) {
+  /* Units repeated to --size bytes, each one category. A category with a
+   * last character is cut to the byte limit first, so the whole token,
+   * last character included, is parsed. */
+  static const struct {
+    const char *name;
+    const char *unit;
+    char last;
+  } fixed[] = {
+      {"long_token", "a", '\0'},
+      {"many_tokens", "Smith ", '\0'},
+      {"long_words", "Wolfeschlegelsteinhausenbergerdorff ", '\0'},
+      {"titles", "Dr. ", '\0'},
+      {"punctuation", ".,;&-/ ", '\0'},
+      {"punct_token", "-", 'x'},
+      {"utf8", "Zoë Ærøskøbing 山田 ", '\0'},
+  };
+  const int num_fixed = sizeof(fixed) / sizeof(fixed[0]);
+  const char *model_file = DEFAULT_MODEL;
+  int max_bytes = DEFAULT_MAX_BYTES, max_tokens = DEFAULT_MAX_TOKENS;
+  size_t size = DEFAULT_SIZE;
+  int num_random = DEFAULT_RANDOM, repeat = DEFAULT_REPEAT;
+  double budget_us = 0;
+  CategoryStats *stats;
+  int num_categories = num_fixed + 2;
+  crfsuite_model_t *model = NULL;
+  crfsuite_dictionary_t *attrs = NULL;
+  crfsuite_tagger_t *tagger = NULL;
+  uint64_t templates;
+  int over_budget = 0;
+  int ret = 1;
+
+  static struct option long_options[] = {
+      {"model", required_argument, 0, 'm'},
+      {"max-bytes", required_argument, 0, 'B'},
+      {"max-tokens", required_argument, 0, 'T'},
+      {"size", required_argument, 0, 'S'},
+      {"random", required_argument, 0, 'n'},
+      {"repeat", required_argument, 0, 'r'},
+      {"seed", required_argument, 0, 's'},
+      {"budget", required_argument, 0, 't'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "m:B:T:S:n:r:s:t:h", long_options,
+                            NULL)) != -1) {
+    switch (opt) {
+    case 'm':
+      model_file = optarg;
+      break;
+    case 'B':
+      max_bytes = atoi(optarg);
+      break;
+    case 'T':
+      max_tokens = atoi(optarg);
+      break;
+    case 'S':
+      size = strtoul(optarg, NULL, 10);
+      break;
+    case 'n':
+      num_random = atoi(optarg);
+      break;
+    case 'r':
+      repeat = atoi(optarg);
+      break;
+    case 's':
+      rng_state = strtoull(optarg, NULL, 10);
+      break;
+    case 't':
+      budget_us = atof(optarg);
+      break;
+    case 'h':
+      print_usage(argv[0]);
+      return 0;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (max_bytes < 0 || max_tokens < 0 || size < 1 || num_random < 0 ||
+      repeat < 1) {
+    fprintf(stderr, "Error: Limits, --size and --repeat must not be "
+                    "negative, and --size and --repeat not zero\n");
+    return 1;
+  }
+  /* The generator is stuck at zero */
+  if (rng_state == 0)
+    rng_state = 1;
+
+  stats = calloc(num_categories, sizeof(CategoryStats));
+  if (!stats) {
+    fprintf(stderr, "Error: Out of memory\n");
+    return 1;
+  }
+
+  if (crfsuite_create_instance_from_file(model_file, (void **)&model) != 0) {
+    fprintf(stderr, "Error: Could not load model: %s\n", model_file);
+    goto cleanup;
+  }
+  model->get_attrs(model, &attrs);
+  templates = name_model_templates(attrs);
+  if (model->get_tagger(model, &tagger) != 0) {
+    fprintf(stderr, "Error: Could not create a tagger\n");
+    goto cleanup;
+  }
+
+  /* An ordinary name first, as the yardstick; its first parse warms up */
+  stats[0].name = "baseline";
+  for (int i = 0; i <= repeat; i++) {
+    CategoryStats warmup = {0};
+
+    if (parse_one("Dr. Mary Anne Smith-Jones Jr.", max_bytes, max_tokens,
+                  attrs, templates, tagger, i == 0 ? &warmup : &stats[0]) !=
+        0)
+      goto oom;
+  }
+
+  for (int c = 0; c < num_fixed; c++) {
+    size_t len = fixed[c].last != '\0' && max_bytes > 0 &&
+                         (size_t)max_bytes < size
+                     ? (size_t)max_bytes
+                     : size;
+    char *text = repeat_unit(fixed[c].unit, len, fixed[c].last);
+
+    if (!text)
+      goto oom;
+    stats[1 + c].name = fixed[c].name;
+    for (int i = 0; i < repeat; i++) {
+      if (parse_one(text, max_bytes, max_tokens, attrs, templates, tagger,
+                    &stats[1 + c]) != 0) {
+        free(text);
+        goto oom;
+      }
+    }
+    free(text);
+  }
+
+  stats[num_categories - 1].name = "random";
+  for (int i = 0; i < num_random; i++) {
+    char *text = random_bytes();
+
+    if (!text || parse_one(text, max_bytes, max_tokens, attrs, templates,
+                           tagger, &stats[num_categories - 1]) != 0) {
+      free(text);
+      goto oom;
+    }
+    free(text);
+  }
+
+  printf("Limits: %d bytes, %d tokens (0 is none)\n\n", max_bytes,
+         max_tokens);
+  printf("%-12s %7s %10s %7s %9s %10s %10s %9s %10s\n", "category", "inputs",
+         "max bytes", "tokens", "truncated", "mean us", "max us", "peak KB",
+         "allocs");
+  for (int c = 0; c < num_categories; c++) {
+    const CategoryStats *st = &stats[c];
+    int over;
+
+    if (st->inputs == 0)
+      continue;
+    over = budget_us > 0 && st->max_us > budget_us;
+    printf("%-12s %7d %10zu %7d %9d %10.1f %10.1f %9.1f %10.1f%s\n",
+           st->name, st->inputs, st->max_input_bytes, st->max_tokens,
+           st->truncated, st->total_us / st->inputs, st->max_us,
+           st->peak_bytes / 1024.0,
+           (double)st->allocations / st->inputs, over ? "  OVER BUDGET" : "");
+    over_budget += over;
+  }
+
+  ret = 0;
+  if (over_budget > 0) {
+    fprintf(stderr, "%d categor%s went over the budget of %.0f us\n",
+            over_budget, over_budget == 1 ? "y" : "ies", budget_us);
+    ret = 1;
+  }
+  goto cleanup;
+
+oom:
+  fprintf(stderr, "Error: Out of memory\n");
+cleanup:
+  if (tagger)
+    tagger->release(tagger);
+  if (model)
+    model->release(model);
+  free(stats);
+  return ret;
+}
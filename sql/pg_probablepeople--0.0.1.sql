@@ -31,3 +31,77 @@ RETURNS parsed_name
 AS '$libdir/pg_probablepeople', 'parse_name_cols'
 LANGUAGE C IMMUTABLE STRICT;
 COMMENT ON FUNCTION parse_name_cols(text) IS 'Parse a name into standardized columns';
+
+CREATE FUNCTION parse_name_profile(input_text text)
+RETURNS TABLE(stage text, time_ns bigint, operations bigint, detail text)
+AS '$libdir/pg_probablepeople', 'parse_name_profile'
+LANGUAGE C VOLATILE STRICT;
+COMMENT ON FUNCTION parse_name_profile(text) IS 'Time and work of each stage of parsing one name';
+
+CREATE FUNCTION attribute_profile(model_type text DEFAULT 'generic')
+RETURNS TABLE(attribute_id integer, attribute text, hits bigint)
+AS '$libdir/pg_probablepeople', 'attribute_profile'
+LANGUAGE C VOLATILE STRICT;
+COMMENT ON FUNCTION attribute_profile(text) IS 'Hit counts of the model attributes that fired in this session while pg_probablepeople.profile_attributes was on';
+
+CREATE FUNCTION dump_attribute_profile(filename text, model_type text DEFAULT 'generic')
+RETURNS bigint
+AS '$libdir/pg_probablepeople', 'dump_attribute_profile'
+LANGUAGE C VOLATILE STRICT;
+COMMENT ON FUNCTION dump_attribute_profile(text, text) IS 'Write the attribute hit counts of this session to a server file for compress_model and train_model';
+-- Writes server files, so only superusers may call it unless granted
+REVOKE ALL ON FUNCTION dump_attribute_profile(text, text) FROM PUBLIC;
+
+CREATE FUNCTION reset_attribute_profile()
+RETURNS void
+AS '$libdir/pg_probablepeople', 'reset_attribute_profile'
+LANGUAGE C VOLATILE;
+COMMENT ON FUNCTION reset_attribute_profile() IS 'Clear the attribute hit counts of this session';
+
+CREATE FUNCTION pg_probablepeople_stats(
+  OUT parse_name_calls bigint,
+  OUT parse_name_time_ms double precision,
+  OUT parse_name_max_time_ms double precision,
+  OUT tag_name_calls bigint,
+  OUT tag_name_time_ms double precision,
+  OUT tag_name_max_time_ms double precision,
+  OUT parse_name_cols_calls bigint,
+  OUT parse_name_cols_time_ms double precision,
+  OUT parse_name_cols_max_time_ms double precision,
+  OUT tokens bigint,
+  OUT feature_lookups bigint,
+  OUT feature_misses bigint,
+  OUT model_cache_hits bigint,
+  OUT model_loads bigint,
+  OUT model_load_time_ms double precision,
+  OUT shared boolean,
+  OUT stats_reset timestamp with time zone)
+AS '$libdir/pg_probablepeople', 'pg_probablepeople_stats'
+LANGUAGE C VOLATILE;
+
+CREATE VIEW pg_probablepeople_stats AS
+  SELECT * FROM pg_probablepeople_stats();
+COMMENT ON VIEW pg_probablepeople_stats IS 'Cumulative parser statistics: shared by all backends when pg_probablepeople is in shared_preload_libraries, otherwise of this session';
+
+CREATE FUNCTION pg_probablepeople_stats_reset()
+RETURNS void
+AS '$libdir/pg_probablepeople', 'pg_probablepeople_stats_reset'
+LANGUAGE C VOLATILE;
+COMMENT ON FUNCTION pg_probablepeople_stats_reset() IS 'Clear the counters of pg_probablepeople_stats';
+-- Clears statistics for every user, so only superusers may call it unless granted
+REVOKE ALL ON FUNCTION pg_probablepeople_stats_reset() FROM PUBLIC;
+
+CREATE FUNCTION pg_probablepeople_memory(
+  tokens integer DEFAULT 4,
+  OUT model text,
+  OUT file_bytes bigint,
+  OUT buffer_bytes bigint,
+  OUT structure_bytes bigint,
+  OUT cqdb_bytes bigint,
+  OUT tagger_bytes bigint,
+  OUT cache_bytes bigint,
+  OUT total_bytes bigint)
+RETURNS SETOF record
+AS '$libdir/pg_probablepeople', 'pg_probablepeople_memory'
+LANGUAGE C VOLATILE STRICT;
+COMMENT ON FUNCTION pg_probablepeople_memory(integer) IS 'Memory held by the models loaded in this backend, with the per-call tagger sized for a name of the given number of tokens';
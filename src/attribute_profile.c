@@ -0,0 +1,135 @@
+/* src/attribute_profile.c */
+#include "attribute_profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Longest profile line: feature names are short, so this is generous */
+#define MAX_PROFILE_LINE 4096
+
+static int compare_entries(const void *a, const void *b) {
+  return strcmp(((const ProfileEntry *)a)->attribute,
+                ((const ProfileEntry *)b)->attribute);
+}
+
+/* Parse "<hits>\t<aid>\t<attribute>" into entry */
+static int parse_entry(char *line, ProfileEntry *entry) {
+  char *end;
+  char *tab;
+
+  entry->hits = strtoull(line, &end, 10);
+  if (end == line || *end != '\t')
+    return -1;
+  line = end + 1;
+
+  entry->aid = (int)strtol(line, &end, 10);
+  if (end == line || *end != '\t' || entry->aid < 0)
+    return -1;
+  line = end + 1;
+
+  /* The attribute runs to the end of the line */
+  tab = strchr(line, '\t');
+  if (tab)
+    return -1;
+  entry->attribute = strdup(line);
+  return entry->attribute ? 0 : -1;
+}
+
+AttributeProfile *read_attribute_profile(const char *filename) {
+  AttributeProfile *profile;
+  FILE *fp;
+  char line[MAX_PROFILE_LINE];
+  int capacity = 0;
+  int lineno = 0;
+
+  fp = fopen(filename, "r");
+  if (!fp) {
+    fprintf(stderr, "Error: Could not open profile %s\n", filename);
+    return NULL;
+  }
+
+  profile = calloc(1, sizeof(AttributeProfile));
+  if (!profile) {
+    fclose(fp);
+    return NULL;
+  }
+
+  while (fgets(line, sizeof(line), fp)) {
+    size_t len = strlen(line);
+
+    lineno++;
+    if (len > 0 && line[len - 1] == '\n')
+      line[--len] = '\0';
+    else if (!feof(fp))
+      goto error;
+
+    if (lineno == 1) {
+      if (strcmp(line, ATTRIBUTE_PROFILE_MAGIC) != 0)
+        goto error;
+      continue;
+    }
+    if (strncmp(line, "# model: ", 9) == 0) {
+      snprintf(profile->model, sizeof(profile->model), "%.*s",
+               (int)sizeof(profile->model) - 1, line + 9);
+      continue;
+    }
+    if (strncmp(line, "# tokens: ", 10) == 0) {
+      profile->tokens = strtoull(line + 10, NULL, 10);
+      continue;
+    }
+    if (line[0] == '#' || line[0] == '\0')
+      continue;
+
+    if (profile->num_entries == capacity) {
+      int new_capacity = capacity ? capacity * 2 : 1024;
+      ProfileEntry *entries =
+          realloc(profile->entries, new_capacity * sizeof(ProfileEntry));
+
+      if (!entries)
+        goto error;
+      profile->entries = entries;
+      capacity = new_capacity;
+    }
+    if (parse_entry(line, &profile->entries[profile->num_entries]) != 0)
+      goto error;
+    if (profile->entries[profile->num_entries].attribute[0] == '\0')
+      profile->hashed = 1;
+    profile->num_entries++;
+  }
+
+  if (lineno == 0)
+    goto error;
+  fclose(fp);
+
+  qsort(profile->entries, profile->num_entries, sizeof(ProfileEntry),
+        compare_entries);
+  return profile;
+
+error:
+  fprintf(stderr, "Error: %s is not a valid attribute profile (line %d)\n",
+          filename, lineno);
+  fclose(fp);
+  free_attribute_profile(profile);
+  return NULL;
+}
+
+uint64_t attribute_profile_hits(const AttributeProfile *profile,
+                                const char *attribute) {
+  ProfileEntry key;
+  ProfileEntry *entry;
+
+  key.attribute = (char *)attribute;
+  entry = bsearch(&key, profile->entries, profile->num_entries,
+                  sizeof(ProfileEntry), compare_entries);
+  return entry ? entry->hits : 0;
+}
+
+void free_attribute_profile(AttributeProfile *profile) {
+  if (!profile)
+    return;
+  for (int i = 0; i < profile->num_entries; i++)
+    free(profile->entries[i].attribute);
+  free(profile->entries);
+  free(profile);
+}
@@ -0,0 +1,48 @@
+/* src/attribute_profile.h */
+#ifndef ATTRIBUTE_PROFILE_H
+#define ATTRIBUTE_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Attribute profile file, as written by dump_attribute_profile()
+ *
+ *   # pg_probablepeople attribute profile
+ *   # model: generic
+ *   # tokens: 1234
+ *   <hits>\t<attribute id>\t<attribute>
+ *   ...
+ *
+ * Only attributes that fired are listed. The attribute is empty for hashed
+ * models, which store no attribute strings; their entries match by ID.
+ */
+#define ATTRIBUTE_PROFILE_MAGIC "# pg_probablepeople attribute profile"
+
+/* One attribute that fired */
+typedef struct {
+  char *attribute; /* Attribute string ("" for hashed models) */
+  int aid;         /* Attribute ID in the profiled model */
+  uint64_t hits;   /* Number of tokens it fired on */
+} ProfileEntry;
+
+/* Parsed attribute profile; entries are sorted by attribute string */
+typedef struct {
+  char model[64];        /* Model type that was profiled */
+  uint64_t tokens;       /* Tokens seen while profiling */
+  ProfileEntry *entries;
+  int num_entries;
+  int hashed;            /* Entries have no attribute strings */
+} AttributeProfile;
+
+/* Read a profile file; returns NULL (with a message) on error */
+AttributeProfile *read_attribute_profile(const char *filename);
+
+/* Hits of an attribute string, 0 if it never fired */
+uint64_t attribute_profile_hits(const AttributeProfile *profile,
+                                const char *attribute);
+
+/* Free a profile */
+void free_attribute_profile(AttributeProfile *profile);
+
+#endif /* ATTRIBUTE_PROFILE_H */
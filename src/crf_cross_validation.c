@@ -0,0 +1,402 @@
+/* src/crf_cross_validation.c */
+#include "crf_cross_validation.h"
+
+#include <crfsuite.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Outcome of training and evaluating one (configuration, fold) pair */
+typedef struct {
+  int status; /* 0 on success */
+  double item_accuracy;
+  double instance_accuracy;
+  double macro_f1;
+  double seconds;
+} FoldResult;
+
+/* A fold job running in a worker process */
+typedef struct {
+  pid_t pid;
+  int fd; /* Read end of the result pipe */
+} FoldJob;
+
+static double elapsed_seconds(struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Map every ID of one dictionary to the ID of the same string in another,
+ * or -1 if it is missing there */
+static int *map_dictionary(crfsuite_dictionary_t *from,
+                           crfsuite_dictionary_t *to) {
+  int n = from->num(from);
+  int *map = malloc((n > 0 ? n : 1) * sizeof(int));
+
+  if (!map)
+    return NULL;
+
+  for (int id = 0; id < n; id++) {
+    const char *str = NULL;
+
+    from->to_string(from, id, &str);
+    map[id] = str ? to->to_id(to, str) : -1;
+    from->free(from, str);
+  }
+  return map;
+}
+
+/* Tag the instances of crf_data in group (or all of them if group < 0) with
+ * the model saved at model_file and accumulate the results in eval */
+int evaluate_crf_model(crfsuite_data_t *crf_data, int group,
+                       const char *model_file, crfsuite_evaluation_t *eval) {
+  crfsuite_model_t *model = NULL;
+  crfsuite_dictionary_t *attrs = NULL, *labels = NULL;
+  crfsuite_tagger_t *tagger = NULL;
+  int *attr_map = NULL, *label_map = NULL, *predicted = NULL;
+  int ret = -1;
+
+  if (crfsuite_create_instance_from_file(model_file, (void **)&model) != 0)
+    return -1;
+  model->get_attrs(model, &attrs);
+  model->get_labels(model, &labels);
+  model->get_tagger(model, &tagger);
+
+  /* Training data uses its own IDs; the saved model renumbers attributes */
+  attr_map = map_dictionary(crf_data->attrs, attrs);
+  label_map = map_dictionary(labels, crf_data->labels);
+  if (!tagger || !attr_map || !label_map)
+    goto cleanup;
+
+  for (int i = 0; i < crf_data->num_instances; i++) {
+    crfsuite_instance_t *ref = &crf_data->instances[i];
+    crfsuite_instance_t inst;
+
+    if ((group >= 0 && ref->group != group) || ref->num_items == 0)
+      continue;
+
+    crfsuite_instance_init(&inst);
+    for (int t = 0; t < ref->num_items; t++) {
+      crfsuite_item_t item;
+
+      crfsuite_item_init(&item);
+      for (int c = 0; c < ref->items[t].num_contents; c++) {
+        crfsuite_attribute_t attr = ref->items[t].contents[c];
+
+        attr.aid = attr_map[attr.aid];
+        if (attr.aid >= 0)
+          crfsuite_item_append_attribute(&item, &attr);
+      }
+      crfsuite_instance_append(&inst, &item, ref->labels[t]);
+      crfsuite_item_finish(&item);
+    }
+
+    floatval_t score;
+    predicted = realloc(predicted, ref->num_items * sizeof(int));
+    if (!predicted || tagger->set(tagger, &inst) != 0 ||
+        tagger->viterbi(tagger, predicted, &score) != 0) {
+      crfsuite_instance_finish(&inst);
+      goto cleanup;
+    }
+    crfsuite_instance_finish(&inst);
+
+    for (int t = 0; t < ref->num_items; t++)
+      predicted[t] = label_map[predicted[t]];
+    /* A collapsed instance counts once for every sequence it stands for */
+    for (long copies = lround(ref->weight); copies > 0; copies--)
+      crfsuite_evaluation_accmulate(eval, ref->labels, predicted,
+                                    ref->num_items);
+  }
+  ret = 0;
+
+cleanup:
+  free(predicted);
+  free(attr_map);
+  free(label_map);
+  if (tagger)
+    tagger->release(tagger);
+  if (attrs)
+    attrs->release(attrs);
+  if (labels)
+    labels->release(labels);
+  model->release(model);
+  return ret;
+}
+
+/* Train on every fold but one and evaluate on the held-out fold */
+static void run_fold(crfsuite_data_t *crf_data, TrainingConfig *config,
+                     int fold, FoldResult *result) {
+  crfsuite_data_t train = *crf_data;
+  crfsuite_evaluation_t eval;
+  struct timespec start;
+  char model_file[] = "/tmp/train_model_cv_XXXXXX";
+  int fd;
+
+  memset(result, 0, sizeof(*result));
+  result->status = -1;
+
+  /* Shallow copies: the worker only reads the shared instances */
+  train.instances = malloc(crf_data->num_instances * sizeof(crfsuite_instance_t));
+  if (!train.instances)
+    return;
+  train.num_instances = 0;
+  for (int i = 0; i < crf_data->num_instances; i++) {
+    if (crf_data->instances[i].group != fold)
+      train.instances[train.num_instances++] = crf_data->instances[i];
+  }
+
+  fd = mkstemp(model_file);
+  if (fd < 0) {
+    free(train.instances);
+    return;
+  }
+  close(fd);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (run_crf_trainer(&train, model_file, config, false) == 0) {
+    result->seconds = elapsed_seconds(&start);
+
+    crfsuite_evaluation_init(&eval, crf_data->labels->num(crf_data->labels));
+    if (evaluate_crf_model(crf_data, fold, model_file, &eval) == 0) {
+      crfsuite_evaluation_finalize(&eval);
+      result->item_accuracy = eval.item_accuracy;
+      result->instance_accuracy = eval.inst_accuracy;
+      result->macro_f1 = eval.macro_fmeasure;
+      result->status = 0;
+    }
+    crfsuite_evaluation_finish(&eval);
+  }
+
+  unlink(model_file);
+  free(train.instances);
+}
+
+/* Fork a worker for one fold job */
+static int start_fold_job(crfsuite_data_t *crf_data, TrainingConfig *config,
+                          int fold, FoldJob *job) {
+  int fds[2];
+
+  if (pipe(fds) != 0)
+    return -1;
+
+  /* Don't let the child flush our buffered output a second time */
+  fflush(stdout);
+  fflush(stderr);
+
+  job->pid = fork();
+  if (job->pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+
+  if (job->pid == 0) {
+    FoldResult result;
+
+    close(fds[0]);
+    run_fold(crf_data, config, fold, &result);
+    if (write(fds[1], &result, sizeof(result)) != sizeof(result))
+      _exit(1);
+    _exit(0);
+  }
+
+  close(fds[1]);
+  job->fd = fds[0];
+  return 0;
+}
+
+/* Collect the result of a worker that exited with the given status */
+static void finish_fold_job(FoldJob *job, int status, FoldResult *result) {
+  if (read(job->fd, result, sizeof(*result)) != sizeof(*result) ||
+      !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    result->status = -1;
+  close(job->fd);
+  job->pid = 0;
+}
+
+/* Run all (configuration, fold) jobs with at most num_workers at a time */
+static int run_fold_jobs(crfsuite_data_t *crf_data, int num_folds,
+                         TrainingConfig *grid, int num_points,
+                         int num_workers, FoldResult *results) {
+  int num_jobs = num_points * num_folds;
+  FoldJob *jobs = calloc(num_jobs, sizeof(FoldJob));
+  int next = 0, running = 0, done = 0;
+
+  if (!jobs)
+    return -1;
+
+  while (done < num_jobs) {
+    while (running < num_workers && next < num_jobs) {
+      if (start_fold_job(crf_data, &grid[next / num_folds], next % num_folds,
+                         &jobs[next]) != 0) {
+        fprintf(stderr, "Error: Failed to start worker: %s\n",
+                strerror(errno));
+        results[next].status = -1;
+        done++;
+      } else {
+        running++;
+      }
+      next++;
+    }
+    if (running == 0)
+      continue;
+
+    /* Results are small, so workers never block on a full pipe */
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    for (int j = 0; j < next; j++) {
+      if (jobs[j].pid != pid)
+        continue;
+
+      FoldResult *result = &results[j];
+      finish_fold_job(&jobs[j], status, result);
+      running--;
+      done++;
+
+      printf("  [%d/%d] c1=%g c2=%g max_iter=%d", done, num_jobs,
+             grid[j / num_folds].c1, grid[j / num_folds].c2,
+             grid[j / num_folds].max_iterations);
+      if (grid[j / num_folds].hash_bits > 0)
+        printf(" hash_bits=%d", grid[j / num_folds].hash_bits);
+      printf(" fold %d: ", j % num_folds + 1);
+      if (result->status == 0)
+        printf("item accuracy %.4f (%.1f s)\n", result->item_accuracy,
+               result->seconds);
+      else
+        printf("failed\n");
+      fflush(stdout);
+      break;
+    }
+  }
+
+  free(jobs);
+  return done == num_jobs ? 0 : -1;
+}
+
+/* Cross-validate each configuration in grid */
+int cross_validate_crf_model(TrainingData *data, int num_folds,
+                             TrainingConfig *grid, int num_points,
+                             int num_workers, const char *output_file) {
+  crfsuite_data_t crf_data;
+  FoldResult *results = NULL;
+  int best = -1;
+  double best_accuracy = -1.0;
+  bool collapse = true;
+  int ret = -1;
+
+  if (num_folds < 2 || num_folds > data->num_sequences) {
+    fprintf(stderr, "Error: Number of folds must be between 2 and %d\n",
+            data->num_sequences);
+    return -1;
+  }
+  if (num_workers <= 0)
+    num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (num_workers < 1)
+    num_workers = 1;
+
+  printf("Cross-validating %d configuration%s with %d folds on %d "
+         "sequences...\n",
+         num_points, num_points == 1 ? "" : "s", num_folds,
+         data->num_sequences);
+
+  /* Features are extracted once and shared by every worker */
+  if (build_crf_data(data, &crf_data, grid[0].num_threads) != 0 ||
+      apply_attribute_profile(&crf_data, &grid[0]) != 0)
+    goto cleanup;
+  for (int i = 0; i < crf_data.num_instances; i++)
+    crf_data.instances[i].group = i % num_folds;
+
+  /* Folds are assigned first, so training and held-out sets are the same
+   * sequences as without collapsing. The instances are shared by every
+   * configuration, so they are only collapsed if all of them would be. */
+  for (int p = 0; p < num_points; p++)
+    collapse = collapse && collapses_duplicates(&grid[p]);
+  if (collapse && collapse_duplicate_instances(&crf_data, &grid[0]) != 0)
+    goto cleanup;
+
+  results = calloc(num_points * num_folds, sizeof(FoldResult));
+  if (!results) {
+    fprintf(stderr, "Error: Out of memory\n");
+    goto cleanup;
+  }
+
+  printf("\nRunning %d training jobs, %d at a time\n",
+         num_points * num_folds, num_workers);
+  if (run_fold_jobs(&crf_data, num_folds, grid, num_points, num_workers,
+                    results) != 0) {
+    fprintf(stderr, "Error: Cross-validation did not complete\n");
+    goto cleanup;
+  }
+
+  /* Average over folds */
+  printf("\n%10s %10s %9s %9s %10s %10s %10s %12s\n", "c1", "c2", "max_iter",
+         "hash_bits", "item_acc", "inst_acc", "macro_f1", "train_s/fold");
+  for (int p = 0; p < num_points; p++) {
+    double item = 0, instance = 0, f1 = 0, seconds = 0;
+    int failed = 0;
+
+    for (int k = 0; k < num_folds; k++) {
+      FoldResult *result = &results[p * num_folds + k];
+      if (result->status != 0) {
+        failed = 1;
+        continue;
+      }
+      item += result->item_accuracy;
+      instance += result->instance_accuracy;
+      f1 += result->macro_f1;
+      seconds += result->seconds;
+    }
+
+    if (failed) {
+      printf("%10g %10g %9d %9d %10s\n", grid[p].c1, grid[p].c2,
+             grid[p].max_iterations, grid[p].hash_bits, "failed");
+      continue;
+    }
+
+    item /= num_folds;
+    printf("%10g %10g %9d %9d %10.4f %10.4f %10.4f %12.1f\n", grid[p].c1,
+           grid[p].c2, grid[p].max_iterations, grid[p].hash_bits, item,
+           instance / num_folds, f1 / num_folds, seconds / num_folds);
+    if (item > best_accuracy) {
+      best_accuracy = item;
+      best = p;
+    }
+  }
+
+  if (best < 0) {
+    fprintf(stderr, "Error: Every configuration failed\n");
+    goto cleanup;
+  }
+  printf("\nBest: c1=%g c2=%g max_iter=%d", grid[best].c1, grid[best].c2,
+         grid[best].max_iterations);
+  if (grid[best].hash_bits > 0)
+    printf(" hash_bits=%d", grid[best].hash_bits);
+  printf(" (item accuracy %.4f)\n", best_accuracy);
+
+  ret = 0;
+  if (output_file) {
+    printf("\nTraining final model with the best configuration...\n");
+    ret = run_crf_trainer(&crf_data, output_file, &grid[best], true);
+    if (ret == 0)
+      printf("\nModel saved to: %s\n", output_file);
+    else
+      fprintf(stderr, "\nTraining failed with error code: %d\n", ret);
+  }
+
+cleanup:
+  free(results);
+  free_crf_data(&crf_data);
+  return ret;
+}
@@ -0,0 +1,30 @@
+/* src/crf_cross_validation.h */
+#ifndef CRF_CROSS_VALIDATION_H
+#define CRF_CROSS_VALIDATION_H
+
+#include "crf_trainer.h"
+
+/* Cross-validate every configuration in grid using num_folds folds
+ *
+ * Features are extracted once; each (configuration, fold) pair is trained
+ * in a worker process that shares the dataset copy-on-write, with at most
+ * num_workers (0: one per CPU) running at a time. A table of accuracy and
+ * training time is printed. If output_file is not NULL, a model with the
+ * best configuration is trained on all data and saved there.
+ *
+ * Returns 0 on success, non-zero on error
+ */
+int cross_validate_crf_model(TrainingData *data, int num_folds,
+                             TrainingConfig *grid, int num_points,
+                             int num_workers, const char *output_file);
+
+/* Tag the instances of crf_data whose group is group (all of them if group
+ * is negative) with the model saved at model_file, accumulating the results
+ * in eval, which must have been initialized for crf_data's labels
+ *
+ * Attributes the model does not know are ignored. Returns 0 on success.
+ */
+int evaluate_crf_model(crfsuite_data_t *crf_data, int group,
+                       const char *model_file, crfsuite_evaluation_t *eval);
+
+#endif /* CRF_CROSS_VALIDATION_H */
@@ -1,246 +1,285 @@
 /* src/crf_trainer.c */
 #include "crf_trainer.h"
+#include "attribute_profile.h"
+#include "crf1d.h"
+#include "name_features.h"
 #include "training_data_parser.h"
 
 #include <crfsuite.h>
-#include <ctype.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
-/* Feature extraction - simplified version for standalone training */
-#define MAX_FEATURE_NAME_LEN 256
-#define MAX_FEATURES_PER_TOKEN 100
+/* Largest --hash-bits: the trainer keeps per-attribute arrays */
+#define MAX_HASH_BITS 24
 
-typedef struct {
-  char name[MAX_FEATURE_NAME_LEN];
-  float weight;
-} Feature;
-
-typedef struct {
-  Feature features[MAX_FEATURES_PER_TOKEN];
-  int num_features;
-} FeatureList;
+/* Smallest share of the training data worth a conversion thread */
+#define MIN_SEQUENCES_PER_THREAD 256
 
 /* Initialize default training config */
 void init_training_config(TrainingConfig *config) {
+  config->c1 = 0.0;
   config->c2 = 1.0;
   config->max_iterations = 100;
   config->epsilon = 0.0001;
+  config->num_threads = 0;
+  config->hash_bits = 0;
+  config->profile_file = NULL;
+  config->min_hits = 1;
+  config->keep_duplicates = false;
+  config->collapse_duplicates = false;
 }
 
-/* Add feature to list */
-static void add_feature(FeatureList *list, const char *name, float weight) {
-  if (list->num_features >= MAX_FEATURES_PER_TOKEN)
-    return;
-  strncpy(list->features[list->num_features].name, name,
-          MAX_FEATURE_NAME_LEN - 1);
-  list->features[list->num_features].name[MAX_FEATURE_NAME_LEN - 1] = '\0';
-  list->features[list->num_features].weight = weight;
-  list->num_features++;
-}
+/* Convert one labeled sequence into a CRFSuite instance
+ * Returns 0 on success, -1 on allocation failure
+ */
+static int convert_sequence(LabeledSequence *seq, crfsuite_instance_t *inst,
+                            crfsuite_dictionary_t *attrs,
+                            crfsuite_dictionary_t *labels) {
+  const char **texts;
 
-/* Extract features for a single token - matches feature_extractor.c */
-static void extract_token_features(const char *token, FeatureList *features) {
-  char buf[MAX_FEATURE_NAME_LEN];
-  int len = strlen(token);
+  crfsuite_instance_init(inst);
 
-  /* Token identity */
-  snprintf(buf, sizeof(buf), "token:%s", token);
-  add_feature(features, buf, 1.0);
+  texts = malloc((seq->num_tokens > 0 ? seq->num_tokens : 1) *
+                 sizeof(const char *));
+  if (!texts)
+    return -1;
+  for (int j = 0; j < seq->num_tokens; j++)
+    texts[j] = seq->tokens[j].text;
+
+  for (int j = 0; j < seq->num_tokens; j++) {
+    crfsuite_item_t item;
+    crfsuite_item_init(&item);
+
+    /* Extract features */
+    NameFeatureList features;
+    extract_name_features(texts, seq->num_tokens, j, NAME_TEMPLATES_ALL,
+                          &features);
+
+    /* Add features to item */
+    for (int k = 0; k < features.num_features; k++) {
+      crfsuite_attribute_t attr;
+      int aid = attrs->get(attrs, features.features[k].name);
+
+      if (aid < 0) {
+        crfsuite_item_finish(&item);
+        free(texts);
+        return -1;
+      }
+      crfsuite_attribute_init(&attr);
+      crfsuite_attribute_set(&attr, aid, features.features[k].value);
+      crfsuite_item_append_attribute(&item, &attr);
+    }
+
+    /* Get label ID */
+    int lid = labels->get(labels, seq->tokens[j].label);
+    if (lid < 0) {
+      crfsuite_item_finish(&item);
+      free(texts);
+      return -1;
+    }
 
-  /* Lowercase token */
-  char lower[256];
-  for (int i = 0; i < len && i < 255; i++) {
-    lower[i] = tolower((unsigned char)token[i]);
+    /* Add item to instance */
+    crfsuite_instance_append(inst, &item, lid);
+    crfsuite_item_finish(&item);
   }
-  lower[len < 255 ? len : 255] = '\0';
 
-  snprintf(buf, sizeof(buf), "token_lower:%s", lower);
-  add_feature(features, buf, 1.0);
+  free(texts);
+  return 0;
+}
 
-  /* No punctuation version */
-  char nopunc[256];
-  int j = 0;
-  for (int i = 0; i < len && j < 254; i++) {
-    if (!ispunct((unsigned char)lower[i])) {
-      nopunc[j++] = lower[i];
+/*
+ * A contiguous slice of the training data converted by one thread.
+ *
+ * The first slice writes straight into the global dictionaries. Every other
+ * slice interns into its own dictionaries, whose IDs are remapped once all
+ * threads are done.
+ */
+typedef struct {
+  TrainingData *data;
+  crfsuite_instance_t *instances;
+  int begin;
+  int end;
+  crfsuite_dictionary_t *attrs;
+  crfsuite_dictionary_t *labels;
+  int *attr_map;  /* Local to global attribute IDs */
+  int *label_map; /* Local to global label IDs */
+  int failed;     /* A sequence could not be converted */
+} ConversionSlice;
+
+static void *convert_slice(void *arg) {
+  ConversionSlice *slice = arg;
+
+  for (int i = slice->begin; i < slice->end; i++) {
+    if (convert_sequence(&slice->data->sequences[i], &slice->instances[i],
+                         slice->attrs, slice->labels) != 0) {
+      slice->failed = 1;
+      break;
     }
   }
-  nopunc[j] = '\0';
-  if (j > 0) {
-    snprintf(buf, sizeof(buf), "nopunc:%s", nopunc);
-    add_feature(features, buf, 1.0);
-  }
+  return NULL;
 }
 
-/* Extract prefix/suffix features */
-static void extract_affix_features(const char *token, FeatureList *features) {
-  char buf[MAX_FEATURE_NAME_LEN];
-  int len = strlen(token);
-
-  /* Lowercase and strip punctuation first */
-  char clean[256];
-  int j = 0;
-  for (int i = 0; i < len && j < 254; i++) {
-    unsigned char c = (unsigned char)token[i];
-    if (!ispunct(c)) {
-      clean[j++] = tolower(c);
-    }
-  }
-  clean[j] = '\0';
-  len = j;
+static void *remap_slice(void *arg) {
+  ConversionSlice *slice = arg;
 
-  /* Prefix features (1-4 chars) */
-  for (int plen = 1; plen <= 4 && plen <= len; plen++) {
-    char prefix[8];
-    strncpy(prefix, clean, plen);
-    prefix[plen] = '\0';
-    snprintf(buf, sizeof(buf), "prefix_%d:%s", plen, prefix);
-    add_feature(features, buf, 1.0);
+  for (int i = slice->begin; i < slice->end; i++) {
+    crfsuite_instance_t *inst = &slice->instances[i];
+
+    for (int t = 0; t < inst->num_items; t++) {
+      crfsuite_item_t *item = &inst->items[t];
+
+      for (int c = 0; c < item->num_contents; c++)
+        item->contents[c].aid = slice->attr_map[item->contents[c].aid];
+      inst->labels[t] = slice->label_map[inst->labels[t]];
+    }
   }
+  return NULL;
+}
 
-  /* Suffix features (1-4 chars) */
-  for (int slen = 1; slen <= 4 && slen <= len; slen++) {
-    char suffix[8];
-    strncpy(suffix, clean + len - slen, slen);
-    suffix[slen] = '\0';
-    snprintf(buf, sizeof(buf), "suffix_%d:%s", slen, suffix);
-    add_feature(features, buf, 1.0);
+/* Intern every string of a local dictionary into the global one, in local
+ * ID order, and return the local to global ID map */
+static int *merge_dictionary(crfsuite_dictionary_t *local,
+                             crfsuite_dictionary_t *global) {
+  int n = local->num(local);
+  int *map = malloc((n > 0 ? n : 1) * sizeof(int));
+
+  if (!map)
+    return NULL;
+
+  for (int id = 0; id < n; id++) {
+    const char *str = NULL;
+
+    local->to_string(local, id, &str);
+    map[id] = global->get(global, str);
+    local->free(local, str);
+    if (map[id] < 0) {
+      free(map);
+      return NULL;
+    }
   }
+  return map;
 }
 
-/* Extract case features */
-static void extract_case_features(const char *token, FeatureList *features) {
-  int len = strlen(token);
-  if (len == 0)
-    return;
+/* Run fn over every slice, on its own thread where there is more than one */
+static int run_slices(ConversionSlice *slices, int num_slices,
+                      void *(*fn)(void *)) {
+  pthread_t *threads = malloc(num_slices * sizeof(pthread_t));
+  int started = 0;
+  int ret = 0;
 
-  int upper_count = 0, lower_count = 0;
+  if (!threads)
+    return -1;
 
-  for (int i = 0; i < len; i++) {
-    unsigned char c = (unsigned char)token[i];
-    if (isupper(c))
-      upper_count++;
-    else if (islower(c))
-      lower_count++;
+  for (int i = 1; i < num_slices; i++) {
+    if (pthread_create(&threads[i], NULL, fn, &slices[i]) != 0) {
+      ret = -1;
+      break;
+    }
+    started = i;
   }
 
-  if (isupper((unsigned char)token[0]))
-    add_feature(features, "is_capitalized", 1.0);
-  if (upper_count == len)
-    add_feature(features, "is_all_caps", 1.0);
-  if (lower_count == len)
-    add_feature(features, "is_all_lower", 1.0);
-}
+  if (ret == 0)
+    fn(&slices[0]);
 
-/* Extract length features */
-static void extract_length_features(const char *token, FeatureList *features) {
-  char buf[MAX_FEATURE_NAME_LEN];
-  int len = strlen(token);
-
-  snprintf(buf, sizeof(buf), "length:%d", len);
-  add_feature(features, buf, 1.0);
-
-  if (len == 1)
-    add_feature(features, "is_single_char", 1.0);
-  else if (len == 2)
-    add_feature(features, "is_two_char", 1.0);
-  else if (len <= 4)
-    add_feature(features, "is_short", 1.0);
-  else if (len >= 10)
-    add_feature(features, "is_long", 1.0);
-}
+  for (int i = 1; i <= started; i++)
+    pthread_join(threads[i], NULL);
 
-/* Extract character features */
-static void extract_char_features(const char *token, FeatureList *features) {
-  int len = strlen(token);
-  int has_digit = 0, has_punct = 0, has_hyphen = 0, has_dot = 0;
-
-  for (int i = 0; i < len; i++) {
-    unsigned char c = (unsigned char)token[i];
-    if (isdigit(c))
-      has_digit = 1;
-    if (ispunct(c))
-      has_punct = 1;
-    if (c == '-')
-      has_hyphen = 1;
-    if (c == '.')
-      has_dot = 1;
-  }
-
-  if (has_digit)
-    add_feature(features, "has_digit", 1.0);
-  if (has_punct)
-    add_feature(features, "has_punct", 1.0);
-  if (has_hyphen)
-    add_feature(features, "has_hyphen", 1.0);
-  if (has_dot)
-    add_feature(features, "has_dot", 1.0);
-
-  /* Check if ends with period (abbreviation) */
-  if (len > 1 && token[len - 1] == '.')
-    add_feature(features, "ends_with_dot", 1.0);
+  free(threads);
+  return ret;
 }
 
-/* Extract context features */
-static void extract_context_features(LabeledToken *tokens, int num_tokens,
-                                     int position, FeatureList *features) {
-  char buf[MAX_FEATURE_NAME_LEN];
-  int window = 2;
-
-  /* Previous tokens */
-  for (int i = 1; i <= window; i++) {
-    int prev_pos = position - i;
-    if (prev_pos >= 0) {
-      snprintf(buf, sizeof(buf), "prev_%d=%s", i, tokens[prev_pos].text);
-      add_feature(features, buf, 0.8);
-    } else {
-      snprintf(buf, sizeof(buf), "prev_%d=BOS", i);
-      add_feature(features, buf, 0.5);
-    }
-  }
+/*
+ * Convert all sequences into crf_data->instances using up to num_threads
+ * threads.
+ *
+ * IDs are assigned in order of first appearance, exactly as a serial pass
+ * would: slices are merged in data order and each local dictionary numbers
+ * its strings by first appearance within the slice.
+ */
+static int convert_training_data(TrainingData *data, crfsuite_data_t *crf_data,
+                                 int num_threads) {
+  ConversionSlice *slices = NULL;
+  struct timespec start, end;
+  int num_slices;
+  int ret = -1;
 
-  /* Next tokens */
-  for (int i = 1; i <= window; i++) {
-    int next_pos = position + i;
-    if (next_pos < num_tokens) {
-      snprintf(buf, sizeof(buf), "next_%d=%s", i, tokens[next_pos].text);
-      add_feature(features, buf, 0.8);
-    } else {
-      snprintf(buf, sizeof(buf), "next_%d=EOS", i);
-      add_feature(features, buf, 0.5);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (num_threads <= 0)
+    num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  num_slices = data->num_sequences / MIN_SEQUENCES_PER_THREAD;
+  if (num_slices > num_threads)
+    num_slices = num_threads;
+  if (num_slices < 1)
+    num_slices = 1;
+
+  slices = calloc(num_slices, sizeof(ConversionSlice));
+  if (!slices)
+    return -1;
+
+  for (int i = 0; i < num_slices; i++) {
+    ConversionSlice *slice = &slices[i];
+
+    slice->data = data;
+    slice->instances = crf_data->instances;
+    slice->begin = (int)((long)data->num_sequences * i / num_slices);
+    slice->end = (int)((long)data->num_sequences * (i + 1) / num_slices);
+
+    if (i == 0) {
+      slice->attrs = crf_data->attrs;
+      slice->labels = crf_data->labels;
+    } else if (crfsuite_dictionary_create_instance(
+                   "dictionary", (void **)&slice->attrs) != 0 ||
+               crfsuite_dictionary_create_instance(
+                   "dictionary", (void **)&slice->labels) != 0) {
+      goto cleanup;
     }
   }
-}
 
-/* Extract position features */
-static void extract_position_features(int position, int total,
-                                      FeatureList *features) {
-  if (position == 0)
-    add_feature(features, "is_first", 1.0);
-  if (position == total - 1)
-    add_feature(features, "is_last", 1.0);
-}
+  /* Slices that never ran leave zeroed instances, which are safe to free */
+  int converted = run_slices(slices, num_slices, convert_slice);
+  crf_data->num_instances = data->num_sequences;
+  for (int i = 0; i < num_slices; i++)
+    converted |= slices[i].failed;
+  if (converted != 0)
+    goto cleanup;
 
-/* Extract all features for a token */
-static void extract_all_features(LabeledToken *tokens, int num_tokens,
-                                 int position, FeatureList *features) {
-  features->num_features = 0;
+  /* Merge the local dictionaries in slice order */
+  for (int i = 1; i < num_slices; i++) {
+    slices[i].attr_map = merge_dictionary(slices[i].attrs, crf_data->attrs);
+    slices[i].label_map = merge_dictionary(slices[i].labels, crf_data->labels);
+    if (!slices[i].attr_map || !slices[i].label_map)
+      goto cleanup;
+  }
 
-  const char *token = tokens[position].text;
+  if (num_slices > 1 && run_slices(slices + 1, num_slices - 1, remap_slice) != 0)
+    goto cleanup;
 
-  extract_token_features(token, features);
-  extract_affix_features(token, features);
-  extract_case_features(token, features);
-  extract_length_features(token, features);
-  extract_char_features(token, features);
-  extract_context_features(tokens, num_tokens, position, features);
-  extract_position_features(position, num_tokens, features);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  printf("  Converted %d sequences in %.2f s (%d thread%s)\n",
+         data->num_sequences,
+         (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9,
+         num_slices, num_slices == 1 ? "" : "s");
+  ret = 0;
 
-  /* Bias feature */
-  add_feature(features, "bias", 1.0);
+cleanup:
+  for (int i = 1; i < num_slices; i++) {
+    if (slices[i].attrs)
+      slices[i].attrs->release(slices[i].attrs);
+    if (slices[i].labels)
+      slices[i].labels->release(slices[i].labels);
+    free(slices[i].attr_map);
+    free(slices[i].label_map);
+  }
+  free(slices);
+  return ret;
 }
 
 /* Logging callback for training progress */
@@ -250,188 +289,544 @@ static int training_callback(void *user, const char *format, va_list args) {
   return 0;
 }
 
-/* Train CRF model from training data */
-int train_crf_model(TrainingData *data, const char *output_file,
-                    TrainingConfig *config) {
-  crfsuite_data_t crf_data;
-  crfsuite_trainer_t *trainer = NULL;
-  crfsuite_params_t *params = NULL;
-  int ret = -1;
-
-  printf("Training CRF model with %d sequences...\n", data->num_sequences);
+/* Discard training progress messages */
+static int quiet_callback(void *user, const char *format, va_list args) {
+  return 0;
+}
 
-  /* Initialize CRF data */
-  memset(&crf_data, 0, sizeof(crf_data));
+/* Build the CRFSuite dictionaries and instances for data */
+int build_crf_data(TrainingData *data, crfsuite_data_t *crf_data,
+                   int num_threads) {
+  memset(crf_data, 0, sizeof(*crf_data));
 
   /* Create dictionaries - use crfsuite_dictionary_create_instance directly */
   if (crfsuite_dictionary_create_instance("dictionary",
-                                          (void **)&crf_data.attrs) != 0) {
+                                          (void **)&crf_data->attrs) != 0) {
     fprintf(stderr, "Error: Failed to create attribute dictionary\n");
-    goto cleanup;
+    return -1;
   }
   if (crfsuite_dictionary_create_instance("dictionary",
-                                          (void **)&crf_data.labels) != 0) {
+                                          (void **)&crf_data->labels) != 0) {
     fprintf(stderr, "Error: Failed to create label dictionary\n");
-    goto cleanup;
+    return -1;
   }
 
   /* Allocate instances array */
-  crf_data.cap_instances = data->num_sequences;
-  crf_data.instances =
-      calloc(crf_data.cap_instances, sizeof(crfsuite_instance_t));
-  if (!crf_data.instances) {
+  crf_data->cap_instances = data->num_sequences;
+  crf_data->instances =
+      calloc(crf_data->cap_instances, sizeof(crfsuite_instance_t));
+  if (!crf_data->instances) {
     fprintf(stderr, "Error: Out of memory\n");
-    goto cleanup;
+    return -1;
   }
 
   /* Convert training data to CRFSuite format */
   printf("Converting training data...\n");
 
-  for (int i = 0; i < data->num_sequences; i++) {
-    LabeledSequence *seq = &data->sequences[i];
-    crfsuite_instance_t *inst = &crf_data.instances[crf_data.num_instances];
+  if (convert_training_data(data, crf_data, num_threads) != 0) {
+    fprintf(stderr, "Error: Failed to convert training data\n");
+    return -1;
+  }
+
+  printf("Created %d training instances\n", crf_data->num_instances);
+  printf("Attributes: %d, Labels: %d\n", crf_data->attrs->num(crf_data->attrs),
+         crf_data->labels->num(crf_data->labels));
+  return 0;
+}
 
-    crfsuite_instance_init(inst);
+int apply_attribute_profile(crfsuite_data_t *crf_data, TrainingConfig *config) {
+  AttributeProfile *profile;
+  int num_attrs = crf_data->attrs->num(crf_data->attrs);
+  int num_kept = 0;
+  bool *keep;
 
-    for (int j = 0; j < seq->num_tokens; j++) {
-      crfsuite_item_t item;
-      crfsuite_item_init(&item);
+  if (!config->profile_file)
+    return 0;
 
-      /* Extract features */
-      FeatureList features;
-      extract_all_features(seq->tokens, seq->num_tokens, j, &features);
+  profile = read_attribute_profile(config->profile_file);
+  if (!profile)
+    return -1;
+  if (profile->hashed) {
+    fprintf(stderr, "Error: %s was recorded with a hashed model and has no "
+                    "attribute strings\n",
+            config->profile_file);
+    free_attribute_profile(profile);
+    return -1;
+  }
 
-      /* Add features to item */
-      for (int k = 0; k < features.num_features; k++) {
-        crfsuite_attribute_t attr;
-        int aid =
-            crf_data.attrs->get(crf_data.attrs, features.features[k].name);
+  keep = malloc((num_attrs > 0 ? num_attrs : 1) * sizeof(bool));
+  if (!keep) {
+    fprintf(stderr, "Error: Out of memory\n");
+    free_attribute_profile(profile);
+    return -1;
+  }
+  for (int aid = 0; aid < num_attrs; aid++) {
+    const char *str = NULL;
+
+    crf_data->attrs->to_string(crf_data->attrs, aid, &str);
+    keep[aid] = attribute_profile_hits(profile, str) >= config->min_hits;
+    crf_data->attrs->free(crf_data->attrs, str);
+    num_kept += keep[aid];
+  }
 
-        crfsuite_attribute_init(&attr);
-        crfsuite_attribute_set(&attr, aid, features.features[k].weight);
-        crfsuite_item_append_attribute(&item, &attr);
+  for (int i = 0; i < crf_data->num_instances; i++) {
+    crfsuite_instance_t *inst = &crf_data->instances[i];
+
+    for (int t = 0; t < inst->num_items; t++) {
+      crfsuite_item_t *item = &inst->items[t];
+      int n = 0;
+
+      for (int c = 0; c < item->num_contents; c++) {
+        if (keep[item->contents[c].aid])
+          item->contents[n++] = item->contents[c];
       }
+      item->num_contents = n;
+    }
+  }
 
-      /* Get label ID */
-      int lid = crf_data.labels->get(crf_data.labels, seq->tokens[j].label);
+  printf("Attribute profile %s (%llu tokens): keeping %d of %d attributes "
+         "with at least %lu hits\n",
+         config->profile_file, (unsigned long long)profile->tokens, num_kept,
+         num_attrs, config->min_hits);
 
-      /* Add item to instance */
-      crfsuite_instance_append(inst, &item, lid);
-      crfsuite_item_finish(&item);
+  free(keep);
+  free_attribute_profile(profile);
+  return 0;
+}
+
+/* FNV-1a over n bytes, continuing from h */
+static uint64_t hash_bytes(uint64_t h, const void *p, size_t n) {
+  const unsigned char *bytes = p;
+
+  for (size_t i = 0; i < n; i++) {
+    h ^= bytes[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/* Hash of the fields collapse_duplicate_instances compares; attributes are
+ * hashed field by field since their padding is not initialized */
+static uint64_t hash_instance(const crfsuite_instance_t *inst) {
+  uint64_t h = 14695981039346656037ULL;
+
+  h = hash_bytes(h, &inst->group, sizeof(inst->group));
+  h = hash_bytes(h, &inst->num_items, sizeof(inst->num_items));
+  h = hash_bytes(h, inst->labels, inst->num_items * sizeof(int));
+  for (int t = 0; t < inst->num_items; t++) {
+    const crfsuite_item_t *item = &inst->items[t];
+
+    h = hash_bytes(h, &item->num_contents, sizeof(item->num_contents));
+    for (int c = 0; c < item->num_contents; c++) {
+      h = hash_bytes(h, &item->contents[c].aid, sizeof(int));
+      h = hash_bytes(h, &item->contents[c].value, sizeof(floatval_t));
+    }
+  }
+  return h;
+}
+
+static bool same_instance(const crfsuite_instance_t *a,
+                          const crfsuite_instance_t *b) {
+  if (a->group != b->group || a->num_items != b->num_items ||
+      memcmp(a->labels, b->labels, a->num_items * sizeof(int)) != 0)
+    return false;
+  for (int t = 0; t < a->num_items; t++) {
+    const crfsuite_item_t *x = &a->items[t], *y = &b->items[t];
+
+    if (x->num_contents != y->num_contents)
+      return false;
+    for (int c = 0; c < x->num_contents; c++) {
+      if (x->contents[c].aid != y->contents[c].aid ||
+          x->contents[c].value != y->contents[c].value)
+        return false;
+    }
+  }
+  return true;
+}
+
+bool collapses_duplicates(const TrainingConfig *config) {
+  if (config->keep_duplicates)
+    return false;
+  return config->c1 > 0 || config->collapse_duplicates;
+}
+
+int collapse_duplicate_instances(crfsuite_data_t *crf_data,
+                                 TrainingConfig *config) {
+  const int n = crf_data->num_instances;
+  int size = 1, kept = 0;
+  int *slots;
+
+  if (!collapses_duplicates(config) || n == 0)
+    return 0;
+
+  /* Open addressing, at most half full; slots hold indices of kept
+   * instances, which are compacted in place as the scan proceeds */
+  while (size < 2 * n)
+    size <<= 1;
+  slots = malloc(size * sizeof(int));
+  if (!slots) {
+    fprintf(stderr, "Error: Out of memory\n");
+    return -1;
+  }
+  memset(slots, -1, size * sizeof(int));
+
+  for (int i = 0; i < n; i++) {
+    crfsuite_instance_t *inst = &crf_data->instances[i];
+    int j = (int)(hash_instance(inst) & (uint64_t)(size - 1));
+
+    while (slots[j] >= 0 &&
+           !same_instance(&crf_data->instances[slots[j]], inst))
+      j = (j + 1) & (size - 1);
+
+    if (slots[j] >= 0) {
+      crf_data->instances[slots[j]].weight += inst->weight;
+      crfsuite_instance_finish(inst);
+      continue;
     }
+    if (kept != i)
+      crf_data->instances[kept] = *inst;
+    slots[j] = kept++;
+  }
+  free(slots);
+
+  crf_data->num_instances = kept;
+  printf("Collapsed %d duplicate sequences: %d weighted instances from %d "
+         "(%.1f%% fewer)\n",
+         n - kept, kept, n, 100.0 * (n - kept) / n);
+  return 0;
+}
+
+/* Free everything allocated by build_crf_data */
+void free_crf_data(crfsuite_data_t *crf_data) {
+  for (int i = 0; i < crf_data->num_instances; i++) {
+    crfsuite_instance_finish(&crf_data->instances[i]);
+  }
+  free(crf_data->instances);
+
+  if (crf_data->attrs)
+    crf_data->attrs->release(crf_data->attrs);
+  if (crf_data->labels)
+    crf_data->labels->release(crf_data->labels);
+  memset(crf_data, 0, sizeof(*crf_data));
+}
+
+/*
+ * Dictionary of hashed attribute IDs. Every ID below the table size
+ * exists, and its string is the ID in decimal, so the model the trainer
+ * saves can be turned into a hashed model by save_hashed_model.
+ */
+typedef struct {
+  int num;
+} HashedIds;
+
+static int hashed_ids_addref(crfsuite_dictionary_t *dic) {
+  return ++dic->nref;
+}
+
+static int hashed_ids_release(crfsuite_dictionary_t *dic) {
+  int count = --dic->nref;
+  if (count == 0) {
+    free(dic->internal);
+    free(dic);
+  }
+  return count;
+}
+
+static int hashed_ids_to_id(crfsuite_dictionary_t *dic, const char *str) {
+  HashedIds *ids = dic->internal;
+  char *end;
+  long id = strtol(str, &end, 10);
+
+  return (*end == '\0' && 0 <= id && id < ids->num) ? (int)id : -1;
+}
+
+static int hashed_ids_to_string(crfsuite_dictionary_t *dic, int id,
+                                char const **pstr) {
+  char *str = malloc(16);
+
+  if (str)
+    snprintf(str, 16, "%d", id);
+  *pstr = str;
+  return str ? 0 : 1;
+}
+
+static int hashed_ids_num(crfsuite_dictionary_t *dic) {
+  return ((HashedIds *)dic->internal)->num;
+}
+
+static void hashed_ids_free(crfsuite_dictionary_t *dic, const char *str) {
+  free((char *)str);
+}
+
+static crfsuite_dictionary_t *create_hashed_ids(int num) {
+  crfsuite_dictionary_t *dic = calloc(1, sizeof(crfsuite_dictionary_t));
+  HashedIds *ids = malloc(sizeof(HashedIds));
 
-    crf_data.num_instances++;
+  if (!dic || !ids) {
+    free(dic);
+    free(ids);
+    return NULL;
+  }
+  ids->num = num;
+  dic->internal = ids;
+  dic->nref = 1;
+  dic->addref = hashed_ids_addref;
+  dic->release = hashed_ids_release;
+  dic->get = hashed_ids_to_id;
+  dic->to_id = hashed_ids_to_id;
+  dic->to_string = hashed_ids_to_string;
+  dic->num = hashed_ids_num;
+  dic->free = hashed_ids_free;
+  return dic;
+}
 
-    /* Progress indicator */
-    if ((i + 1) % 500 == 0 || i == data->num_sequences - 1) {
-      printf("  Processed %d/%d sequences\n", i + 1, data->num_sequences);
+/* Copy crf_data into hashed, replacing every attribute ID with the hash of
+ * its string; colliding attributes share an ID */
+static int hash_crf_data(crfsuite_data_t *crf_data, int hash_bits,
+                         crfsuite_data_t *hashed) {
+  int num_attrs = crf_data->attrs->num(crf_data->attrs);
+  int *map = malloc((num_attrs > 0 ? num_attrs : 1) * sizeof(int));
+
+  memset(hashed, 0, sizeof(*hashed));
+  if (!map)
+    return -1;
+
+  for (int aid = 0; aid < num_attrs; aid++) {
+    const char *str = NULL;
+
+    crf_data->attrs->to_string(crf_data->attrs, aid, &str);
+    map[aid] = crf1dm_hash_attr(str, hash_bits);
+    crf_data->attrs->free(crf_data->attrs, str);
+  }
+
+  crfsuite_data_copy(hashed, crf_data);
+  for (int i = 0; i < hashed->num_instances; i++) {
+    crfsuite_instance_t *inst = &hashed->instances[i];
+
+    for (int t = 0; t < inst->num_items; t++) {
+      crfsuite_item_t *item = &inst->items[t];
+
+      for (int c = 0; c < item->num_contents; c++)
+        item->contents[c].aid = map[item->contents[c].aid];
     }
   }
+  free(map);
+
+  hashed->attrs = create_hashed_ids(1 << hash_bits);
+  hashed->labels = crf_data->labels;
+  hashed->labels->addref(hashed->labels);
+  return hashed->attrs ? 0 : -1;
+}
+
+/* Rewrite the model the trainer saved from hashed data as a hashed v2
+ * model, which stores no attribute strings */
+static int save_hashed_model(const char *model_file, int hash_bits) {
+  crf1dm_t *model = crf1dm_new(model_file);
+  crf1dm_source_t src;
+  const char **labels = NULL;
+  crf1dm_feature_t *features = NULL;
+  char tmp_file[4096];
+  int ret = -1;
+
+  if (!model)
+    return -1;
+
+  memset(&src, 0, sizeof(src));
+  src.num_labels = crf1dm_get_num_labels(model);
+  src.num_attrs = 1 << hash_bits;
+  src.num_features = crf1dm_get_num_features(model);
+  src.hash_bits = hash_bits;
+
+  labels = calloc(src.num_labels + 1, sizeof(char *));
+  features = calloc(src.num_features + 1, sizeof(crf1dm_feature_t));
+  if (!labels || !features)
+    goto cleanup;
+
+  for (int l = 0; l < src.num_labels; l++)
+    labels[l] = crf1dm_to_label(model, l);
+  for (int k = 0; k < src.num_features; k++) {
+    crf1dm_get_feature(model, k, &features[k]);
+    /* The saved model renumbers attributes; its strings hold the hashes */
+    if (features[k].type == FT_STATE)
+      features[k].src = atoi(crf1dm_to_attr(model, features[k].src));
+  }
+  src.labels = labels;
+  src.features = features;
+
+  /* The model may be mapped from model_file, so write next to it */
+  snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", model_file);
+  if (crf1dm_write_v2(tmp_file, &src) == 0 &&
+      rename(tmp_file, model_file) == 0)
+    ret = 0;
+  else
+    unlink(tmp_file);
+
+cleanup:
+  free(features);
+  free(labels);
+  crf1dm_close(model);
+  return ret;
+}
 
-  printf("Created %d training instances\n", crf_data.num_instances);
-  printf("Attributes: %d, Labels: %d\n", crf_data.attrs->num(crf_data.attrs),
-         crf_data.labels->num(crf_data.labels));
+/* Print the number of nonzero features kept in a saved model */
+static void report_model_size(const char *model_file) {
+  crf1dm_t *model = crf1dm_new(model_file);
+  struct stat st;
+
+  if (!model)
+    return;
+  printf("  Nonzero features: %d\n", crf1dm_get_num_features(model));
+  printf("  Attributes: %d, labels: %d\n", crf1dm_get_num_attrs(model),
+         crf1dm_get_num_labels(model));
+  if (stat(model_file, &st) == 0)
+    printf("  Model size: %lld bytes\n", (long long)st.st_size);
+  crf1dm_close(model);
+}
+
+int run_crf_trainer(crfsuite_data_t *crf_data, const char *output_file,
+                    TrainingConfig *config, bool verbose) {
+  crfsuite_trainer_t *trainer = NULL;
+  crfsuite_params_t *params = NULL;
+  crfsuite_data_t hashed;
+  crfsuite_data_t *train_data = crf_data;
+  /* L1 needs OWL-QN; L2SGD only supports L2 regularization */
+  bool use_lbfgs = config->c1 > 0;
+  int ret = -1;
+
+  if (config->hash_bits > 0) {
+    if (config->hash_bits > MAX_HASH_BITS) {
+      fprintf(stderr, "Error: Hash bits must be between 1 and %d\n",
+              MAX_HASH_BITS);
+      return -1;
+    }
+    if (hash_crf_data(crf_data, config->hash_bits, &hashed) != 0) {
+      fprintf(stderr, "Error: Out of memory\n");
+      free_crf_data(&hashed);
+      return -1;
+    }
+    train_data = &hashed;
+  }
 
   /* Create trainer - crfsuite_create_instance returns 1 on success, 0 on
    * failure */
-  if (crfsuite_create_instance("train/crf1d/l2sgd", (void **)&trainer) == 0) {
-    fprintf(stderr, "Error: Failed to create L2SGD trainer\n");
-    goto cleanup;
+  if (crfsuite_create_instance(use_lbfgs ? "train/crf1d/lbfgs"
+                                         : "train/crf1d/l2sgd",
+                               (void **)&trainer) == 0) {
+    fprintf(stderr, "Error: Failed to create %s trainer\n",
+            use_lbfgs ? "L-BFGS" : "L2SGD");
+    if (train_data == &hashed)
+      free_crf_data(&hashed);
+    return -1;
   }
 
   /* Set training parameters */
   params = trainer->params(trainer);
+  if (use_lbfgs)
+    params->set_float(params, "c1", config->c1);
   params->set_float(params, "c2", config->c2);
   params->set_int(params, "max_iterations", config->max_iterations);
   params->set_float(params, "epsilon", config->epsilon);
+  params->release(params);
 
   /* Set logging callback */
-  trainer->set_message_callback(trainer, NULL, training_callback);
+  trainer->set_message_callback(
+      trainer, NULL, verbose ? training_callback : quiet_callback);
 
-  /* Train! */
-  printf("\nStarting training with L2SGD algorithm...\n");
-  printf("  C2 regularization: %.4f\n", config->c2);
-  printf("  Max iterations: %d\n", config->max_iterations);
-  printf("  Epsilon: %.6f\n\n", config->epsilon);
+  if (verbose) {
+    if (use_lbfgs) {
+      printf("\nStarting training with OWL-QN (L-BFGS) algorithm...\n");
+      printf("  C1 regularization: %.4f\n", config->c1);
+    } else {
+      printf("\nStarting training with L2SGD algorithm...\n");
+    }
+    if (config->hash_bits > 0)
+      printf("  Hashed attributes: %d bits (%d IDs)\n", config->hash_bits,
+             1 << config->hash_bits);
+    printf("  C2 regularization: %.4f\n", config->c2);
+    printf("  Max iterations: %d\n", config->max_iterations);
+    printf("  Epsilon: %.6f\n\n", config->epsilon);
+  }
+
+  ret = trainer->train(trainer, train_data, output_file, -1);
 
-  ret = trainer->train(trainer, &crf_data, output_file, -1);
+  trainer->release(trainer);
 
-  if (ret == 0) {
-    printf("\nTraining completed successfully!\n");
-    printf("Model saved to: %s\n", output_file);
-  } else {
-    fprintf(stderr, "\nTraining failed with error code: %d\n", ret);
+  if (train_data == &hashed) {
+    free_crf_data(&hashed);
+    if (ret == 0 && save_hashed_model(output_file, config->hash_bits) != 0) {
+      fprintf(stderr, "Error: Failed to save hashed model %s\n", output_file);
+      ret = -1;
+    }
   }
 
-cleanup:
-  /* Free resources */
-  if (trainer)
-    trainer->release(trainer);
+  if (ret == 0 && verbose)
+    report_model_size(output_file);
+  return ret;
+}
 
-  for (int i = 0; i < crf_data.num_instances; i++) {
-    crfsuite_instance_finish(&crf_data.instances[i]);
-  }
-  free(crf_data.instances);
+/* Train CRF model from training data */
+int train_crf_model(TrainingData *data, const char *output_file,
+                    TrainingConfig *config) {
+  crfsuite_data_t crf_data;
+  int ret = -1;
+
+  printf("Training CRF model with %d sequences...\n", data->num_sequences);
+
+  if (build_crf_data(data, &crf_data, config->num_threads) == 0 &&
+      apply_attribute_profile(&crf_data, config) == 0 &&
+      collapse_duplicate_instances(&crf_data, config) == 0) {
+    /* Train! */
+    ret = run_crf_trainer(&crf_data, output_file, config, true);
 
-  if (crf_data.attrs)
-    crf_data.attrs->release(crf_data.attrs);
-  if (crf_data.labels)
-    crf_data.labels->release(crf_data.labels);
+    if (ret == 0) {
+      printf("\nTraining completed successfully!\n");
+      printf("Model saved to: %s\n", output_file);
+    } else {
+      fprintf(stderr, "\nTraining failed with error code: %d\n", ret);
+    }
+  }
 
+  free_crf_data(&crf_data);
   return ret;
 }
 
-/* Train generic model from both person and company data */
-int train_generic_model(const char *person_file, const char *company_file,
-                        const char *output_file, TrainingConfig *config) {
+/* Parse and combine person and company data: person sequences first */
+TrainingData *load_generic_training_data(const char *person_file,
+                                         const char *company_file) {
   /* Parse both files */
   TrainingData *person_data = parse_training_file(person_file);
   TrainingData *company_data = parse_training_file(company_file);
 
   if (!person_data && !company_data) {
     fprintf(stderr, "Error: Could not parse any training files\n");
-    return -1;
+    return NULL;
   }
 
-  /* Combine data */
-  TrainingData combined;
-  int total_sequences = (person_data ? person_data->num_sequences : 0) +
-                        (company_data ? company_data->num_sequences : 0);
-
-  combined.sequences = malloc(total_sequences * sizeof(LabeledSequence));
-  combined.num_sequences = 0;
-  combined.capacity = total_sequences;
-
-  if (person_data) {
-    for (int i = 0; i < person_data->num_sequences; i++) {
-      combined.sequences[combined.num_sequences++] = person_data->sequences[i];
-    }
-    /* Don't free individual sequences, just the array */
-    free(person_data->sequences);
-    free(person_data);
+  if (person_data && company_data &&
+      merge_training_data(person_data, company_data) != 0) {
+    fprintf(stderr, "Error: Out of memory\n");
+    free_training_data(person_data);
+    free_training_data(company_data);
+    return NULL;
   }
 
-  if (company_data) {
-    for (int i = 0; i < company_data->num_sequences; i++) {
-      combined.sequences[combined.num_sequences++] = company_data->sequences[i];
-    }
-    free(company_data->sequences);
-    free(company_data);
-  }
+  TrainingData *combined = person_data ? person_data : company_data;
+  printf("Combined training data: %d sequences\n", combined->num_sequences);
+  return combined;
+}
+
+/* Train generic model from both person and company data */
+int train_generic_model(const char *person_file, const char *company_file,
+                        const char *output_file, TrainingConfig *config) {
+  TrainingData *combined =
+      load_generic_training_data(person_file, company_file);
 
-  printf("Combined training data: %d sequences\n", combined.num_sequences);
+  if (!combined)
+    return -1;
 
-  int ret = train_crf_model(&combined, output_file, config);
+  int ret = train_crf_model(combined, output_file, config);
 
-  /* Free combined data */
-  for (int i = 0; i < combined.num_sequences; i++) {
-    for (int j = 0; j < combined.sequences[i].num_tokens; j++) {
-      free(combined.sequences[i].tokens[j].text);
-      free(combined.sequences[i].tokens[j].label);
-    }
-    free(combined.sequences[i].tokens);
-  }
-  free(combined.sequences);
+  free_training_data(combined);
 
   return ret;
 }
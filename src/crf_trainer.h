@@ -7,9 +7,25 @@
 
 /* Training configuration */
 typedef struct {
+  float c1;           /* L1 regularization coefficient (default: 0, > 0
+                         trains with OWL-QN instead of L2SGD) */
   float c2;           /* L2 regularization coefficient (default: 1.0) */
   int max_iterations; /* Maximum iterations (default: 100) */
   float epsilon;      /* Convergence threshold (default: 0.0001) */
+  int num_threads;    /* Data conversion threads (default: 0, one per CPU) */
+  int hash_bits;      /* Feature hashing: attribute IDs are hashes reduced to
+                         this many bits and the saved model is a v2 model
+                         without attribute strings (default: 0, off) */
+  const char *profile_file; /* Attribute profile from dump_attribute_profile
+                               (default: NULL, train on every attribute) */
+  unsigned long min_hits;   /* Drop attributes that fired fewer times than
+                               this in the profile (default: 1) */
+  bool keep_duplicates;     /* Train on every sequence instead of collapsing
+                               identical ones into weighted instances
+                               (default: false) */
+  bool collapse_duplicates; /* Collapse for L2SGD too, which then learns a
+                               slightly different model (default: false,
+                               only OWL-QN collapses) */
 } TrainingConfig;
 
 /* Initialize default training config */
@@ -25,4 +41,50 @@ int train_crf_model(TrainingData *data, const char *output_file,
 int train_generic_model(const char *person_file, const char *company_file,
                         const char *output_file, TrainingConfig *config);
 
+/* Parse person and company files into one TrainingData (person first) */
+TrainingData *load_generic_training_data(const char *person_file,
+                                         const char *company_file);
+
+/* Build CRFSuite dictionaries and instances from training data
+ * Returns 0 on success; free_crf_data must be called either way
+ */
+int build_crf_data(TrainingData *data, crfsuite_data_t *crf_data,
+                   int num_threads);
+
+/* Drop the attributes that fired fewer than config->min_hits times in
+ * config->profile_file from the instances of crf_data, so no features are
+ * trained for them. Does nothing without a profile.
+ * Returns 0 on success, non-zero on error
+ */
+int apply_attribute_profile(crfsuite_data_t *crf_data, TrainingConfig *config);
+
+/* Whether training with config collapses duplicate sequences: by default
+ * only with OWL-QN (c1 > 0), whose objective a weighted instance leaves
+ * unchanged. L2SGD takes one step scaled by the weight where the copies
+ * would take one step each, so it only collapses if collapse_duplicates is
+ * set, and keep_duplicates turns collapsing off for both.
+ */
+bool collapses_duplicates(const TrainingConfig *config);
+
+/* Merge instances of crf_data with the same items, labels and group into
+ * the first of them, whose weight becomes the sum of theirs, so each epoch
+ * evaluates fewer sequences. Does nothing unless
+ * collapses_duplicates(config).
+ * Returns 0 on success, non-zero on error
+ */
+int collapse_duplicate_instances(crfsuite_data_t *crf_data,
+                                 TrainingConfig *config);
+
+/* Free CRFSuite data built by build_crf_data */
+void free_crf_data(crfsuite_data_t *crf_data);
+
+/* Train on all instances of crf_data and save the model to output_file,
+ * printing training progress and the size of the saved model when verbose
+ *
+ * With config->hash_bits, training runs on a copy of the instances whose
+ * attribute IDs are hashed, and the saved model is a hashed v2 model.
+ */
+int run_crf_trainer(crfsuite_data_t *crf_data, const char *output_file,
+                    TrainingConfig *config, bool verbose);
+
 #endif /* CRF_TRAINER_H */
@@ -226,6 +226,18 @@ const char* cqdb_to_string(cqdb_t* db, int id);
  */
 int cqdb_num(cqdb_t* db);
 
+/**
+ * Get the heap memory held by the database reader.
+ *
+ *    This function returns the bytes allocated by cqdb_reader(): the reader
+ *    itself and the hash buckets and backward links it copies out of the
+ *    memory block. The memory block is not included.
+ *
+ *    @param    db            The pointer to the ::cqdb_t instance.
+ *    @retval    size_t        The number of bytes.
+ */
+size_t cqdb_get_memory(cqdb_t* db);
+
 /** @} */
 
 
@@ -523,7 +523,8 @@ struct tag_crfsuite_dictionary {
      *  @param  dic         The pointer to this dictionary instance.
      *  @param  str         The string.
      *  @return int         The ID associated with the string if any,
-     *                      the new ID otherwise.
+     *                      the new ID otherwise, or \c -1 if the new ID
+     *                      could not be allocated.
      */
     int (*get)(crfsuite_dictionary_t* dic, const char *str);
 
@@ -735,6 +736,16 @@ struct tag_crfsuite_params {
  */
 int crfsuite_create_instance(const char *iid, void **ptr);
 
+/**
+ * Create a dictionary object directly, without crfsuite_create_instance().
+ *  @param  interface   The interface identifier, \c "dictionary".
+ *  @param  ptr         The pointer to \c void* that points to the
+ *                      dictionary object if successful.
+ *  @return int         \c 0 if this function creates an object successfully,
+ *                      non-zero otherwise.
+ */
+int crfsuite_dictionary_create_instance(const char *interface, void **ptr);
+
 /**
  * Create an instance of a model object from a model file.
  *  @param  filename    The filename of the model.
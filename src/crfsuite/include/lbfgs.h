@@ -0,0 +1,178 @@
+/*
+ *      Limited-memory BFGS (L-BFGS) and OWL-QN solver.
+ *
+ * This is a self-contained implementation of the subset of the liblbfgs
+ * API that train_lbfgs.c uses, so that CRFsuite's L-BFGS trainer (and its
+ * L1-regularized OWL-QN mode) builds without the external library.
+ *
+ * Differences from liblbfgs:
+ *  - All line searches are backtracking searches; LBFGS_LINESEARCH_MORETHUENTE
+ *    is accepted and runs a backtracking search with the strong Wolfe
+ *    condition.
+ *  - Vectors are allocated with plain malloc (no SSE alignment).
+ */
+
+#ifndef    __LBFGS_H__
+#define    __LBFGS_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif/*__cplusplus*/
+
+typedef double lbfgsfloatval_t;
+
+/**
+ * Return values of lbfgs().
+ */
+enum {
+    /** L-BFGS reaches convergence. */
+    LBFGS_SUCCESS = 0,
+    LBFGS_CONVERGENCE = 0,
+    /** The stopping criterion (delta over past iterations) was met. */
+    LBFGS_STOP,
+    /** The initial variables already minimize the objective function. */
+    LBFGS_ALREADY_MINIMIZED,
+
+    /** Unknown error. */
+    LBFGSERR_UNKNOWNERROR = -1024,
+    /** Insufficient memory. */
+    LBFGSERR_OUTOFMEMORY,
+    /** The minimization process has been canceled. */
+    LBFGSERR_CANCELED,
+    /** Invalid number of variables specified. */
+    LBFGSERR_INVALID_N,
+    /** Invalid parameter in lbfgs_parameter_t. */
+    LBFGSERR_INVALID_PARAMETERS,
+    /** The line-search step became smaller than min_step. */
+    LBFGSERR_MINIMUMSTEP,
+    /** The line-search step became larger than max_step. */
+    LBFGSERR_MAXIMUMSTEP,
+    /** The line-search routine reaches the maximum number of evaluations. */
+    LBFGSERR_MAXIMUMLINESEARCH,
+    /** The algorithm routine reaches the maximum number of iterations. */
+    LBFGSERR_MAXIMUMITERATION,
+    /** The current search direction increases the objective function. */
+    LBFGSERR_INCREASEGRADIENT,
+};
+
+/**
+ * Line search algorithms.
+ */
+enum {
+    /** The default algorithm. */
+    LBFGS_LINESEARCH_DEFAULT = 0,
+    /** Accepted for compatibility; same as strong Wolfe backtracking. */
+    LBFGS_LINESEARCH_MORETHUENTE = 0,
+    /** Backtracking with the Armijo (sufficient decrease) condition. */
+    LBFGS_LINESEARCH_BACKTRACKING_ARMIJO = 1,
+    /** Backtracking with the regular Wolfe condition. */
+    LBFGS_LINESEARCH_BACKTRACKING = 2,
+    LBFGS_LINESEARCH_BACKTRACKING_WOLFE = 2,
+    /** Backtracking with the strong Wolfe condition. */
+    LBFGS_LINESEARCH_BACKTRACKING_STRONG_WOLFE = 3,
+};
+
+/**
+ * L-BFGS optimization parameters.
+ *  Call lbfgs_parameter_init() to fill in the defaults.
+ */
+typedef struct {
+    /** The number of corrections to approximate the inverse hessian. */
+    int             m;
+    /** Epsilon for the convergence test ||g|| / max(1, ||x||) < epsilon. */
+    lbfgsfloatval_t epsilon;
+    /** Distance (in iterations) for the delta-based convergence test. */
+    int             past;
+    /** Delta for the convergence test (f' - f) / f < delta. */
+    lbfgsfloatval_t delta;
+    /** The maximum number of iterations (0: no limit). */
+    int             max_iterations;
+    /** The line search algorithm. */
+    int             linesearch;
+    /** The maximum number of trials for the line search. */
+    int             max_linesearch;
+    /** The minimum step of the line search routine. */
+    lbfgsfloatval_t min_step;
+    /** The maximum step of the line search routine. */
+    lbfgsfloatval_t max_step;
+    /** Parameter controlling the accuracy of the line search (Armijo). */
+    lbfgsfloatval_t ftol;
+    /** Coefficient for the Wolfe condition. */
+    lbfgsfloatval_t wolfe;
+    /** Coefficient of the L1 norm; enables OWL-QN when positive. */
+    lbfgsfloatval_t orthantwise_c;
+    /** Index of the first variable subject to the L1 norm. */
+    int             orthantwise_start;
+    /** Index after the last variable subject to the L1 norm (-1: n). */
+    int             orthantwise_end;
+} lbfgs_parameter_t;
+
+/**
+ * Callback that computes the objective value and its gradient at x.
+ */
+typedef lbfgsfloatval_t (*lbfgs_evaluate_t)(
+    void *instance,
+    const lbfgsfloatval_t *x,
+    lbfgsfloatval_t *g,
+    const int n,
+    const lbfgsfloatval_t step
+    );
+
+/**
+ * Callback that receives the progress of each iteration.
+ *  Returning a non-zero value cancels the optimization.
+ */
+typedef int (*lbfgs_progress_t)(
+    void *instance,
+    const lbfgsfloatval_t *x,
+    const lbfgsfloatval_t *g,
+    const lbfgsfloatval_t fx,
+    const lbfgsfloatval_t xnorm,
+    const lbfgsfloatval_t gnorm,
+    const lbfgsfloatval_t step,
+    int n,
+    int k,
+    int ls
+    );
+
+/**
+ * Minimize a function with L-BFGS (or OWL-QN when orthantwise_c > 0).
+ *  @param  n           The number of variables.
+ *  @param  x           The initial variables; receives the final variables.
+ *  @param  ptr_fx      Receives the final objective value (may be NULL).
+ *  @param  proc_evaluate   The objective callback.
+ *  @param  proc_progress   The progress callback (may be NULL).
+ *  @param  instance    User data forwarded to the callbacks.
+ *  @param  param       Parameters (NULL for the defaults).
+ *  @return int         One of the LBFGS_* or LBFGSERR_* values.
+ */
+int lbfgs(
+    int n,
+    lbfgsfloatval_t *x,
+    lbfgsfloatval_t *ptr_fx,
+    lbfgs_evaluate_t proc_evaluate,
+    lbfgs_progress_t proc_progress,
+    void *instance,
+    lbfgs_parameter_t *param
+    );
+
+/**
+ * Fill param with the default parameters.
+ */
+void lbfgs_parameter_init(lbfgs_parameter_t *param);
+
+/**
+ * Allocate an array of n variables.
+ */
+lbfgsfloatval_t* lbfgs_malloc(int n);
+
+/**
+ * Free an array allocated by lbfgs_malloc().
+ */
+void lbfgs_free(lbfgsfloatval_t *x);
+
+#ifdef    __cplusplus
+}
+#endif/*__cplusplus*/
+
+#endif/*__LBFGS_H__*/
@@ -586,3 +586,17 @@ int cqdb_num(cqdb_t* db)
 {
     return db->num;
 }
+
+size_t cqdb_get_memory(cqdb_t* db)
+{
+    int i;
+    size_t size = sizeof(cqdb_t);
+
+    for (i = 0;i < NUM_TABLES;++i) {
+        size += db->ht[i].num * sizeof(bucket_t);
+    }
+    if (db->bwd != NULL) {
+        size += db->num * sizeof(uint32_t);
+    }
+    return size;
+}
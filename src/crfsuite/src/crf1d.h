@@ -199,6 +199,7 @@ typedef struct {
     (&MATRIX(ctx->backward_edge, ctx->num_labels, 0, t))
 
 crf1d_context_t* crf1dc_new(int flag, int L, int T);
+size_t crf1dc_get_memory(int flag, int L, int T);
 int crf1dc_set_num_items(crf1d_context_t* ctx, int T);
 void crf1dc_delete(crf1d_context_t* ctx);
 void crf1dc_reset(crf1d_context_t* ctx, int flag);
@@ -333,11 +334,39 @@ int crf1dmw_open_features(crf1dmw_t* writer);
 int crf1dmw_close_features(crf1dmw_t* writer);
 int crf1dmw_put_feature(crf1dmw_t* writer, int fid, const crf1dm_feature_t* f);
 
+/**
+ * Arrays describing a model, for crf1dm_write_v2().
+ */
+typedef struct {
+    int                     num_labels;
+    int                     num_attrs;
+    const char**            labels;         /**< Label strings [num_labels]. */
+    const char**            attrs;          /**< Attribute strings [num_attrs]. */
+    int                     num_features;
+    const crf1dm_feature_t* features;       /**< Features, in any order. */
+    /**
+     * Zero for a dictionary model. Otherwise attribute ids are the values
+     * of crf1dm_hash_attr(str, hash_bits), num_attrs must be
+     * 1 << hash_bits, and attrs is not used.
+     */
+    int                     hash_bits;
+} crf1dm_source_t;
+
+/**
+ * Write a version 2 model: native byte order, cache-line-aligned CSR state
+ * features, a dense transition matrix, and prebuilt hash indices for the
+ * label and attribute strings. crf1dm_new() maps such a file and uses it
+ * in place; version 1 files still load as before.
+ */
+int crf1dm_write_v2(const char *filename, const crf1dm_source_t* src);
+int crf1dm_save_v2(crf1dm_t* model, const char *filename);
+
 crf1dm_t* crf1dm_new(const char *filename);
 crf1dm_t* crf1dm_new_from_memory(const void *data, size_t size);
 void crf1dm_close(crf1dm_t* model);
 int crf1dm_get_num_attrs(crf1dm_t* model);
 int crf1dm_get_num_labels(crf1dm_t* model);
+int crf1dm_get_num_features(crf1dm_t* model);
 const char *crf1dm_to_label(crf1dm_t* model, int lid);
 int crf1dm_to_lid(crf1dm_t* model, const char *value);
 int crf1dm_to_aid(crf1dm_t* model, const char *value);
@@ -347,6 +376,51 @@ int crf1dm_get_attrref(crf1dm_t* model, int aid, feature_refs_t* ref);
 int crf1dm_get_featureid(feature_refs_t* ref, int i);
 int crf1dm_get_feature(crf1dm_t* model, int fid, crf1dm_feature_t* f);
 void crf1dm_dump(crf1dm_t* model, FILE *fp);
+int crf1dm_get_version(crf1dm_t* model);
+int crf1dm_get_state_weights(crf1dm_t* model, int aid, const int **dst, const floatval_t **weight);
+const floatval_t* crf1dm_get_transitions(crf1dm_t* model);
+
+/**
+ * Memory held by a loaded model. Only buffer, structures and cqdb are heap
+ * allocations; a mapped or borrowed file counts in file alone.
+ */
+typedef struct {
+    size_t file;        /**< Size of the model file or memory image. */
+    size_t buffer;      /**< Private copy of the file, if one was read. */
+    size_t structures;  /**< Model objects and the decoded header. */
+    size_t cqdb;        /**< CQDB hash buckets and backward links. */
+} crf1dm_memory_t;
+
+void crf1dm_get_memory(crf1dm_t* model, crf1dm_memory_t* mem);
+
+/* Adds the crfsuite_model_t objects around the crf1dm_t. */
+void crf1dt_get_model_memory(crfsuite_model_t* model, crf1dm_memory_t* mem);
+/* A tagger of L labels with room for T items, as get_tagger() makes. */
+size_t crf1dt_get_tagger_memory(int L, int T);
+
+/**
+ * Feature hashing: a hashed model stores no attribute strings.
+ * crf1dm_to_aid() computes crf1dm_hash_attr() of any string instead of
+ * looking it up, and crf1dm_to_attr() returns NULL.
+ */
+int crf1dm_get_hash_bits(crf1dm_t* model);
+int crf1dm_hash_attr(const char *value, int hash_bits);
+
+/**
+ * A region of a model file, for crf1dm_get_sections().
+ */
+typedef struct {
+    const char*     name;   /**< Section name, e.g., "features" or "attr_hash". */
+    unsigned int    offset; /**< Offset from the head of the file. */
+    unsigned int    size;   /**< Size in bytes, excluding alignment padding. */
+} crf1dm_section_t;
+
+/**
+ * Describe the sections of a model file, including its header, in file
+ * order. At most n entries are written to sections; the return value is
+ * the number of sections the file has.
+ */
+int crf1dm_get_sections(crf1dm_t* model, crf1dm_section_t* sections, int n);
 
 /** @} */
 
@@ -83,6 +83,30 @@ error_exit:
     return NULL;
 }
 
+size_t crf1dc_get_memory(int flag, int L, int T)
+{
+    /* The allocations of crf1dc_new() and crf1dc_set_num_items(). */
+    size_t n = sizeof(crf1d_context_t);
+
+    n += (size_t)L * L * sizeof(floatval_t);
+    if (flag & CTXF_MARGINALS) {
+        n += ((size_t)L * L + 4) * sizeof(floatval_t);
+        n += (size_t)L * L * sizeof(floatval_t);
+    }
+    n += 2 * (size_t)T * L * sizeof(floatval_t);    /* alpha, beta */
+    n += (size_t)T * sizeof(floatval_t);            /* scale_factor */
+    n += (size_t)L * sizeof(floatval_t);            /* row */
+    if (flag & CTXF_VITERBI) {
+        n += (size_t)T * L * sizeof(int);
+    }
+    n += (size_t)T * L * sizeof(floatval_t);        /* state */
+    if (flag & CTXF_MARGINALS) {
+        n += ((size_t)T * L + 4) * sizeof(floatval_t);
+        n += (size_t)T * L * sizeof(floatval_t);
+    }
+    return n;
+}
+
 int crf1dc_set_num_items(crf1d_context_t* ctx, int T)
 {
     const int L = ctx->num_labels;
@@ -37,6 +37,7 @@
 
 #include <os.h>
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,20 +46,28 @@
 
 #include "logging.h"
 #include "crf1d.h"
-#include "rumavl.h"    /* AVL tree library necessary for feature generation. */
 
 /**
  * Feature set.
+ *
+ *  Features are stored in insertion order and indexed by an open-addressing
+ *  hash table keyed on (type, src, dst). featureset_generate() sorts them by
+ *  that key, so the feature IDs do not depend on the hash function.
  */
 typedef struct {
-    RUMAVL* avl;    /**< Root node of the AVL tree. */
-    int num;        /**< Number of features in the AVL tree. */
+    crf1df_feature_t* features; /**< Features in insertion order. */
+    int num;        /**< Number of features in the set. */
+    int max;        /**< Allocated size of the features array. */
+    int* buckets;   /**< Hash table of feature indices, -1 if empty. */
+    uint32_t num_buckets;   /**< Number of buckets (a power of two). */
 } featureset_t;
 
+#define    FEATURESET_INITIAL_BUCKETS    4096
+
 
 #define    COMP(a, b)    ((a)>(b))-((a)<(b))
 
-static int featureset_comp(const void *x, const void *y, size_t n, void *udata)
+static int featureset_comp(const void *x, const void *y)
 {
     int ret = 0;
     const crf1df_feature_t* f1 = (const crf1df_feature_t*)x;
@@ -74,17 +83,29 @@ static int featureset_comp(const void *x, const void *y, size_t n, void *udata)
     return ret;
 }
 
+static uint32_t featureset_hash(const crf1df_feature_t* f)
+{
+    /* Mix the key with multiplicative hashing; dst is a small label ID. */
+    uint64_t h = ((uint64_t)(uint32_t)f->src << 32) |
+        ((uint32_t)f->dst << 1) | (uint32_t)f->type;
+    h *= 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(h >> 32);
+}
+
 static featureset_t* featureset_new()
 {
+    uint32_t i;
     featureset_t* set = NULL;
     set = (featureset_t*)calloc(1, sizeof(featureset_t));
     if (set != NULL) {
-        set->num = 0;
-        set->avl = rumavl_new(
-            sizeof(crf1df_feature_t), featureset_comp, NULL, NULL);
-        if (set->avl == NULL) {
+        set->num_buckets = FEATURESET_INITIAL_BUCKETS;
+        set->buckets = (int*)malloc(sizeof(int) * set->num_buckets);
+        if (set->buckets == NULL) {
             free(set);
-            set = NULL;
+            return NULL;
+        }
+        for (i = 0;i < set->num_buckets;++i) {
+            set->buckets[i] = -1;
         }
     }
     return set;
@@ -93,22 +114,74 @@ static featureset_t* featureset_new()
 static void featureset_delete(featureset_t* set)
 {
     if (set != NULL) {
-        rumavl_destroy(set->avl);
+        free(set->buckets);
+        free(set->features);
         free(set);
     }
 }
 
+static int featureset_grow(featureset_t* set)
+{
+    int k;
+    uint32_t i;
+    const uint32_t num_buckets = set->num_buckets * 2;
+    const uint32_t mask = num_buckets - 1;
+    int* buckets = (int*)malloc(sizeof(int) * num_buckets);
+
+    if (buckets == NULL) {
+        return CRFSUITEERR_OUTOFMEMORY;
+    }
+    for (i = 0;i < num_buckets;++i) {
+        buckets[i] = -1;
+    }
+    for (k = 0;k < set->num;++k) {
+        i = featureset_hash(&set->features[k]) & mask;
+        while (0 <= buckets[i]) {
+            i = (i + 1) & mask;
+        }
+        buckets[i] = k;
+    }
+
+    free(set->buckets);
+    set->buckets = buckets;
+    set->num_buckets = num_buckets;
+    return 0;
+}
+
 static int featureset_add(featureset_t* set, const crf1df_feature_t* f)
 {
+    const uint32_t mask = set->num_buckets - 1;
+    uint32_t i = featureset_hash(f) & mask;
+
     /* Check whether if the feature already exists. */
-    crf1df_feature_t *p = (crf1df_feature_t*)rumavl_find(set->avl, f);
-    if (p == NULL) {
-        /* Insert the feature to the feature set. */
-        rumavl_insert(set->avl, f);
-        ++set->num;
-    } else {
-        /* An existing feature: add the observation expectation. */
-        p->freq += f->freq;
+    while (0 <= set->buckets[i]) {
+        crf1df_feature_t *p = &set->features[set->buckets[i]];
+        if (p->type == f->type && p->src == f->src && p->dst == f->dst) {
+            /* An existing feature: add the observation expectation. */
+            p->freq += f->freq;
+            return 0;
+        }
+        i = (i + 1) & mask;
+    }
+
+    /* Insert the feature to the feature set. */
+    if (set->max <= set->num) {
+        int max = (set->max + 1) * 2;
+        crf1df_feature_t* features = (crf1df_feature_t*)realloc(
+            set->features, sizeof(crf1df_feature_t) * max);
+        if (features == NULL) {
+            return CRFSUITEERR_OUTOFMEMORY;
+        }
+        set->features = features;
+        set->max = max;
+    }
+    set->features[set->num] = *f;
+    set->buckets[i] = set->num;
+    ++set->num;
+
+    /* Keep the load factor at or below 1/2. */
+    if (set->num_buckets < (uint32_t)set->num * 2) {
+        return featureset_grow(set);
     }
     return 0;
 }
@@ -120,28 +193,21 @@ featureset_generate(
     floatval_t minfreq
     )
 {
-    int n = 0, k = 0;
-    RUMAVL_NODE *node = NULL;
-    crf1df_feature_t *f = NULL;
+    int i, n = 0;
     crf1df_feature_t *features = NULL;
 
-    /* The first pass: count the number of valid features. */
-    while ((node = rumavl_node_next(set->avl, node, 1, (void**)&f)) != NULL) {
-        if (minfreq <= f->freq) {
-            ++n;
-        }
-    }
-
-    /* The second path: copy the valid features to the feature array. */
-    features = (crf1df_feature_t*)calloc(n, sizeof(crf1df_feature_t));
+    /* Copy the valid features to the feature array. */
+    features = (crf1df_feature_t*)calloc(set->num > 0 ? set->num : 1, sizeof(crf1df_feature_t));
     if (features != NULL) {
-        node = NULL;
-        while ((node = rumavl_node_next(set->avl, node, 1, (void**)&f)) != NULL) {
-            if (minfreq <= f->freq) {
-                memcpy(&features[k], f, sizeof(crf1df_feature_t));
-                ++k;
+        for (i = 0;i < set->num;++i) {
+            if (minfreq <= set->features[i].freq) {
+                features[n++] = set->features[i];
             }
         }
+
+        /* Order the features by (type, src, dst). */
+        qsort(features, n, sizeof(crf1df_feature_t), featureset_comp);
+
         *ptr_num_features = n;
         return features;
     } else {
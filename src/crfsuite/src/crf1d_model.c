@@ -38,6 +38,14 @@
 #include <string.h>
 #include <cqdb.h>
 
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CRF1DM_USE_MMAP 1
+#endif/*_MSC_VER*/
+
 #include <crfsuite.h>
 #include "crf1d.h"
 
@@ -51,6 +59,26 @@
 #define CHUNK_SIZE      12
 #define FEATURE_SIZE    20
 
+/*
+ * Version 2 ("zero-parse") layout. The first 16 bytes match version 1 so
+ * that either reader can tell the formats apart; every other field and
+ * section is stored in the byte order of the machine that wrote it, and
+ * each section starts on a cache-line boundary so it can be used in place
+ * from an mmap()ed or otherwise aligned buffer.
+ */
+#define VERSION_NUMBER_V2   (200)
+#define HEADER_SIZE_V2      192
+#define SECTION_ALIGN_V2    64
+
+/*
+ * Attribute ids are hashes of the attribute strings (crf1dm_hash_attr()),
+ * so the model has no attribute string sections and no attribute hash
+ * index; num_attrs is the power of two the hashes are reduced to.
+ */
+#define FLAG_HASHED_ATTRS_V2    0x1
+
+uint32_t hashlittle(const void *key, size_t length, uint32_t initval);
+
 enum {
     WSTATE_NONE,
     WSTATE_LABELS,
@@ -88,6 +116,45 @@ typedef struct {
     uint32_t    num;            /* Number of items. */
 } feature_header_t;
 
+enum {
+    SECTION_ATTR_INDEX,     /* uint32_t [A+1]: first state feature of each attribute */
+    SECTION_STATE_DST,      /* int32_t [S]: destination label of each state feature */
+    SECTION_STATE_WEIGHT,   /* floatval_t [S]: weight of each state feature */
+    SECTION_LABEL_INDEX,    /* uint32_t [L+1]: first transition feature of each label */
+    SECTION_TRANS_DST,      /* int32_t [T]: destination label of each transition */
+    SECTION_TRANSITIONS,    /* floatval_t [L*L]: dense transition weights */
+    SECTION_FIDS,           /* uint32_t [S+T]: 0, 1, ..., little-endian, for feature_refs_t */
+    SECTION_LABEL_OFFSETS,  /* uint32_t [L+1]: offsets of the label strings */
+    SECTION_LABEL_STRINGS,  /* label records: uint32_t id, NUL-terminated string */
+    SECTION_LABEL_HASH,     /* uint32_t [2*buckets]: (hash, string offset) pairs */
+    SECTION_ATTR_OFFSETS,   /* uint32_t [A+1]: offsets of the attribute strings */
+    SECTION_ATTR_STRINGS,   /* attribute records: uint32_t id, NUL-terminated string */
+    SECTION_ATTR_HASH,      /* uint32_t [2*buckets]: (hash, string offset) pairs */
+    NUM_SECTIONS,
+};
+
+typedef struct {
+    uint32_t    offset;         /* Offset from the head of the file. */
+    uint32_t    size;           /* Size in bytes. */
+} section_t;
+
+typedef struct {
+    uint8_t     magic[4];       /* File magic. */
+    uint32_t    size;           /* File size. */
+    uint8_t     type[4];        /* Model type */
+    uint32_t    version;        /* Version number (native byte order). */
+    uint32_t    checksum;       /* checksum_v2() of everything after the header. */
+    uint32_t    flags;          /* FLAG_*_V2 bits. */
+    uint32_t    num_labels;     /* Number of labels (L). */
+    uint32_t    num_attrs;      /* Number of attributes (A). */
+    uint32_t    num_state;      /* Number of state features (S). */
+    uint32_t    num_trans;      /* Number of transition features (T). */
+    uint32_t    label_buckets;  /* Number of buckets in the label hash. */
+    uint32_t    attr_buckets;   /* Number of buckets in the attribute hash
+                                   (zero for hashed attributes). */
+    section_t   sections[NUM_SECTIONS];
+} header2_t;
+
 struct tag_crf1dm {
     uint8_t*       buffer_orig;
     const uint8_t* buffer;
@@ -95,6 +162,24 @@ struct tag_crf1dm {
     header_t*      header;
     cqdb_t*        labels;
     cqdb_t*        attrs;
+
+    /* Version 2: pointers into the buffer. */
+    int                 version;
+    void*               mapped;         /* mmap()ed file, if any. */
+    const header2_t*    header2;
+    const uint32_t*     attr_index;
+    const int32_t*      state_dst;
+    const floatval_t*   state_weight;
+    const uint32_t*     label_index;
+    const int32_t*      trans_dst;
+    const floatval_t*   transitions;
+    const uint32_t*     fids;
+    const uint32_t*     label_offsets;
+    const char*         label_strings;
+    const uint32_t*     label_hash;
+    const uint32_t*     attr_offsets;
+    const char*         attr_strings;
+    const uint32_t*     attr_hash;
 };
 
 struct tag_crf1dmw {
@@ -700,12 +785,478 @@ int crf1dmw_put_feature(crf1dmw_t* writer, int fid, const crf1dm_feature_t* f)
     return 0;
 }
 
+/*
+ * Fletcher-style checksum over 64-bit words. It runs on every load, so it
+ * has to be much cheaper than a byte-wise hash; the sections are padded
+ * to a multiple of 8 bytes.
+ */
+static uint32_t checksum_v2(const uint8_t* p, uint32_t size)
+{
+    uint32_t i;
+    uint64_t a = 0, b = 0, w;
+
+    for (i = 0;i + sizeof(w) <= size;i += sizeof(w)) {
+        memcpy(&w, p + i, sizeof(w));
+        a += w;
+        b += a;
+    }
+    for (;i < size;++i) {
+        a += p[i];
+        b += a;
+    }
+    return (uint32_t)(a ^ (a >> 32) ^ b ^ (b >> 32));
+}
+
+static uint32_t align_v2(uint64_t offset)
+{
+    return (uint32_t)((offset + SECTION_ALIGN_V2 - 1) & ~(uint64_t)(SECTION_ALIGN_V2 - 1));
+}
+
+static uint32_t hash_buckets_v2(int n)
+{
+    /* At most half full, so that probing always reaches an empty bucket. */
+    uint32_t num_buckets = 2;
+    while (num_buckets < 2 * (uint32_t)n) {
+        num_buckets <<= 1;
+    }
+    return num_buckets;
+}
+
+/* Size of the record of a string: its id, then the string, 4-byte aligned. */
+static uint64_t string_record_size(const char *str)
+{
+    return sizeof(uint32_t) + ((strlen(str) + 1 + 3) & ~(size_t)3);
+}
+
+/*
+ * Write the string records and their hash index. A bucket holds the offset
+ * of the string itself, so a lookup touches the bucket and one record; the
+ * offset is never zero because every string follows its id.
+ */
+static void build_strings_v2(
+    const char **strs, int n, uint32_t *offsets, char *strings,
+    uint32_t *buckets, uint32_t num_buckets)
+{
+    int i;
+    uint32_t offset = 0;
+    const uint32_t mask = num_buckets - 1;
+
+    for (i = 0;i < n;++i) {
+        const size_t len = strlen(strs[i]);
+        const uint32_t hash = hashlittle(strs[i], len, 0);
+        const uint32_t id = (uint32_t)i;
+        uint32_t j = hash & mask;
+
+        memcpy(strings + offset, &id, sizeof(id));
+        offsets[i] = offset + sizeof(id);
+        memcpy(strings + offsets[i], strs[i], len + 1);
+        offset += (uint32_t)string_record_size(strs[i]);
+
+        while (buckets[2*j+1] != 0) {
+            j = (j + 1) & mask;
+        }
+        buckets[2*j] = hash;
+        buckets[2*j+1] = offsets[i];
+    }
+    offsets[n] = offset;
+}
+
+int crf1dm_write_v2(const char *filename, const crf1dm_source_t* src)
+{
+    int i, ret = 0;
+    FILE *fp = NULL;
+    header2_t *h = NULL;
+    uint8_t *buffer = NULL;
+    uint32_t *cursor = NULL;
+    uint64_t sizes[NUM_SECTIONS], offset, label_chars = 0, attr_chars = 0;
+    uint32_t S = 0, T = 0, *attr_index, *label_index, *fids;
+    int32_t *state_dst, *trans_dst;
+    floatval_t *state_weight, *transitions;
+    const int L = src->num_labels;
+    const int A = src->num_attrs;
+    const int hashed = (0 < src->hash_bits);
+
+    if (hashed && (30 < src->hash_bits || A != (1 << src->hash_bits))) {
+        return CRFSUITEERR_INCOMPATIBLE;
+    }
+
+    /* Count the features of each kind and check their references. */
+    for (i = 0;i < src->num_features;++i) {
+        const crf1dm_feature_t* f = &src->features[i];
+        if (f->dst < 0 || L <= f->dst) {
+            return CRFSUITEERR_INCOMPATIBLE;
+        }
+        if (f->type == FT_STATE && 0 <= f->src && f->src < A) {
+            ++S;
+        } else if (f->type == FT_TRANS && 0 <= f->src && f->src < L) {
+            ++T;
+        } else {
+            return CRFSUITEERR_INCOMPATIBLE;
+        }
+    }
+    for (i = 0;i < L;++i) {
+        label_chars += string_record_size(src->labels[i]);
+    }
+    for (i = 0;!hashed && i < A;++i) {
+        attr_chars += string_record_size(src->attrs[i]);
+    }
+
+    /* Lay out the sections. */
+    sizes[SECTION_ATTR_INDEX] = 4 * ((uint64_t)A + 1);
+    sizes[SECTION_STATE_DST] = 4 * (uint64_t)S;
+    sizes[SECTION_STATE_WEIGHT] = sizeof(floatval_t) * (uint64_t)S;
+    sizes[SECTION_LABEL_INDEX] = 4 * ((uint64_t)L + 1);
+    sizes[SECTION_TRANS_DST] = 4 * (uint64_t)T;
+    sizes[SECTION_TRANSITIONS] = sizeof(floatval_t) * (uint64_t)L * L;
+    sizes[SECTION_FIDS] = 4 * ((uint64_t)S + T);
+    sizes[SECTION_LABEL_OFFSETS] = 4 * ((uint64_t)L + 1);
+    sizes[SECTION_LABEL_STRINGS] = label_chars;
+    sizes[SECTION_LABEL_HASH] = 8 * (uint64_t)hash_buckets_v2(L);
+    sizes[SECTION_ATTR_OFFSETS] = hashed ? 0 : 4 * ((uint64_t)A + 1);
+    sizes[SECTION_ATTR_STRINGS] = attr_chars;
+    sizes[SECTION_ATTR_HASH] = hashed ? 0 : 8 * (uint64_t)hash_buckets_v2(A);
+
+    offset = HEADER_SIZE_V2;
+    for (i = 0;i < NUM_SECTIONS;++i) {
+        offset = align_v2(offset + sizes[i]);
+        if (UINT32_MAX <= offset) {
+            return CRFSUITEERR_OVERFLOW;
+        }
+    }
+
+    buffer = (uint8_t*)calloc(offset, 1);
+    cursor = (uint32_t*)calloc((A > L ? A : L) + 1, sizeof(uint32_t));
+    if (buffer == NULL || cursor == NULL) {
+        ret = CRFSUITEERR_OUTOFMEMORY;
+        goto exit;
+    }
+
+    /* Fill in the header. */
+    h = (header2_t*)buffer;
+    memcpy(h->magic, FILEMAGIC, 4);
+    memcpy(h->type, MODELTYPE, 4);
+    h->size = (uint32_t)offset;
+    h->version = VERSION_NUMBER_V2;
+    h->num_labels = (uint32_t)L;
+    h->num_attrs = (uint32_t)A;
+    h->num_state = S;
+    h->num_trans = T;
+    h->label_buckets = hash_buckets_v2(L);
+    h->attr_buckets = hashed ? 0 : hash_buckets_v2(A);
+    h->flags = hashed ? FLAG_HASHED_ATTRS_V2 : 0;
+    offset = HEADER_SIZE_V2;
+    for (i = 0;i < NUM_SECTIONS;++i) {
+        h->sections[i].offset = (uint32_t)offset;
+        h->sections[i].size = (uint32_t)sizes[i];
+        offset = align_v2(offset + sizes[i]);
+    }
+
+    attr_index = (uint32_t*)(buffer + h->sections[SECTION_ATTR_INDEX].offset);
+    state_dst = (int32_t*)(buffer + h->sections[SECTION_STATE_DST].offset);
+    state_weight = (floatval_t*)(buffer + h->sections[SECTION_STATE_WEIGHT].offset);
+    label_index = (uint32_t*)(buffer + h->sections[SECTION_LABEL_INDEX].offset);
+    trans_dst = (int32_t*)(buffer + h->sections[SECTION_TRANS_DST].offset);
+    transitions = (floatval_t*)(buffer + h->sections[SECTION_TRANSITIONS].offset);
+    fids = (uint32_t*)(buffer + h->sections[SECTION_FIDS].offset);
+
+    /* Group the state features by attribute and the transition features
+       by source label, keeping their relative order. */
+    for (i = 0;i < src->num_features;++i) {
+        const crf1dm_feature_t* f = &src->features[i];
+        if (f->type == FT_STATE) {
+            ++attr_index[f->src+1];
+        } else {
+            ++label_index[f->src+1];
+        }
+    }
+    for (i = 0;i < A;++i) {
+        attr_index[i+1] += attr_index[i];
+    }
+    for (i = 0;i < L;++i) {
+        label_index[i+1] += label_index[i];
+    }
+
+    memcpy(cursor, attr_index, sizeof(uint32_t) * A);
+    for (i = 0;i < src->num_features;++i) {
+        const crf1dm_feature_t* f = &src->features[i];
+        if (f->type == FT_STATE) {
+            const uint32_t k = cursor[f->src]++;
+            state_dst[k] = f->dst;
+            state_weight[k] = f->weight;
+        }
+    }
+    memcpy(cursor, label_index, sizeof(uint32_t) * L);
+    for (i = 0;i < src->num_features;++i) {
+        const crf1dm_feature_t* f = &src->features[i];
+        if (f->type == FT_TRANS) {
+            const uint32_t k = cursor[f->src]++;
+            trans_dst[k] = f->dst;
+            transitions[f->src * L + f->dst] = f->weight;
+        }
+    }
+
+    /* Feature ids are little-endian, as crf1dm_get_featureid() reads them. */
+    for (i = 0;i < (int)(S + T);++i) {
+        uint8_t *p = (uint8_t*)&fids[i];
+        p[0] = (uint8_t)(i & 0xFF);
+        p[1] = (uint8_t)(i >> 8);
+        p[2] = (uint8_t)(i >> 16);
+        p[3] = (uint8_t)(i >> 24);
+    }
+
+    build_strings_v2(
+        src->labels, L,
+        (uint32_t*)(buffer + h->sections[SECTION_LABEL_OFFSETS].offset),
+        (char*)(buffer + h->sections[SECTION_LABEL_STRINGS].offset),
+        (uint32_t*)(buffer + h->sections[SECTION_LABEL_HASH].offset),
+        h->label_buckets
+        );
+    if (!hashed) {
+        build_strings_v2(
+            src->attrs, A,
+            (uint32_t*)(buffer + h->sections[SECTION_ATTR_OFFSETS].offset),
+            (char*)(buffer + h->sections[SECTION_ATTR_STRINGS].offset),
+            (uint32_t*)(buffer + h->sections[SECTION_ATTR_HASH].offset),
+            h->attr_buckets
+            );
+    }
+
+    h->checksum = checksum_v2(buffer + HEADER_SIZE_V2, h->size - HEADER_SIZE_V2);
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL || fwrite(buffer, 1, h->size, fp) != h->size) {
+        ret = CRFSUITEERR_UNKNOWN;
+    }
+    if (fp != NULL && fclose(fp) != 0) {
+        ret = CRFSUITEERR_UNKNOWN;
+    }
+
+exit:
+    free(cursor);
+    free(buffer);
+    return ret;
+}
+
+int crf1dm_save_v2(crf1dm_t* model, const char *filename)
+{
+    int i, ret = CRFSUITEERR_OUTOFMEMORY;
+    crf1dm_source_t src;
+    const char **labels = NULL, **attrs = NULL;
+    crf1dm_feature_t *features = NULL;
+
+    memset(&src, 0, sizeof(src));
+    src.num_labels = crf1dm_get_num_labels(model);
+    src.num_attrs = crf1dm_get_num_attrs(model);
+    src.num_features = crf1dm_get_num_features(model);
+    src.hash_bits = crf1dm_get_hash_bits(model);
+
+    labels = (const char**)calloc(src.num_labels + 1, sizeof(char*));
+    attrs = (const char**)calloc(src.num_attrs + 1, sizeof(char*));
+    features = (crf1dm_feature_t*)calloc(src.num_features + 1, sizeof(crf1dm_feature_t));
+    if (labels == NULL || attrs == NULL || features == NULL) {
+        goto exit;
+    }
+
+    /* Ids are kept, so the converted model tags exactly like the original. */
+    ret = CRFSUITEERR_INCOMPATIBLE;
+    for (i = 0;i < src.num_labels;++i) {
+        if ((labels[i] = crf1dm_to_label(model, i)) == NULL) {
+            goto exit;
+        }
+    }
+    for (i = 0;src.hash_bits == 0 && i < src.num_attrs;++i) {
+        if ((attrs[i] = crf1dm_to_attr(model, i)) == NULL) {
+            goto exit;
+        }
+    }
+    for (i = 0;i < src.num_features;++i) {
+        crf1dm_get_feature(model, i, &features[i]);
+    }
+
+    src.labels = labels;
+    src.attrs = attrs;
+    src.features = features;
+    ret = crf1dm_write_v2(filename, &src);
+
+exit:
+    free(features);
+    free(attrs);
+    free(labels);
+    return ret;
+}
+
+static int is_model_v2(const uint8_t* buffer, size_t size)
+{
+    uint32_t version;
+
+    if (size < HEADER_SIZE_V2 || memcmp(buffer, FILEMAGIC, 4) != 0) {
+        return 0;
+    }
+    memcpy(&version, buffer + 12, sizeof(version));
+    return version == VERSION_NUMBER_V2;
+}
+
+static int check_section(const header2_t* h, int i, uint64_t expected)
+{
+    const section_t* sec = &h->sections[i];
+
+    if (sec->offset < HEADER_SIZE_V2 || sec->offset % sizeof(floatval_t) != 0) {
+        return 1;
+    }
+    if ((uint64_t)sec->offset + sec->size > h->size) {
+        return 1;
+    }
+    if (expected != (uint64_t)-1 && sec->size != expected) {
+        return 1;
+    }
+    return 0;
+}
+
+static int check_strings(const uint32_t* offsets, uint32_t n, const header2_t* h, int i, const char *strings)
+{
+    uint32_t size = h->sections[i].size;
+    if (n == 0) {
+        return 0;
+    }
+    if (size == 0 || offsets[n] != size || strings[size-1] != '\0') {
+        return 1;
+    }
+    return 0;
+}
+
+static int is_pow2(uint32_t n)
+{
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+/*
+ * Set up a version 2 model over buffer. Nothing is copied: every array is
+ * a pointer into the buffer, which must be aligned to sizeof(floatval_t).
+ * On failure, buffer_orig and mapped are released.
+ */
+static crf1dm_t* crf1dm_new_v2(uint8_t* buffer_orig, void *mapped, const uint8_t* buffer, uint32_t size)
+{
+    crf1dm_t *model = NULL;
+    header_t *header = NULL;
+    const header2_t* h = (const header2_t*)buffer;
+    const uint8_t* p = buffer;
+    uint64_t L, A, S, T;
+    int hashed;
+
+    model = (crf1dm_t*)calloc(1, sizeof(crf1dm_t));
+    header = (header_t*)calloc(1, sizeof(header_t));
+    if (model == NULL || header == NULL) {
+        goto error_exit;
+    }
+
+    /* Validate the header and the extent of every section. */
+    if (h->size != size || (h->flags & ~FLAG_HASHED_ATTRS_V2) != 0) {
+        goto error_exit;
+    }
+    L = h->num_labels;
+    A = h->num_attrs;
+    S = h->num_state;
+    T = h->num_trans;
+    hashed = (h->flags & FLAG_HASHED_ATTRS_V2) != 0;
+    if (!is_pow2(h->label_buckets) || h->label_buckets <= L) {
+        goto error_exit;
+    }
+    if (hashed ? (!is_pow2((uint32_t)A) || h->attr_buckets != 0) :
+        (!is_pow2(h->attr_buckets) || h->attr_buckets <= A)) {
+        goto error_exit;
+    }
+    if (check_section(h, SECTION_ATTR_INDEX, 4 * (A + 1)) ||
+        check_section(h, SECTION_STATE_DST, 4 * S) ||
+        check_section(h, SECTION_STATE_WEIGHT, sizeof(floatval_t) * S) ||
+        check_section(h, SECTION_LABEL_INDEX, 4 * (L + 1)) ||
+        check_section(h, SECTION_TRANS_DST, 4 * T) ||
+        check_section(h, SECTION_TRANSITIONS, sizeof(floatval_t) * L * L) ||
+        check_section(h, SECTION_FIDS, 4 * (S + T)) ||
+        check_section(h, SECTION_LABEL_OFFSETS, 4 * (L + 1)) ||
+        check_section(h, SECTION_LABEL_STRINGS, (uint64_t)-1) ||
+        check_section(h, SECTION_LABEL_HASH, 8 * (uint64_t)h->label_buckets) ||
+        check_section(h, SECTION_ATTR_OFFSETS, hashed ? 0 : 4 * (A + 1)) ||
+        check_section(h, SECTION_ATTR_STRINGS, hashed ? 0 : (uint64_t)-1) ||
+        check_section(h, SECTION_ATTR_HASH, 8 * (uint64_t)h->attr_buckets)) {
+        goto error_exit;
+    }
+
+    /* Reject truncated or corrupted files. */
+    if (checksum_v2(buffer + HEADER_SIZE_V2, size - HEADER_SIZE_V2) != h->checksum) {
+        goto error_exit;
+    }
+
+    model->buffer_orig = buffer_orig;
+    model->mapped = mapped;
+    model->buffer = buffer;
+    model->size = size;
+    model->version = 2;
+    model->header2 = h;
+    model->attr_index = (const uint32_t*)(p + h->sections[SECTION_ATTR_INDEX].offset);
+    model->state_dst = (const int32_t*)(p + h->sections[SECTION_STATE_DST].offset);
+    model->state_weight = (const floatval_t*)(p + h->sections[SECTION_STATE_WEIGHT].offset);
+    model->label_index = (const uint32_t*)(p + h->sections[SECTION_LABEL_INDEX].offset);
+    model->trans_dst = (const int32_t*)(p + h->sections[SECTION_TRANS_DST].offset);
+    model->transitions = (const floatval_t*)(p + h->sections[SECTION_TRANSITIONS].offset);
+    model->fids = (const uint32_t*)(p + h->sections[SECTION_FIDS].offset);
+    model->label_offsets = (const uint32_t*)(p + h->sections[SECTION_LABEL_OFFSETS].offset);
+    model->label_strings = (const char*)(p + h->sections[SECTION_LABEL_STRINGS].offset);
+    model->label_hash = (const uint32_t*)(p + h->sections[SECTION_LABEL_HASH].offset);
+    model->attr_offsets = (const uint32_t*)(p + h->sections[SECTION_ATTR_OFFSETS].offset);
+    model->attr_strings = (const char*)(p + h->sections[SECTION_ATTR_STRINGS].offset);
+    model->attr_hash = (const uint32_t*)(p + h->sections[SECTION_ATTR_HASH].offset);
+
+    /* The CSR indices must cover exactly the stored features. */
+    if (model->attr_index[A] != S || model->label_index[L] != T ||
+        check_strings(model->label_offsets, (uint32_t)L, h, SECTION_LABEL_STRINGS, model->label_strings) ||
+        (!hashed && check_strings(model->attr_offsets, (uint32_t)A, h, SECTION_ATTR_STRINGS, model->attr_strings))) {
+        goto error_exit;
+    }
+
+    /* Keep the version 1 header for the common accessors. */
+    memcpy(header->magic, h->magic, 4);
+    memcpy(header->type, h->type, 4);
+    header->size = h->size;
+    header->version = h->version;
+    header->num_features = (uint32_t)(S + T);
+    header->num_labels = (uint32_t)L;
+    header->num_attrs = (uint32_t)A;
+    model->header = header;
+    return model;
+
+error_exit:
+    free(header);
+    free(model);
+    free(buffer_orig);
+#ifdef CRF1DM_USE_MMAP
+    if (mapped != NULL) {
+        munmap(mapped, size);
+    }
+#endif/*CRF1DM_USE_MMAP*/
+    return NULL;
+}
+
 static crf1dm_t* crf1dm_new_impl(uint8_t* buffer_orig, const uint8_t* buffer, uint32_t size)
 {
     const uint8_t* p = NULL;
     crf1dm_t *model = NULL;
     header_t *header = NULL;
 
+    if (is_model_v2(buffer, size)) {
+        /* Version 2 arrays are used in place and need aligned storage. */
+        if ((uintptr_t)buffer % sizeof(floatval_t) != 0) {
+            uint8_t *copy = (uint8_t*)malloc(size);
+            if (copy == NULL) {
+                free(buffer_orig);
+                return NULL;
+            }
+            memcpy(copy, buffer, size);
+            free(buffer_orig);
+            buffer = buffer_orig = copy;
+        }
+        return crf1dm_new_v2(buffer_orig, NULL, buffer, size);
+    }
+
     model = (crf1dm_t*)calloc(1, sizeof(crf1dm_t));
     if (model == NULL) {
         goto error_exit;
@@ -714,6 +1265,7 @@ static crf1dm_t* crf1dm_new_impl(uint8_t* buffer_orig, const uint8_t* buffer, ui
     model->buffer_orig = buffer_orig;
     model->buffer = buffer;
     model->size = size;
+    model->version = 1;
 
     if (model->size <= sizeof(header_t)) {
       goto error_exit;
@@ -740,6 +1292,11 @@ static crf1dm_t* crf1dm_new_impl(uint8_t* buffer_orig, const uint8_t* buffer, ui
     p += read_uint32(p, &header->off_attrrefs);
     model->header = header;
 
+    /* A version 2 file written on a machine of the other byte order. */
+    if (header->version != VERSION_NUMBER) {
+        goto error_exit;
+    }
+
     model->labels = cqdb_reader(
         model->buffer + header->off_labels,
         model->size - header->off_labels
@@ -759,6 +1316,38 @@ error_exit:
     return NULL;
 }
 
+#ifdef CRF1DM_USE_MMAP
+/*
+ * Map a version 2 file read-only. Returns NULL (and leaves the file to the
+ * regular reader) if the file is not a version 2 model.
+ */
+static crf1dm_t* crf1dm_new_mmap(const char *filename)
+{
+    int fd;
+    struct stat st;
+    uint8_t head[16];
+    void *mapped = NULL;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < HEADER_SIZE_V2 || st.st_size > UINT32_MAX ||
+        pread(fd, head, sizeof(head), 0) != sizeof(head) ||
+        !is_model_v2(head, (size_t)st.st_size)) {
+        close(fd);
+        return NULL;
+    }
+
+    mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return NULL;
+    }
+    return crf1dm_new_v2(NULL, mapped, (const uint8_t*)mapped, (uint32_t)st.st_size);
+}
+#endif/*CRF1DM_USE_MMAP*/
+
 crf1dm_t* crf1dm_new(const char *filename)
 {
     FILE *fp = NULL;
@@ -766,6 +1355,13 @@ crf1dm_t* crf1dm_new(const char *filename)
     uint8_t* buffer_orig = NULL;
     uint8_t* buffer = NULL;
 
+#ifdef CRF1DM_USE_MMAP
+    crf1dm_t* model = crf1dm_new_mmap(filename);
+    if (model != NULL) {
+        return model;
+    }
+#endif/*CRF1DM_USE_MMAP*/
+
     fp = fopen(filename, "rb");
     if (fp == NULL) {
         goto error_exit;
@@ -821,10 +1417,53 @@ void crf1dm_close(crf1dm_t* model)
         free(model->buffer_orig);
         model->buffer_orig = NULL;
     }
+#ifdef CRF1DM_USE_MMAP
+    if (model->mapped != NULL) {
+        munmap(model->mapped, model->size);
+        model->mapped = NULL;
+    }
+#endif/*CRF1DM_USE_MMAP*/
     model->buffer = NULL;
     free(model);
 }
 
+void crf1dm_get_memory(crf1dm_t* model, crf1dm_memory_t* mem)
+{
+    mem->file = model->size;
+    mem->buffer = model->buffer_orig != NULL ? model->size : 0;
+    mem->structures = sizeof(crf1dm_t) + sizeof(header_t);
+    mem->cqdb = 0;
+    if (model->labels != NULL) {
+        mem->cqdb += cqdb_get_memory(model->labels);
+    }
+    if (model->attrs != NULL) {
+        mem->cqdb += cqdb_get_memory(model->attrs);
+    }
+}
+
+int crf1dm_get_version(crf1dm_t* model)
+{
+    return model->version;
+}
+
+int crf1dm_get_hash_bits(crf1dm_t* model)
+{
+    int bits = 0;
+    if (model->version != 2 || !(model->header2->flags & FLAG_HASHED_ATTRS_V2)) {
+        return 0;
+    }
+    while ((1U << bits) < model->header->num_attrs) {
+        ++bits;
+    }
+    return bits;
+}
+
+int crf1dm_hash_attr(const char *value, int hash_bits)
+{
+    const uint32_t mask = (1U << hash_bits) - 1;
+    return (int)(hashlittle(value, strlen(value), 0) & mask);
+}
+
 int crf1dm_get_num_attrs(crf1dm_t* model)
 {
     return model->header->num_attrs;
@@ -835,9 +1474,66 @@ int crf1dm_get_num_labels(crf1dm_t* model)
     return model->header->num_labels;
 }
 
+int crf1dm_get_num_features(crf1dm_t* model)
+{
+    /* The writer leaves header->num_features at zero; the feature chunk
+       header holds the real count. */
+    uint32_t num = 0;
+    const uint8_t *p = NULL;
+    if (model->version == 2) {
+        return model->header->num_features;
+    }
+    p = model->buffer + model->header->off_features + 8;
+    read_uint32(p, &num);
+    return (int)num;
+}
+
+/* Look up str in a version 2 hash index; returns the id or -1. */
+static int lookup_v2(
+    const uint32_t* buckets, uint32_t num_buckets,
+    const char *strings, const char *str)
+{
+    const uint32_t hash = hashlittle(str, strlen(str), 0);
+    const uint32_t mask = num_buckets - 1;
+    uint32_t i = hash & mask;
+
+    for (;;) {
+        const uint32_t offset = buckets[2*i+1];
+        if (offset == 0) {
+            return -1;
+        }
+        if (buckets[2*i] == hash && strcmp(strings + offset, str) == 0) {
+            uint32_t id;
+            memcpy(&id, strings + offset - sizeof(id), sizeof(id));
+            return (int)id;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+/* Find i such that index[i] <= k < index[i+1] in a CSR index of n rows. */
+static int find_row_v2(const uint32_t* index, int n, uint32_t k)
+{
+    int lo = 0, hi = n;
+    while (lo + 1 < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (index[mid] <= k) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
 const char *crf1dm_to_label(crf1dm_t* model, int lid)
 {
-    if (model->labels != NULL) {
+    if (model->version == 2) {
+        if (lid < 0 || model->header->num_labels <= (uint32_t)lid) {
+            return NULL;
+        }
+        return model->label_strings + model->label_offsets[lid];
+    } else if (model->labels != NULL) {
         return cqdb_to_string(model->labels, lid);
     } else {
         return NULL;
@@ -846,7 +1542,11 @@ const char *crf1dm_to_label(crf1dm_t* model, int lid)
 
 int crf1dm_to_lid(crf1dm_t* model, const char *value)
 {
-    if (model->labels != NULL) {
+    if (model->version == 2) {
+        return lookup_v2(
+            model->label_hash, model->header2->label_buckets,
+            model->label_strings, value);
+    } else if (model->labels != NULL) {
         return cqdb_to_id(model->labels, value);
     } else {
         return -1;
@@ -855,7 +1555,15 @@ int crf1dm_to_lid(crf1dm_t* model, const char *value)
 
 int crf1dm_to_aid(crf1dm_t* model, const char *value)
 {
-    if (model->attrs != NULL) {
+    if (model->version == 2 && (model->header2->flags & FLAG_HASHED_ATTRS_V2)) {
+        /* Every string has an id; there is nothing to compare against. */
+        const uint32_t mask = model->header->num_attrs - 1;
+        return (int)(hashlittle(value, strlen(value), 0) & mask);
+    } else if (model->version == 2) {
+        return lookup_v2(
+            model->attr_hash, model->header2->attr_buckets,
+            model->attr_strings, value);
+    } else if (model->attrs != NULL) {
         return cqdb_to_id(model->attrs, value);
     } else {
         return -1;
@@ -864,7 +1572,13 @@ int crf1dm_to_aid(crf1dm_t* model, const char *value)
 
 const char *crf1dm_to_attr(crf1dm_t* model, int aid)
 {
-    if (model->attrs != NULL) {
+    if (model->version == 2) {
+        if (aid < 0 || model->header->num_attrs <= (uint32_t)aid ||
+            (model->header2->flags & FLAG_HASHED_ATTRS_V2)) {
+            return NULL;
+        }
+        return model->attr_strings + model->attr_offsets[aid];
+    } else if (model->attrs != NULL) {
         return cqdb_to_string(model->attrs, aid);
     } else {
         return NULL;
@@ -877,6 +1591,13 @@ int crf1dm_get_labelref(crf1dm_t* model, int lid, feature_refs_t* ref)
     uint32_t offset;
     uint32_t num_features;
 
+    if (model->version == 2) {
+        const uint32_t begin = model->label_index[lid];
+        ref->num_features = (int)(model->label_index[lid+1] - begin);
+        ref->fids = (int*)(model->fids + model->header2->num_state + begin);
+        return 0;
+    }
+
     p += model->header->off_labelrefs;
     p += CHUNK_SIZE;
     p += sizeof(uint32_t) * lid;
@@ -895,6 +1616,13 @@ int crf1dm_get_attrref(crf1dm_t* model, int aid, feature_refs_t* ref)
     uint32_t offset;
     uint32_t num_features;
 
+    if (model->version == 2) {
+        const uint32_t begin = model->attr_index[aid];
+        ref->num_features = (int)(model->attr_index[aid+1] - begin);
+        ref->fids = (int*)(model->fids + begin);
+        return 0;
+    }
+
     p += model->header->off_attrrefs;
     p += CHUNK_SIZE;
     p += sizeof(uint32_t) * aid;
@@ -921,6 +1649,25 @@ int crf1dm_get_feature(crf1dm_t* model, int fid, crf1dm_feature_t* f)
     const uint8_t *p = NULL;
     uint32_t val = 0;
     uint32_t offset = model->header->off_features + CHUNK_SIZE;
+
+    if (model->version == 2) {
+        const int L = (int)model->header->num_labels;
+        const uint32_t S = model->header2->num_state;
+        if ((uint32_t)fid < S) {
+            f->type = FT_STATE;
+            f->src = find_row_v2(model->attr_index, (int)model->header->num_attrs, (uint32_t)fid);
+            f->dst = model->state_dst[fid];
+            f->weight = model->state_weight[fid];
+        } else {
+            const uint32_t k = (uint32_t)fid - S;
+            f->type = FT_TRANS;
+            f->src = find_row_v2(model->label_index, L, k);
+            f->dst = model->trans_dst[k];
+            f->weight = model->transitions[f->src * L + f->dst];
+        }
+        return 0;
+    }
+
     offset += FEATURE_SIZE * fid;
     p = model->buffer + offset;
     p += read_uint32(p, &val);
@@ -933,6 +1680,81 @@ int crf1dm_get_feature(crf1dm_t* model, int fid, crf1dm_feature_t* f)
     return 0;
 }
 
+int crf1dm_get_state_weights(crf1dm_t* model, int aid, const int **dst, const floatval_t **weight)
+{
+    uint32_t begin;
+
+    if (model->version != 2) {
+        return -1;
+    }
+    begin = model->attr_index[aid];
+    *dst = (const int*)(model->state_dst + begin);
+    *weight = model->state_weight + begin;
+    return (int)(model->attr_index[aid+1] - begin);
+}
+
+const floatval_t* crf1dm_get_transitions(crf1dm_t* model)
+{
+    return (model->version == 2) ? model->transitions : NULL;
+}
+
+static const char *section_names_v2[NUM_SECTIONS] = {
+    "attr_index", "state_dst", "state_weight", "label_index", "trans_dst",
+    "transitions", "fids", "label_offsets", "label_strings", "label_hash",
+    "attr_offsets", "attr_strings", "attr_hash",
+};
+
+int crf1dm_get_sections(crf1dm_t* model, crf1dm_section_t* sections, int n)
+{
+    int i, j, num = 0;
+    crf1dm_section_t s[NUM_SECTIONS + 1];
+
+    if (model->version == 2) {
+        const header2_t* h = model->header2;
+        s[num].name = "header";
+        s[num].offset = 0;
+        s[num++].size = HEADER_SIZE_V2;
+        for (i = 0;i < NUM_SECTIONS;++i) {
+            s[num].name = section_names_v2[i];
+            s[num].offset = h->sections[i].offset;
+            s[num++].size = h->sections[i].size;
+        }
+    } else {
+        const header_t* h = model->header;
+        s[num].name = "header";
+        s[num].offset = 0;
+        s[num++].size = HEADER_SIZE;
+        s[num].name = "features";
+        s[num++].offset = h->off_features;
+        s[num].name = "labels";
+        s[num++].offset = h->off_labels;
+        s[num].name = "attrs";
+        s[num++].offset = h->off_attrs;
+        s[num].name = "labelrefs";
+        s[num++].offset = h->off_labelrefs;
+        s[num].name = "attrrefs";
+        s[num++].offset = h->off_attrrefs;
+
+        /* Chunks are stored back to back, in the order they were written. */
+        for (i = 1;i < num;++i) {
+            for (j = i;1 < j && s[j].offset < s[j-1].offset;--j) {
+                crf1dm_section_t tmp = s[j];
+                s[j] = s[j-1];
+                s[j-1] = tmp;
+            }
+        }
+        for (i = 1;i < num;++i) {
+            const unsigned int end = (i + 1 < num) ? s[i+1].offset : h->size;
+            s[i].size = end - s[i].offset;
+        }
+    }
+
+    for (i = 0;i < num && i < n;++i) {
+        sections[i] = s[i];
+    }
+    return num;
+}
+
 void crf1dm_dump(crf1dm_t* crf1dm, FILE *fp)
 {
     int j;
@@ -984,7 +1806,7 @@ void crf1dm_dump(crf1dm_t* crf1dm, FILE *fp)
             fprintf(fp, "WARNING: inconsistent attribute CQDB\n");
         }
 #endif
-        fprintf(fp, "  %5" PRIu32 ": %s\n", i, str);
+        fprintf(fp, "  %5" PRIu32 ": %s\n", i, str != NULL ? str : "(hashed)");
     }
     fprintf(fp, "}\n");
     fprintf(fp, "\n");
@@ -1023,6 +1845,9 @@ void crf1dm_dump(crf1dm_t* crf1dm, FILE *fp)
             }
 #endif
             attr = crf1dm_to_attr(crf1dm, f.src);
+            if (attr == NULL) {
+                attr = "(hashed)";
+            }
             to = crf1dm_to_label(crf1dm, f.dst);
             fprintf(fp, "  (%d) %s --> %s: %f\n", f.type, attr, to, f.weight);
         }
@@ -61,7 +61,9 @@ typedef struct {
 
 static void crf1dt_state_score(crf1dt_t *crf1dt, const crfsuite_instance_t *inst)
 {
-    int a, i, l, t, r, fid;
+    int a, i, l, t, r, n, fid;
+    const int *dst = NULL;
+    const floatval_t *weight = NULL;
     crf1dm_feature_t f;
     feature_refs_t attr;
     floatval_t value, *state = NULL;
@@ -80,10 +82,20 @@ static void crf1dt_state_score(crf1dt_t *crf1dt, const crfsuite_instance_t *inst
         for (i = 0;i < item->num_contents;++i) {
             /* Access the list of state features associated with the attribute. */
             a = item->contents[i].aid;
-            crf1dm_get_attrref(model, a, &attr);
             /* A scale usually represents the atrribute frequency in the item. */
             value = item->contents[i].value;
 
+            /* Version 2 models store the (label, weight) pairs contiguously. */
+            n = crf1dm_get_state_weights(model, a, &dst, &weight);
+            if (0 <= n) {
+                for (r = 0;r < n;++r) {
+                    state[dst[r]] += weight[r] * value;
+                }
+                continue;
+            }
+
+            crf1dm_get_attrref(model, a, &attr);
+
             /* Loop over the state features associated with the attribute. */
             for (r = 0;r < attr.num_features;++r) {
                 /* The state feature #(attr->fids[r]), which is represented by
@@ -106,6 +118,15 @@ static void crf1dt_transition_score(crf1dt_t* crf1dt)
     crf1dm_t* model = crf1dt->model;
     crf1d_context_t* ctx = crf1dt->ctx;
     const int L = crf1dt->num_labels;
+    const floatval_t *dense = crf1dm_get_transitions(model);
+
+    /* Version 2 models store the whole matrix, zeros included. */
+    if (dense != NULL) {
+        for (i = 0;i < L;++i) {
+            memcpy(TRANS_SCORE(ctx, i), dense + i * L, sizeof(floatval_t) * L);
+        }
+        return;
+    }
 
     /* Compute transition scores between two labels. */
     for (i = 0;i < L;++i) {
@@ -459,6 +480,21 @@ static int model_dump(crfsuite_model_t* model, FILE *fpo)
     return 0;
 }
 
+void crf1dt_get_model_memory(crfsuite_model_t* model, crf1dm_memory_t* mem)
+{
+    model_internal_t* internal = (model_internal_t*)model->internal;
+
+    crf1dm_get_memory(internal->crf1dm, mem);
+    mem->structures += sizeof(crfsuite_model_t) + sizeof(model_internal_t) +
+        2 * sizeof(crfsuite_dictionary_t);
+}
+
+size_t crf1dt_get_tagger_memory(int L, int T)
+{
+    return sizeof(crfsuite_tagger_t) + sizeof(crf1dt_t) +
+        crf1dc_get_memory(CTXF_VITERBI | CTXF_MARGINALS, L, T);
+}
+
 static int crf1m_model_create(crf1dm_t *crf1dm, void** ptr_model)
 {
     int ret = 0;
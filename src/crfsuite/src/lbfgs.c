@@ -0,0 +1,516 @@
+/*
+ *      Limited-memory BFGS (L-BFGS) and OWL-QN solver.
+ *
+ * The algorithm follows:
+ *  - J. Nocedal. Updating Quasi-Newton Matrices with Limited Storage (1980),
+ *    Mathematics of Computation 35, pp. 773-782 (two-loop recursion).
+ *  - G. Andrew and J. Gao. Scalable training of L1-regularized log-linear
+ *    models. ICML 2007 (orthant-wise limited-memory quasi-Newton).
+ *
+ * See lbfgs.h for how this differs from liblbfgs.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lbfgs.h>
+
+/**
+ * One correction pair of the limited memory.
+ */
+typedef struct {
+    lbfgsfloatval_t alpha;
+    lbfgsfloatval_t *s;     /* x_{k+1} - x_{k} */
+    lbfgsfloatval_t *y;     /* g_{k+1} - g_{k} */
+    lbfgsfloatval_t ys;     /* y^t \cdot s */
+} iteration_data_t;
+
+/**
+ * Callbacks and parameters shared by the line searches.
+ */
+typedef struct {
+    int n;
+    void *instance;
+    lbfgs_evaluate_t proc_evaluate;
+    lbfgs_progress_t proc_progress;
+} callback_data_t;
+
+static const lbfgs_parameter_t _defparam = {
+    6, 1e-5, 0, 1e-5,
+    0, LBFGS_LINESEARCH_DEFAULT, 40,
+    1e-20, 1e20, 1e-4, 0.9,
+    0.0, 0, -1,
+};
+
+void lbfgs_parameter_init(lbfgs_parameter_t *param)
+{
+    memcpy(param, &_defparam, sizeof(*param));
+}
+
+lbfgsfloatval_t* lbfgs_malloc(int n)
+{
+    return (lbfgsfloatval_t*)calloc(n > 0 ? n : 1, sizeof(lbfgsfloatval_t));
+}
+
+void lbfgs_free(lbfgsfloatval_t *x)
+{
+    free(x);
+}
+
+static lbfgsfloatval_t vecdot(const lbfgsfloatval_t *x, const lbfgsfloatval_t *y, int n)
+{
+    int i;
+    lbfgsfloatval_t s = 0.;
+    for (i = 0;i < n;++i) {
+        s += x[i] * y[i];
+    }
+    return s;
+}
+
+static lbfgsfloatval_t vec2norm(const lbfgsfloatval_t *x, int n)
+{
+    return sqrt(vecdot(x, x, n));
+}
+
+static lbfgsfloatval_t owlqn_x1norm(const lbfgsfloatval_t *x, int start, int end)
+{
+    int i;
+    lbfgsfloatval_t norm = 0.;
+    for (i = start;i < end;++i) {
+        norm += fabs(x[i]);
+    }
+    return norm;
+}
+
+/*
+ * Pseudo-gradient of f(x) + c |x|_1: the steepest-descent direction of
+ * the non-differentiable objective, negated.
+ */
+static void owlqn_pseudo_gradient(
+    lbfgsfloatval_t *pg,
+    const lbfgsfloatval_t *x,
+    const lbfgsfloatval_t *g,
+    int n,
+    lbfgsfloatval_t c,
+    int start,
+    int end
+    )
+{
+    int i;
+
+    for (i = 0;i < start;++i) {
+        pg[i] = g[i];
+    }
+    for (i = start;i < end;++i) {
+        if (x[i] < 0.) {
+            pg[i] = g[i] - c;
+        } else if (0. < x[i]) {
+            pg[i] = g[i] + c;
+        } else if (g[i] < -c) {
+            /* Moving right decreases the objective. */
+            pg[i] = g[i] + c;
+        } else if (c < g[i]) {
+            /* Moving left decreases the objective. */
+            pg[i] = g[i] - c;
+        } else {
+            pg[i] = 0.;
+        }
+    }
+    for (i = end;i < n;++i) {
+        pg[i] = g[i];
+    }
+}
+
+/*
+ * Backtracking line search along s from xp, for smooth objectives.
+ * Returns the number of evaluations, or a negative error code.
+ */
+static int line_search_backtracking(
+    int n,
+    lbfgsfloatval_t *x,
+    lbfgsfloatval_t *f,
+    lbfgsfloatval_t *g,
+    const lbfgsfloatval_t *s,
+    lbfgsfloatval_t *stp,
+    const lbfgsfloatval_t *xp,
+    callback_data_t *cd,
+    const lbfgs_parameter_t *param
+    )
+{
+    int i, count = 0;
+    lbfgsfloatval_t width, dg;
+    const lbfgsfloatval_t dec = 0.5, inc = 2.1;
+    const lbfgsfloatval_t finit = *f;
+    const lbfgsfloatval_t dginit = vecdot(g, s, n);
+    const lbfgsfloatval_t dgtest = param->ftol * dginit;
+
+    if (*stp <= 0.) {
+        return LBFGSERR_INVALID_PARAMETERS;
+    }
+    if (0 < dginit) {
+        return LBFGSERR_INCREASEGRADIENT;
+    }
+
+    for (;;) {
+        for (i = 0;i < n;++i) {
+            x[i] = xp[i] + *stp * s[i];
+        }
+        *f = cd->proc_evaluate(cd->instance, x, g, cd->n, *stp);
+        ++count;
+
+        if (*f > finit + *stp * dgtest) {
+            width = dec;
+        } else {
+            /* The sufficient decrease condition (Armijo) holds. */
+            if (param->linesearch == LBFGS_LINESEARCH_BACKTRACKING_ARMIJO) {
+                return count;
+            }
+
+            dg = vecdot(g, s, n);
+            if (dg < param->wolfe * dginit) {
+                width = inc;
+            } else if (param->linesearch == LBFGS_LINESEARCH_BACKTRACKING_WOLFE) {
+                /* The regular Wolfe condition holds. */
+                return count;
+            } else if (dg > -param->wolfe * dginit) {
+                width = dec;
+            } else {
+                /* The strong Wolfe condition holds. */
+                return count;
+            }
+        }
+
+        if (*stp < param->min_step) {
+            return LBFGSERR_MINIMUMSTEP;
+        }
+        if (*stp > param->max_step) {
+            return LBFGSERR_MAXIMUMSTEP;
+        }
+        if (param->max_linesearch <= count) {
+            return LBFGSERR_MAXIMUMLINESEARCH;
+        }
+
+        *stp *= width;
+    }
+}
+
+/*
+ * Backtracking line search for OWL-QN. Each trial point is projected onto
+ * the orthant of xp (or of the steepest descent direction where xp is
+ * zero), so a step never moves a weight across zero.
+ */
+static int line_search_backtracking_owlqn(
+    int n,
+    lbfgsfloatval_t *x,
+    lbfgsfloatval_t *f,
+    lbfgsfloatval_t *g,
+    const lbfgsfloatval_t *s,
+    lbfgsfloatval_t *stp,
+    const lbfgsfloatval_t *xp,
+    const lbfgsfloatval_t *pgp,
+    lbfgsfloatval_t *wp,
+    callback_data_t *cd,
+    const lbfgs_parameter_t *param,
+    int end
+    )
+{
+    int i, count = 0;
+    lbfgsfloatval_t dgtest;
+    const lbfgsfloatval_t dec = 0.5;
+    const lbfgsfloatval_t finit = *f;
+    const lbfgsfloatval_t c = param->orthantwise_c;
+    const int start = param->orthantwise_start;
+
+    if (*stp <= 0.) {
+        return LBFGSERR_INVALID_PARAMETERS;
+    }
+
+    /* Choose the orthant for the new point. */
+    for (i = 0;i < n;++i) {
+        wp[i] = (xp[i] == 0.) ? -pgp[i] : xp[i];
+    }
+
+    for (;;) {
+        for (i = 0;i < n;++i) {
+            x[i] = xp[i] + *stp * s[i];
+        }
+        for (i = start;i < end;++i) {
+            if (x[i] * wp[i] <= 0.) {
+                x[i] = 0.;
+            }
+        }
+
+        *f = cd->proc_evaluate(cd->instance, x, g, cd->n, *stp);
+        *f += c * owlqn_x1norm(x, start, end);
+        ++count;
+
+        dgtest = 0.;
+        for (i = 0;i < n;++i) {
+            dgtest += (x[i] - xp[i]) * pgp[i];
+        }
+        if (*f <= finit + param->ftol * dgtest) {
+            return count;
+        }
+
+        if (*stp < param->min_step) {
+            return LBFGSERR_MINIMUMSTEP;
+        }
+        if (*stp > param->max_step) {
+            return LBFGSERR_MAXIMUMSTEP;
+        }
+        if (param->max_linesearch <= count) {
+            return LBFGSERR_MAXIMUMLINESEARCH;
+        }
+
+        *stp *= dec;
+    }
+}
+
+int lbfgs(
+    int n,
+    lbfgsfloatval_t *x,
+    lbfgsfloatval_t *ptr_fx,
+    lbfgs_evaluate_t proc_evaluate,
+    lbfgs_progress_t proc_progress,
+    void *instance,
+    lbfgs_parameter_t *_param
+    )
+{
+    int ret = LBFGSERR_UNKNOWNERROR;
+    int i, j, k, ls, end, bound;
+    lbfgsfloatval_t step;
+    lbfgs_parameter_t param = (_param != NULL) ? (*_param) : _defparam;
+    const int m = param.m;
+    const int orthantwise = (0. < param.orthantwise_c);
+    int oend;
+    lbfgsfloatval_t *xp = NULL;
+    lbfgsfloatval_t *g = NULL, *gp = NULL, *pg = NULL;
+    lbfgsfloatval_t *d = NULL, *w = NULL, *pf = NULL;
+    iteration_data_t *lm = NULL;
+    lbfgsfloatval_t ys, yy, xnorm, gnorm, beta, fx = 0., rate;
+    callback_data_t cd;
+
+    if (n <= 0) {
+        return LBFGSERR_INVALID_N;
+    }
+    if (m <= 0 || param.epsilon < 0. || param.past < 0 || param.delta < 0. ||
+        param.max_linesearch <= 0 || param.min_step < 0. ||
+        param.max_step < param.min_step || param.ftol < 0. ||
+        param.wolfe <= param.ftol || 1. <= param.wolfe ||
+        param.orthantwise_c < 0. || param.orthantwise_start < 0 ||
+        n < param.orthantwise_start || n < param.orthantwise_end) {
+        return LBFGSERR_INVALID_PARAMETERS;
+    }
+    oend = (param.orthantwise_end < 0) ? n : param.orthantwise_end;
+
+    cd.n = n;
+    cd.instance = instance;
+    cd.proc_evaluate = proc_evaluate;
+    cd.proc_progress = proc_progress;
+
+    /* Allocate working space. */
+    xp = lbfgs_malloc(n);
+    g = lbfgs_malloc(n);
+    gp = lbfgs_malloc(n);
+    d = lbfgs_malloc(n);
+    w = lbfgs_malloc(n);
+    lm = (iteration_data_t*)calloc(m, sizeof(iteration_data_t));
+    if (xp == NULL || g == NULL || gp == NULL || d == NULL || w == NULL || lm == NULL) {
+        ret = LBFGSERR_OUTOFMEMORY;
+        goto lbfgs_exit;
+    }
+    if (orthantwise) {
+        pg = lbfgs_malloc(n);
+        if (pg == NULL) {
+            ret = LBFGSERR_OUTOFMEMORY;
+            goto lbfgs_exit;
+        }
+    }
+    for (i = 0;i < m;++i) {
+        lm[i].s = lbfgs_malloc(n);
+        lm[i].y = lbfgs_malloc(n);
+        if (lm[i].s == NULL || lm[i].y == NULL) {
+            ret = LBFGSERR_OUTOFMEMORY;
+            goto lbfgs_exit;
+        }
+    }
+    if (0 < param.past) {
+        pf = lbfgs_malloc(param.past);
+        if (pf == NULL) {
+            ret = LBFGSERR_OUTOFMEMORY;
+            goto lbfgs_exit;
+        }
+    }
+
+    /* Evaluate the function value and its gradient. */
+    fx = proc_evaluate(instance, x, g, n, 0);
+    if (orthantwise) {
+        fx += param.orthantwise_c * owlqn_x1norm(x, param.orthantwise_start, oend);
+        owlqn_pseudo_gradient(pg, x, g, n, param.orthantwise_c, param.orthantwise_start, oend);
+    }
+    if (pf != NULL) {
+        pf[0] = fx;
+    }
+
+    /* The initial direction is the steepest descent. */
+    for (i = 0;i < n;++i) {
+        d[i] = orthantwise ? -pg[i] : -g[i];
+    }
+
+    xnorm = vec2norm(x, n);
+    gnorm = vec2norm(orthantwise ? pg : g, n);
+    if (xnorm < 1.0) xnorm = 1.0;
+    if (gnorm / xnorm <= param.epsilon) {
+        ret = LBFGS_ALREADY_MINIMIZED;
+        goto lbfgs_exit;
+    }
+
+    step = 1.0 / vec2norm(d, n);
+    k = 1;
+    end = 0;
+    for (;;) {
+        /* Store the current position and gradient vectors. */
+        memcpy(xp, x, sizeof(lbfgsfloatval_t) * n);
+        memcpy(gp, g, sizeof(lbfgsfloatval_t) * n);
+
+        if (orthantwise) {
+            ls = line_search_backtracking_owlqn(
+                n, x, &fx, g, d, &step, xp, pg, w, &cd, &param, oend);
+            if (0 <= ls) {
+                owlqn_pseudo_gradient(pg, x, g, n, param.orthantwise_c, param.orthantwise_start, oend);
+            }
+        } else {
+            ls = line_search_backtracking(n, x, &fx, g, d, &step, xp, &cd, &param);
+        }
+        if (ls < 0) {
+            /* Revert to the previous point. */
+            memcpy(x, xp, sizeof(lbfgsfloatval_t) * n);
+            memcpy(g, gp, sizeof(lbfgsfloatval_t) * n);
+            ret = ls;
+            break;
+        }
+
+        xnorm = vec2norm(x, n);
+        gnorm = vec2norm(orthantwise ? pg : g, n);
+
+        if (proc_progress != NULL) {
+            ret = proc_progress(instance, x, g, fx, xnorm, gnorm, step, n, k, ls);
+            if (ret != 0) {
+                break;
+            }
+        }
+
+        /* Convergence test on the gradient. */
+        if (xnorm < 1.0) xnorm = 1.0;
+        if (gnorm / xnorm <= param.epsilon) {
+            ret = LBFGS_CONVERGENCE;
+            break;
+        }
+
+        /* Stopping criterion on the improvement over past iterations. */
+        if (pf != NULL) {
+            if (param.past <= k) {
+                rate = (pf[k % param.past] - fx) / fx;
+                if (fabs(rate) < param.delta) {
+                    ret = LBFGS_STOP;
+                    break;
+                }
+            }
+            pf[k % param.past] = fx;
+        }
+
+        if (param.max_iterations != 0 && param.max_iterations < k + 1) {
+            ret = LBFGSERR_MAXIMUMITERATION;
+            break;
+        }
+
+        /* Update the limited memory with s = x - xp and y = g - gp. */
+        {
+            iteration_data_t *it = &lm[end];
+            for (i = 0;i < n;++i) {
+                it->s[i] = x[i] - xp[i];
+                it->y[i] = g[i] - gp[i];
+            }
+            ys = vecdot(it->y, it->s, n);
+            yy = vecdot(it->y, it->y, n);
+            it->ys = ys;
+        }
+
+        bound = (m <= k) ? m : k;
+        ++k;
+        end = (end + 1) % m;
+
+        /* Compute the search direction with the two-loop recursion. */
+        for (i = 0;i < n;++i) {
+            d[i] = orthantwise ? -pg[i] : -g[i];
+        }
+
+        j = end;
+        for (i = 0;i < bound;++i) {
+            j = (j + m - 1) % m;
+            if (lm[j].ys == 0.) {
+                lm[j].alpha = 0.;
+                continue;
+            }
+            lm[j].alpha = vecdot(lm[j].s, d, n) / lm[j].ys;
+            {
+                int l;
+                for (l = 0;l < n;++l) {
+                    d[l] -= lm[j].alpha * lm[j].y[l];
+                }
+            }
+        }
+
+        if (0. < yy) {
+            const lbfgsfloatval_t scale = ys / yy;
+            for (i = 0;i < n;++i) {
+                d[i] *= scale;
+            }
+        }
+
+        for (i = 0;i < bound;++i) {
+            if (lm[j].ys != 0.) {
+                int l;
+                beta = vecdot(lm[j].y, d, n) / lm[j].ys;
+                for (l = 0;l < n;++l) {
+                    d[l] += (lm[j].alpha - beta) * lm[j].s[l];
+                }
+            }
+            j = (j + 1) % m;
+        }
+
+        /* Constrain the direction to the orthant of the pseudo-gradient. */
+        if (orthantwise) {
+            for (i = param.orthantwise_start;i < oend;++i) {
+                if (0. <= d[i] * pg[i]) {
+                    d[i] = 0.;
+                }
+            }
+        }
+
+        step = 1.0;
+    }
+
+lbfgs_exit:
+    if (ptr_fx != NULL) {
+        *ptr_fx = fx;
+    }
+
+    if (lm != NULL) {
+        for (i = 0;i < m;++i) {
+            lbfgs_free(lm[i].s);
+            lbfgs_free(lm[i].y);
+        }
+        free(lm);
+    }
+    lbfgs_free(pf);
+    lbfgs_free(pg);
+    lbfgs_free(w);
+    lbfgs_free(d);
+    lbfgs_free(gp);
+    lbfgs_free(g);
+    lbfgs_free(xp);
+
+    return ret;
+}
@@ -31,56 +31,149 @@
 /* $Id$ */
 
 #include "os.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include "rumavl.h"
 #include "quark.h"
 
+uint32_t hashlittle(const void *key, size_t length, uint32_t initval);
+
+/*
+ * Strings are interned into an open-addressing hash table with linear
+ * probing. Quark IDs are assigned in insertion order, so they do not
+ * depend on the hash function or on the table size.
+ */
+
+#define QUARK_INITIAL_BUCKETS   1024    /* Must be a power of two. */
+#define QUARK_POOL_BLOCK_SIZE   65536
+
 typedef struct {
-    char *str;
-    int qid;
-} record_t;
+    uint32_t hash;          /**< Hash value of the string. */
+    int qid;                /**< Quark ID, or -1 for an empty bucket. */
+} bucket_t;
+
+typedef struct tag_pool_block {
+    struct tag_pool_block *next;
+    size_t used;
+    size_t size;
+    char data[1];
+} pool_block_t;
 
 struct tag_quark {
     int num;
     int max;
-    RUMAVL* string_to_id;
+    uint32_t num_buckets;
+    bucket_t* buckets;
     char **id_to_string;
+    pool_block_t* pool;
 };
 
-static int keycmp(const void *_x, const void *_y, size_t n, void *udata)
+static uint32_t quark_hash(const char *str, size_t len)
 {
-    const record_t* x = (const record_t*)_x;
-    const record_t* y = (const record_t*)_y;
-    return strcmp(x->str, y->str);
+    return hashlittle(str, len, 0);
 }
 
-static int owcb(RUMAVL *tree, RUMAVL_NODE *n, void *_x, const void *_y, void *udata)
+/* Copy a string into the quark's string pool. */
+static char *pool_strdup(quark_t* qrk, const char *str, size_t len)
 {
-    record_t* x = (record_t*)_x;
-    free(x->str);
-    return 0;
+    pool_block_t *block = qrk->pool;
+    char *copy = NULL;
+
+    if (block == NULL || block->size - block->used < len + 1) {
+        size_t size = QUARK_POOL_BLOCK_SIZE;
+        if (size < len + 1) {
+            size = len + 1;
+        }
+        block = (pool_block_t*)malloc(sizeof(pool_block_t) + size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = qrk->pool;
+        block->used = 0;
+        block->size = size;
+        qrk->pool = block;
+    }
+
+    copy = block->data + block->used;
+    memcpy(copy, str, len + 1);
+    block->used += len + 1;
+    return copy;
+}
+
+/*
+ * Find the bucket holding str, or the empty bucket where it belongs.
+ * Returns NULL only if str is absent and no bucket is empty; quark_get()
+ * grows the table before it can fill up.
+ */
+static bucket_t* quark_find(quark_t* qrk, const char *str, uint32_t hash)
+{
+    const uint32_t mask = qrk->num_buckets - 1;
+    uint32_t i = hash & mask;
+    uint32_t n;
+
+    for (n = 0;n < qrk->num_buckets;++n) {
+        bucket_t* bucket = &qrk->buckets[i];
+        if (bucket->qid < 0) {
+            return bucket;
+        }
+        if (bucket->hash == hash &&
+            strcmp(qrk->id_to_string[bucket->qid], str) == 0) {
+            return bucket;
+        }
+        i = (i + 1) & mask;
+    }
+    return NULL;
 }
 
-static int delcb(RUMAVL *tree, RUMAVL_NODE *n, void *_record, void *udata)
+/* Double the number of buckets and re-insert every string. */
+static int quark_grow(quark_t* qrk)
 {
-    record_t* record = (record_t*)_record;
-    free(record->str);
+    uint32_t i, j;
+    const uint32_t num_buckets = qrk->num_buckets * 2;
+    const uint32_t mask = num_buckets - 1;
+    bucket_t* buckets = (bucket_t*)malloc(sizeof(bucket_t) * num_buckets);
+
+    if (buckets == NULL) {
+        return -1;
+    }
+    for (i = 0;i < num_buckets;++i) {
+        buckets[i].qid = -1;
+    }
+
+    for (i = 0;i < qrk->num_buckets;++i) {
+        if (0 <= qrk->buckets[i].qid) {
+            j = qrk->buckets[i].hash & mask;
+            while (0 <= buckets[j].qid) {
+                j = (j + 1) & mask;
+            }
+            buckets[j] = qrk->buckets[i];
+        }
+    }
+
+    free(qrk->buckets);
+    qrk->buckets = buckets;
+    qrk->num_buckets = num_buckets;
     return 0;
 }
 
 quark_t* quark_new()
 {
+    uint32_t i;
     quark_t* qrk = (quark_t*)malloc(sizeof(quark_t));
     if (qrk != NULL) {
         qrk->num = 0;
         qrk->max = 0;
-        qrk->string_to_id = rumavl_new(sizeof(record_t), keycmp, NULL, NULL);
-        if (qrk->string_to_id != NULL) {
-            *rumavl_delcb(qrk->string_to_id) = delcb;
-            *rumavl_owcb(qrk->string_to_id) = owcb;
-        }
+        qrk->num_buckets = QUARK_INITIAL_BUCKETS;
+        qrk->buckets = (bucket_t*)malloc(sizeof(bucket_t) * qrk->num_buckets);
         qrk->id_to_string = NULL;
+        qrk->pool = NULL;
+        if (qrk->buckets == NULL) {
+            free(qrk);
+            return NULL;
+        }
+        for (i = 0;i < qrk->num_buckets;++i) {
+            qrk->buckets[i].qid = -1;
+        }
     }
     return qrk;
 }
@@ -88,7 +181,13 @@ quark_t* quark_new()
 void quark_delete(quark_t* qrk)
 {
     if (qrk != NULL) {
-        rumavl_destroy(qrk->string_to_id);
+        pool_block_t *block = qrk->pool;
+        while (block != NULL) {
+            pool_block_t *next = block->next;
+            free(block);
+            block = next;
+        }
+        free(qrk->buckets);
         free(qrk->id_to_string);
         free(qrk);
     }
@@ -96,40 +195,52 @@ void quark_delete(quark_t* qrk)
 
 int quark_get(quark_t* qrk, const char *str)
 {
-    record_t key, *record = NULL;
-
-    key.str = (char *)str;
-    record = (record_t*)rumavl_find(qrk->string_to_id, &key);
-    if (record == NULL) {
-        char *newstr = (char*)malloc(strlen(str)+1);
-        if (newstr != NULL) {
-            strcpy(newstr, str);
-        }
+    const size_t len = strlen(str);
+    const uint32_t hash = quark_hash(str, len);
+    bucket_t* bucket = quark_find(qrk, str, hash);
+    char *newstr = NULL;
 
-        if (qrk->max <= qrk->num) {
-            qrk->max = (qrk->max + 1) * 2;
-            qrk->id_to_string = (char **)realloc(qrk->id_to_string, sizeof(char *) * qrk->max);
-        }
+    if (bucket != NULL && 0 <= bucket->qid) {
+        return bucket->qid;
+    }
 
-        qrk->id_to_string[qrk->num] = newstr;
-        key.str = newstr;
-        key.qid = qrk->num;
-        rumavl_insert(qrk->string_to_id, &key);
+    /*
+     * Make room before inserting, so that an allocation failure returns -1
+     * and leaves the quark as it was. Growing the buckets keeps the load
+     * factor at or below 1/2; it changes no ID, so the new bucket is looked
+     * up again afterwards.
+     */
+    if (bucket == NULL || qrk->num_buckets < (uint32_t)(qrk->num + 1) * 2) {
+        if (quark_grow(qrk) != 0) {
+            return -1;
+        }
+        bucket = quark_find(qrk, str, hash);
+    }
+    if (qrk->max <= qrk->num) {
+        const int max = (qrk->max + 1) * 2;
+        char **id_to_string = (char **)realloc(qrk->id_to_string, sizeof(char *) * max);
+        if (id_to_string == NULL) {
+            return -1;
+        }
+        qrk->id_to_string = id_to_string;
+        qrk->max = max;
+    }
+    newstr = pool_strdup(qrk, str, len);
+    if (newstr == NULL) {
+        return -1;
+    }
 
-        ++qrk->num;
-        return key.qid;
-    } else {
-        return record->qid;
-    }    
+    qrk->id_to_string[qrk->num] = newstr;
+    bucket->hash = hash;
+    bucket->qid = qrk->num;
+    return qrk->num++;
 }
 
 int quark_to_id(quark_t* qrk, const char *str)
 {
-    record_t key, *record = NULL;
-
-    key.str = (char *)str;
-    record = (record_t*)rumavl_find(qrk->string_to_id, &key);
-    return (record != NULL) ? record->qid : -1;
+    const size_t len = strlen(str);
+    bucket_t* bucket = quark_find(qrk, str, quark_hash(str, len));
+    return (bucket != NULL) ? bucket->qid : -1;
 }
 
 const char *quark_to_string(quark_t* qrk, int qid)
@@ -48,6 +48,10 @@
         f(w) = (lambda/2) * ||w||^2 + (1/N) * \sum_i^N log P^i(y|x)
         lambda = 2 * C / N
 
+    An instance of weight m stands for m copies of a sequence: N is the sum
+    of the instance weights, and the instance advances t and decays the
+    weights as m updates would, while its gradient is scaled by m.
+
     The original version of the Pegasos algorithm.
 
     0) Initialization
@@ -147,6 +151,7 @@ static int l2sgd(
     floatval_t eta, gain, decay = 1.;
     floatval_t improvement = 0.;
     floatval_t norm2 = 0.;
+    floatval_t sum_weight = 0.;
     floatval_t *pf = NULL;
     floatval_t *best_w = NULL;
     clock_t clk_prev, clk_begin = clock();
@@ -176,12 +181,13 @@ static int l2sgd(
 
         /* Loop for instances. */
         sum_loss = 0.;
+        sum_weight = 0.;
         for (i = 0;i < N;++i) {
             const crfsuite_instance_t *inst = dataset_get(trainset, i);
 
             /* Update various factors. */
             eta = 1 / (lambda * (t0 + t));
-            decay *= (1.0 - eta * lambda);
+            decay *= pow(1.0 - eta * lambda, inst->weight);
             gain = eta / decay;
 
             /* Compute the loss and gradients for the instance. */
@@ -190,7 +196,8 @@ static int l2sgd(
             gm->objective_and_gradients(gm, &loss, w, gain, inst->weight);
 
             sum_loss += loss;
-            ++t;
+            sum_weight += inst->weight;
+            t += inst->weight;
         }
 
         /* Terminate when the loss is abnormal (NaN, -Inf, +Inf). */
@@ -208,7 +215,7 @@ static int l2sgd(
         /* Include the L2 norm of feature weights to the objective. */
         /* The factor N is necessary because lambda = 2 * C / N. */
         norm2 = vecdot(w, w, K);
-        sum_loss += 0.5 * lambda * norm2 * N;
+        sum_loss += 0.5 * lambda * norm2 * sum_weight;
 
         /* One epoch finished. */
         if (!calibration) {
@@ -326,9 +333,9 @@ l2sgd_calibration(
         const crfsuite_instance_t *inst = dataset_get(ds, i);
         gm->set_instance(gm, inst);
         gm->score(gm, inst->labels, &score);
-        init_loss -= score;
+        init_loss -= score * inst->weight;
         gm->partition_factor(gm, &score);
-        init_loss += score;
+        init_loss += score * inst->weight;
     }
     init_loss += 0.5 * lambda * vecdot(w, w, K) * N;
     logging(lg, "Initial loss: %f\n", init_loss);
@@ -452,6 +459,8 @@ int crfsuite_train_l2sgd(
     const int N = trainset->num_instances;
     const int K = gm->num_features;
     const int T = gm->cap_items;
+    floatval_t sum_weight = 0.;
+    int i;
     training_option_t opt;
 
     /* Obtain parameter values. */
@@ -464,7 +473,11 @@ int crfsuite_train_l2sgd(
         goto error_exit;
     }
 
-    opt.lambda = 2. * opt.c2 / N;
+    /* Weighted instances count as that many sequences. */
+    for (i = 0;i < N;++i) {
+        sum_weight += dataset_get(trainset, i)->weight;
+    }
+    opt.lambda = 2. * opt.c2 / sum_weight;
 
     logging(lg, "Stochastic Gradient Descent (SGD)\n");
     logging(lg, "c2: %f\n", opt.c2);
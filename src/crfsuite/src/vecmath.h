@@ -47,7 +47,8 @@
 static inline void *_aligned_malloc(size_t size, size_t alignment)
 {
 #if __STDC_VERSION__ >= 201112L
-    return aligned_alloc(alignment, size);
+    /* C11 requires the size to be a multiple of the alignment */
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
 #elif _POSIX_C_SOURCE >= 200112L || _XOPEN_SOURCE >= 600 || __APPLE__
     void *p;
     int ret = posix_memalign(&p, alignment, size);
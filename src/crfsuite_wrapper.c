@@ -6,7 +6,11 @@
 #include "utils/builtins.h"
 #include "utils/memutils.h"
 
+#include "crf1d.h"
 #include "crfsuite_wrapper.h"
+#include "name_features.h"
+#include "parser_probes.h"
+#include "parser_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -40,11 +44,43 @@ CRFModel *create_crf_model(void) {
   model->version = NULL;
   model->model_size = 0;
   model->is_loaded = false;
+  model->attr_hits = NULL;
+  model->num_attrs = 0;
+  model->profiled_tokens = 0;
+  model->feature_templates = NAME_TEMPLATES_ALL;
 
   MemoryContextSwitchTo(oldcontext);
   return model;
 }
 
+/*
+ * Record which feature templates have any attribute in the model. Extraction
+ * skips the others without building their strings or looking them up.
+ * Hashed models store no attribute strings and keep every template.
+ */
+static void prune_feature_templates(CRFModel *model) {
+  uint64 templates = name_model_templates(model->attrs);
+  char disabled[1024];
+
+  model->feature_templates = templates;
+
+  if (templates == NAME_TEMPLATES_ALL)
+    return;
+
+  disabled[0] = '\0';
+  for (int t = 0; t < NUM_NAME_TEMPLATES; t++) {
+    if (!(templates & NAME_TEMPLATE_BIT(t))) {
+      size_t len = strlen(disabled);
+
+      snprintf(disabled + len, sizeof(disabled) - len, "%s%s",
+               len > 0 ? " " : "", name_template_name(t));
+    }
+  }
+  ereport(LOG, (errmsg("CRF model \"%s\" has no attributes for feature "
+                       "templates: %s (disabled)",
+                       model->model_name, disabled)));
+}
+
 /*
  * Load CRF model from binary data (BYTEA)
  */
@@ -73,19 +109,49 @@ CRFErrorCode load_model_from_bytea(CRFModel *model, const char *model_data,
   return CRF_SUCCESS;
 }
 
+/*
+ * Multiply-adds the tagger does for the state scores of instance: one per
+ * feature of every attribute found in the model. Reads the CRF1d model
+ * behind the attribute dictionary, which is how crf1d_tag.c builds it.
+ */
+static uint64 count_state_ops(CRFModel *model, crfsuite_instance_t *instance) {
+  crf1dm_t *crf1dm = (crf1dm_t *)model->attrs->internal;
+  uint64 ops = 0;
+
+  for (int t = 0; t < instance->num_items; t++) {
+    crfsuite_item_t *item = &instance->items[t];
+
+    for (int c = 0; c < item->num_contents; c++) {
+      feature_refs_t ref;
+
+      if (crf1dm_get_attrref(crf1dm, item->contents[c].aid, &ref) == 0)
+        ops += ref.num_features;
+    }
+  }
+  return ops;
+}
+
 /*
  * Predict label sequence using CRF model
+ *
+ * If profile is not NULL, the time of each stage and the arithmetic done
+ * are stored in it.
  */
 CRFErrorCode predict_sequence(CRFModel *model, crfsuite_instance_t *instance,
-                              int **labels, floatval_t *score) {
+                              int **labels, floatval_t *score,
+                              PredictProfile *profile) {
   int ret;
   crfsuite_tagger_t *tagger = NULL;
   int num_items;
+  int64 start = 0, scored = 0;
 
   if (model == NULL || !model->is_loaded || instance == NULL) {
     return CRF_ERROR_INVALID_MODEL;
   }
 
+  if (profile != NULL)
+    start = parser_clock_ns();
+
   /* Create tagger */
   ret = model->model->get_tagger(model->model, &tagger);
   if (ret != 0 || tagger == NULL) {
@@ -108,8 +174,13 @@ CRFErrorCode predict_sequence(CRFModel *model, crfsuite_instance_t *instance,
     return CRF_ERROR_MEMORY;
   }
 
+  if (profile != NULL || PARSER_PROBES_ENABLED)
+    scored = parser_clock_ns();
+
   /* Perform Viterbi decoding */
+  PARSER_PROBE_VITERBI_START(num_items, model->labels->num(model->labels));
   ret = tagger->viterbi(tagger, *labels, score);
+  PARSER_PROBE_VITERBI_DONE(num_items, parser_clock_ns() - scored);
   if (ret != 0) {
     pfree(*labels);
     *labels = NULL;
@@ -117,34 +188,59 @@ CRFErrorCode predict_sequence(CRFModel *model, crfsuite_instance_t *instance,
     return CRF_ERROR_PREDICTION;
   }
 
+  if (profile != NULL) {
+    int num_labels = model->labels->num(model->labels);
+
+    profile->viterbi_ns = parser_clock_ns() - scored;
+    profile->score_ns = scored - start;
+    profile->state_ops = count_state_ops(model, instance);
+    profile->transition_ops =
+        num_items > 1 ? (uint64)(num_items - 1) * num_labels * num_labels : 0;
+  }
+
   tagger->release(tagger);
   return CRF_SUCCESS;
 }
 
+/*
+ * Get the global slot for a model type
+ */
+static CRFModel **get_model_slot(const char *model_type) {
+  if (strcmp(model_type, "person") == 0)
+    return &person_model;
+  if (strcmp(model_type, "company") == 0)
+    return &company_model;
+  if (strcmp(model_type, "generic") == 0)
+    return &generic_model;
+  return NULL;
+}
+
 /*
  * Load model by type from file
  */
 CRFErrorCode load_model_from_file(const char *filename,
                                   const char *model_type) {
   int ret;
-  CRFModel **target_model;
-
-  if (strcmp(model_type, "person") == 0) {
-    target_model = &person_model;
-  } else if (strcmp(model_type, "company") == 0) {
-    target_model = &company_model;
-  } else if (strcmp(model_type, "generic") == 0) {
-    target_model = &generic_model;
-  } else {
+  CRFModel **target_model = get_model_slot(model_type);
+  crf1dm_memory_t memory;
+  int64 start pg_attribute_unused() = 0;
+
+  if (target_model == NULL) {
     return CRF_ERROR_INVALID_MODEL;
   }
 
+  if (PARSER_PROBES_ENABLED)
+    start = parser_clock_ns();
+  PARSER_PROBE_MODEL_LOAD_START(filename, model_type, *target_model != NULL);
+
   if (*target_model != NULL) {
     free_crf_model(*target_model);
   }
 
   *target_model = create_crf_model();
   if (*target_model == NULL) {
+    PARSER_PROBE_MODEL_LOAD_DONE(model_type, CRF_ERROR_MEMORY,
+                                 parser_clock_ns() - start);
     return CRF_ERROR_MEMORY;
   }
 
@@ -153,6 +249,8 @@ CRFErrorCode load_model_from_file(const char *filename,
                                            (void **)&(*target_model)->model);
   if (ret != 0 || (*target_model)->model == NULL) {
     /* Failed to open */
+    PARSER_PROBE_MODEL_LOAD_DONE(model_type, CRF_ERROR_MODEL_LOAD,
+                                 parser_clock_ns() - start);
     return CRF_ERROR_MODEL_LOAD;
   }
 
@@ -162,39 +260,101 @@ CRFErrorCode load_model_from_file(const char *filename,
   (*target_model)
       ->model->get_attrs((*target_model)->model, &(*target_model)->attrs);
 
+  crf1dt_get_model_memory((*target_model)->model, &memory);
+  (*target_model)->model_size = memory.file;
   (*target_model)->is_loaded = true;
   (*target_model)->model_name = pstrdup(model_type);
   (*target_model)->version = pstrdup("1.0");
 
   ereport(LOG, (errmsg("Loaded CRF model from %s", filename)));
+  prune_feature_templates(*target_model);
+  PARSER_PROBE_MODEL_LOAD_DONE(model_type, CRF_SUCCESS,
+                               parser_clock_ns() - start);
 
   return CRF_SUCCESS;
 }
 
+#ifdef EMBED_MODEL
+/*
+ * Load the model compiled into the shared object. The data is used in
+ * place, so there is no file I/O and all backends share the same pages.
+ */
+static CRFErrorCode load_embedded_model(void) {
+  CRFErrorCode ret;
+  CRFModel **target_model = get_model_slot(embedded_model_type);
+
+  if (target_model == NULL) {
+    return CRF_ERROR_INVALID_MODEL;
+  }
+
+  if (*target_model != NULL) {
+    free_crf_model(*target_model);
+  }
+
+  *target_model = create_crf_model();
+  if (*target_model == NULL) {
+    return CRF_ERROR_MEMORY;
+  }
+
+  ret = load_model_from_bytea(*target_model,
+                              (const char *)embedded_model_data,
+                              embedded_model_size);
+  if (ret != CRF_SUCCESS) {
+    return ret;
+  }
+
+  (*target_model)->model_name = pstrdup(embedded_model_type);
+  (*target_model)->version = pstrdup("1.0");
+
+  ereport(LOG, (errmsg("Loaded embedded CRF model \"%s\" (%zu bytes)",
+                       embedded_model_type, embedded_model_size)));
+  prune_feature_templates(*target_model);
+
+  return CRF_SUCCESS;
+}
+#endif
+
+/*
+ * Load one default model, from the shared object if it was embedded
+ */
+static CRFErrorCode load_default_model_type(const char *sharepath,
+                                            const char *model_type) {
+  char model_path[MAXPGPATH];
+  instr_time start, elapsed;
+  CRFErrorCode ret;
+
+  INSTR_TIME_SET_CURRENT(start);
+#ifdef EMBED_MODEL
+  if (strcmp(model_type, embedded_model_type) == 0) {
+    ret = load_embedded_model();
+  } else
+#endif
+  {
+    snprintf(model_path, MAXPGPATH,
+             "%s/extension/%s_learned_settings.crfsuite", sharepath,
+             model_type);
+    ret = load_model_from_file(model_path, model_type);
+  }
+  INSTR_TIME_SET_CURRENT(elapsed);
+  INSTR_TIME_SUBTRACT(elapsed, start);
+
+  if (ret == CRF_SUCCESS)
+    parser_stats_count_model_load(elapsed);
+  return ret;
+}
+
 /*
  * Load default active models
  */
 CRFErrorCode load_default_model(void) {
   char sharepath[MAXPGPATH];
-  char model_path[MAXPGPATH];
   CRFErrorCode res_person, res_company, res_generic;
 
   get_share_path(my_exec_path, sharepath);
 
-  /* Load Person Model */
-  snprintf(model_path, MAXPGPATH,
-           "%s/extension/person_learned_settings.crfsuite", sharepath);
-  res_person = load_model_from_file(model_path, "person");
-
-  /* Load Company Model */
-  snprintf(model_path, MAXPGPATH,
-           "%s/extension/company_learned_settings.crfsuite", sharepath);
-  res_company = load_model_from_file(model_path, "company");
-
-  /* Load Generic Model */
-  snprintf(model_path, MAXPGPATH,
-           "%s/extension/generic_learned_settings.crfsuite", sharepath);
-  res_generic = load_model_from_file(model_path, "generic");
+  res_person = load_default_model_type(sharepath, "person");
+  res_company = load_default_model_type(sharepath, "company");
+  res_generic = load_default_model_type(sharepath, "generic");
 
   if (res_person == CRF_SUCCESS || res_company == CRF_SUCCESS ||
       res_generic == CRF_SUCCESS)
@@ -215,6 +375,38 @@ CRFModel *get_active_model(const char *type) {
   return NULL;
 }
 
+/*
+ * Get the hit counters of a model, allocating them on first use. The
+ * counters live as long as the model and are private to this backend.
+ */
+uint64 *get_attribute_hits(CRFModel *model) {
+  if (model == NULL || model->attrs == NULL)
+    return NULL;
+
+  if (model->attr_hits == NULL) {
+    int num_attrs = model->attrs->num(model->attrs);
+
+    if (num_attrs <= 0)
+      return NULL;
+    model->attr_hits = (uint64 *)MemoryContextAllocZero(
+        crf_memory_context, num_attrs * sizeof(uint64));
+    model->num_attrs = num_attrs;
+    model->profiled_tokens = 0;
+  }
+  return model->attr_hits;
+}
+
+/*
+ * Clear the hit counters of a model
+ */
+void reset_attribute_hits(CRFModel *model) {
+  if (model == NULL || model->attr_hits == NULL)
+    return;
+
+  memset(model->attr_hits, 0, model->num_attrs * sizeof(uint64));
+  model->profiled_tokens = 0;
+}
+
 /*
  * Free CRF model resources
  */
@@ -242,6 +434,10 @@ void free_crf_model(CRFModel *model) {
     pfree(model->version);
   }
 
+  if (model->attr_hits != NULL) {
+    pfree(model->attr_hits);
+  }
+
   pfree(model);
 }
 
@@ -285,3 +481,29 @@ size_t get_model_size(const char *model_type) {
   }
   return 0;
 }
+
+/*
+ * Memory held by a loaded model, with the tagger sized for a name of
+ * num_tokens tokens. The crfsuite objects are malloc()ed, so they are not
+ * in crf_memory_context. Returns false if the model is not loaded.
+ */
+bool get_model_memory(const char *model_type, int num_tokens,
+                      CRFModelMemory *mem) {
+  CRFModel **slot = get_model_slot(model_type);
+  CRFModel *model = slot ? *slot : NULL;
+  crf1dm_memory_t crf1dm;
+
+  if (model == NULL || model->model == NULL || model->attrs == NULL)
+    return false;
+
+  crf1dt_get_model_memory(model->model, &crf1dm);
+  mem->file_bytes = crf1dm.file;
+  mem->buffer_bytes = crf1dm.buffer;
+  mem->structure_bytes = crf1dm.structures + sizeof(CRFModel);
+  mem->cqdb_bytes = crf1dm.cqdb;
+  mem->tagger_bytes = crf1dt_get_tagger_memory(
+      model->labels->num(model->labels), num_tokens);
+  mem->cache_bytes =
+      model->attr_hits != NULL ? model->num_attrs * sizeof(uint64) : 0;
+  return true;
+}
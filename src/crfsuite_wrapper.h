@@ -24,6 +24,11 @@ typedef struct {
   char *version;
   size_t model_size;
   bool is_loaded;
+  uint64 *attr_hits;     /* Per-attribute hit counts while profiling */
+  int num_attrs;         /* Length of attr_hits */
+  uint64 profiled_tokens; /* Tokens counted in attr_hits */
+  uint64 feature_templates; /* Feature templates with attributes in the
+                               model (NameTemplate bits) */
 } CRFModel;
 
 /* Token structure */
@@ -41,7 +46,7 @@ typedef struct {
   int num_tokens;
   float overall_confidence;
   char *model_version;
-  int processing_time_ms;
+  int64 processing_time_ns;
 } ParseResult;
 
 /* Feature structure for CRF input */
@@ -51,12 +56,21 @@ typedef struct {
   float *weights;
 } TokenFeatures;
 
+/* Work done by predict_sequence, for parse_name_profile() */
+typedef struct {
+  int64 score_ns;   /* Tagger setup and state scores */
+  int64 viterbi_ns; /* Viterbi decoding */
+  uint64 state_ops; /* State-score multiply-adds */
+  uint64 transition_ops; /* Viterbi transition additions */
+} PredictProfile;
+
 /* Function prototypes */
 CRFModel *create_crf_model(void);
 CRFErrorCode load_model_from_bytea(CRFModel *model, const char *model_data,
                                    size_t data_size);
 CRFErrorCode predict_sequence(CRFModel *model, crfsuite_instance_t *instance,
-                              int **labels, floatval_t *score);
+                              int **labels, floatval_t *score,
+                              PredictProfile *profile);
 void free_crf_model(CRFModel *model);
 void free_parse_result(ParseResult *result);
 
@@ -67,8 +81,32 @@ CRFErrorCode load_model_from_file(const char *filename, const char *model_type);
 CRFErrorCode load_default_model(void);
 CRFModel *get_active_model(const char *type);
 
+/* Attribute profiling (pg_probablepeople.profile_attributes) */
+extern bool crf_profile_attributes;
+uint64 *get_attribute_hits(CRFModel *model);
+void reset_attribute_hits(CRFModel *model);
+
+#ifdef EMBED_MODEL
+/* Model compiled into the shared object (make EMBED_MODEL=<type>) */
+extern const char embedded_model_type[];
+extern const unsigned char embedded_model_data[];
+extern const size_t embedded_model_size;
+#endif
+
+/* Memory of a loaded model, for pg_probablepeople_memory() */
+typedef struct {
+  size_t file_bytes;      /* Model file or image */
+  size_t buffer_bytes;    /* Private copy of the file (0 if mapped) */
+  size_t structure_bytes; /* Decoded header and model objects */
+  size_t cqdb_bytes;      /* Label and attribute hash tables */
+  size_t tagger_bytes;    /* Tagger made for each call, not kept */
+  size_t cache_bytes;     /* Attribute hit counters */
+} CRFModelMemory;
+
 /* Utility functions */
 char *escape_model_data(const char *data, size_t size);
 size_t get_model_size(const char *model_name);
+bool get_model_memory(const char *model_type, int num_tokens,
+                      CRFModelMemory *mem);
 
 #endif /* CRFSUITE_WRAPPER_H */
\ No newline at end of file
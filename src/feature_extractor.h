@@ -6,22 +6,6 @@
 #include "utils/memutils.h"
 #include <crfsuite.h>
 
-/* Feature types */
-#define MAX_FEATURE_NAME_LEN 128
-#define MAX_TOKEN_LEN 256
-#define FEATURE_WINDOW_SIZE 3
-
-typedef struct {
-  char name[MAX_FEATURE_NAME_LEN];
-  float weight;
-} Feature;
-
-typedef struct {
-  Feature *features;
-  int num_features;
-  int capacity;
-} FeatureSet;
-
 /* Token information for feature extraction */
 typedef struct {
   char *text;
@@ -32,40 +16,31 @@ typedef struct {
   bool is_last;
 } TokenInfo;
 
-/* Feature extraction functions */
-FeatureSet *create_feature_set(void);
-void free_feature_set(FeatureSet *fs);
-void add_feature(FeatureSet *fs, const char *name, float weight);
-
-/* Core feature extractors */
-void extract_token_features(TokenInfo *token, FeatureSet *features);
-void extract_shape_features(TokenInfo *token, FeatureSet *features);
-void extract_prefix_suffix_features(TokenInfo *token, FeatureSet *features);
-void extract_case_features(TokenInfo *token, FeatureSet *features);
-void extract_length_features(TokenInfo *token, FeatureSet *features);
-void extract_character_features(TokenInfo *token, FeatureSet *features);
-void extract_context_features(TokenInfo *tokens, int num_tokens, int position,
-                              FeatureSet *features);
-void extract_position_features(TokenInfo *token, int total_tokens,
-                               FeatureSet *features);
+/* Work done by create_crf_instance_from_tokens, added to by each call */
+typedef struct {
+  uint64 lookups; /* Attribute strings generated and looked up */
+  uint64 misses;  /* Lookups of attributes not in the model */
+  /* Only filled in when timed is set, for parse_name_profile() */
+  bool timed;
+  int64 extract_ns;         /* Generating attribute strings */
+  int64 lookup_ns;          /* Dictionary lookups and building items */
+  int *features_per_token;  /* If not NULL, one entry per token */
+} FeatureLookupStats;
 
 /*
  * Create a CRFSuite instance from token sequence
+ *
+ * Attributes come from the feature library shared with the trainer
+ * (name_features.h). Only the templates in the templates set are generated,
+ * and attributes not in the model are skipped. If attr_hits is not NULL,
+ * the counter of every attribute found in the model is incremented. The
+ * work done is added to *stats.
  */
 crfsuite_instance_t *
 create_crf_instance_from_tokens(TokenInfo *tokens, int num_tokens,
-                                crfsuite_dictionary_t *attrs);
+                                crfsuite_dictionary_t *attrs,
+                                uint64 templates, uint64 *attr_hits,
+                                FeatureLookupStats *stats);
 void free_crf_instance(crfsuite_instance_t *instance);
 
-/* Utility functions */
-char *get_token_shape(const char *token);
-bool is_capitalized(const char *token);
-bool is_all_caps(const char *token);
-bool is_all_lower(const char *token);
-bool has_digit(const char *token);
-bool has_punctuation(const char *token);
-bool is_numeric(const char *token);
-char *get_prefix(const char *token, int length);
-char *get_suffix(const char *token, int length);
-
-#endif /* FEATURE_EXTRACTOR_H */
\ No newline at end of file
+#endif /* FEATURE_EXTRACTOR_H */
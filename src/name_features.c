@@ -0,0 +1,320 @@
+/* src/name_features.c */
+#include "name_features.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Templates in NameTemplate order; those ending in ':' or '=' take a value */
+static const char *const template_names[NUM_NAME_TEMPLATES] = {
+    "token:",         "token_lower:",  "nopunc:",
+    "prefix_1:",      "prefix_2:",     "prefix_3:",    "prefix_4:",
+    "suffix_1:",      "suffix_2:",     "suffix_3:",    "suffix_4:",
+    "is_capitalized", "is_all_caps",   "is_all_lower",
+    "length:",        "is_single_char", "is_two_char", "is_short",
+    "is_long",        "has_digit",     "has_punct",    "has_hyphen",
+    "has_dot",        "ends_with_dot", "prev_1=",      "prev_2=",
+    "next_1=",        "next_2=",       "is_first",     "is_last",
+    "bias"};
+
+#define ENABLED(templates, t) (((templates) & NAME_TEMPLATE_BIT(t)) != 0)
+
+/* Add feature to list */
+static void add_feature(NameFeatureList *list, const char *name,
+                        float value) {
+  if (list->num_features >= NAME_FEATURES_PER_TOKEN)
+    return;
+  strncpy(list->features[list->num_features].name, name,
+          NAME_FEATURE_LEN - 1);
+  list->features[list->num_features].name[NAME_FEATURE_LEN - 1] = '\0';
+  list->features[list->num_features].value = value;
+  list->num_features++;
+}
+
+/* Token identity, lowercase and punctuation-free forms */
+static void extract_token_features(const char *token, uint64_t templates,
+                                   NameFeatureList *features) {
+  char buf[NAME_FEATURE_LEN];
+  int len = strlen(token);
+
+  /* Token identity */
+  if (ENABLED(templates, NAME_TEMPLATE_TOKEN)) {
+    snprintf(buf, sizeof(buf), "token:%s", token);
+    add_feature(features, buf, 1.0);
+  }
+  if (!ENABLED(templates, NAME_TEMPLATE_TOKEN_LOWER) &&
+      !ENABLED(templates, NAME_TEMPLATE_NOPUNC))
+    return;
+
+  /* Lowercase token */
+  char lower[256];
+  for (int i = 0; i < len && i < 255; i++) {
+    lower[i] = tolower((unsigned char)token[i]);
+  }
+  lower[len < 255 ? len : 255] = '\0';
+
+  if (ENABLED(templates, NAME_TEMPLATE_TOKEN_LOWER)) {
+    snprintf(buf, sizeof(buf), "token_lower:%s", lower);
+    add_feature(features, buf, 1.0);
+  }
+  if (!ENABLED(templates, NAME_TEMPLATE_NOPUNC))
+    return;
+
+  /* No punctuation version */
+  char nopunc[256];
+  int j = 0;
+  for (int i = 0; i < (len < 255 ? len : 255) && j < 254; i++) {
+    if (!ispunct((unsigned char)lower[i])) {
+      nopunc[j++] = lower[i];
+    }
+  }
+  nopunc[j] = '\0';
+  if (j > 0) {
+    snprintf(buf, sizeof(buf), "nopunc:%s", nopunc);
+    add_feature(features, buf, 1.0);
+  }
+}
+
+/* Prefix/suffix features */
+static void extract_affix_features(const char *token, uint64_t templates,
+                                   NameFeatureList *features) {
+  const uint64_t affixes =
+      NAME_TEMPLATE_BIT(NAME_TEMPLATE_PREFIX_1) |
+      NAME_TEMPLATE_BIT(NAME_TEMPLATE_PREFIX_2) |
+      NAME_TEMPLATE_BIT(NAME_TEMPLATE_PREFIX_3) |
+      NAME_TEMPLATE_BIT(NAME_TEMPLATE_PREFIX_4) |
+      NAME_TEMPLATE_BIT(NAME_TEMPLATE_SUFFIX_1) |
+      NAME_TEMPLATE_BIT(NAME_TEMPLATE_SUFFIX_2) |
+      NAME_TEMPLATE_BIT(NAME_TEMPLATE_SUFFIX_3) |
+      NAME_TEMPLATE_BIT(NAME_TEMPLATE_SUFFIX_4);
+  char buf[NAME_FEATURE_LEN];
+  int len = strlen(token);
+
+  if ((templates & affixes) == 0)
+    return;
+
+  /* Lowercase and strip punctuation first */
+  char clean[256];
+  int j = 0;
+  for (int i = 0; i < len && j < 254; i++) {
+    unsigned char c = (unsigned char)token[i];
+    if (!ispunct(c)) {
+      clean[j++] = tolower(c);
+    }
+  }
+  clean[j] = '\0';
+  len = j;
+
+  /* Prefix features (1-4 chars) */
+  for (int plen = 1; plen <= 4 && plen <= len; plen++) {
+    char prefix[8];
+    if (!ENABLED(templates, NAME_TEMPLATE_PREFIX_1 + plen - 1))
+      continue;
+    strncpy(prefix, clean, plen);
+    prefix[plen] = '\0';
+    snprintf(buf, sizeof(buf), "prefix_%d:%s", plen, prefix);
+    add_feature(features, buf, 1.0);
+  }
+
+  /* Suffix features (1-4 chars) */
+  for (int slen = 1; slen <= 4 && slen <= len; slen++) {
+    char suffix[8];
+    if (!ENABLED(templates, NAME_TEMPLATE_SUFFIX_1 + slen - 1))
+      continue;
+    strncpy(suffix, clean + len - slen, slen);
+    suffix[slen] = '\0';
+    snprintf(buf, sizeof(buf), "suffix_%d:%s", slen, suffix);
+    add_feature(features, buf, 1.0);
+  }
+}
+
+/* Case features */
+static void extract_case_features(const char *token, uint64_t templates,
+                                  NameFeatureList *features) {
+  int len = strlen(token);
+  if (len == 0)
+    return;
+
+  int upper_count = 0, lower_count = 0;
+
+  for (int i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)token[i];
+    if (isupper(c))
+      upper_count++;
+    else if (islower(c))
+      lower_count++;
+  }
+
+  if (isupper((unsigned char)token[0]) &&
+      ENABLED(templates, NAME_TEMPLATE_IS_CAPITALIZED))
+    add_feature(features, "is_capitalized", 1.0);
+  if (upper_count == len && ENABLED(templates, NAME_TEMPLATE_IS_ALL_CAPS))
+    add_feature(features, "is_all_caps", 1.0);
+  if (lower_count == len && ENABLED(templates, NAME_TEMPLATE_IS_ALL_LOWER))
+    add_feature(features, "is_all_lower", 1.0);
+}
+
+/* Length features */
+static void extract_length_features(const char *token, uint64_t templates,
+                                    NameFeatureList *features) {
+  char buf[NAME_FEATURE_LEN];
+  int len = strlen(token);
+
+  if (ENABLED(templates, NAME_TEMPLATE_LENGTH)) {
+    snprintf(buf, sizeof(buf), "length:%d", len);
+    add_feature(features, buf, 1.0);
+  }
+
+  if (len == 1) {
+    if (ENABLED(templates, NAME_TEMPLATE_IS_SINGLE_CHAR))
+      add_feature(features, "is_single_char", 1.0);
+  } else if (len == 2) {
+    if (ENABLED(templates, NAME_TEMPLATE_IS_TWO_CHAR))
+      add_feature(features, "is_two_char", 1.0);
+  } else if (len <= 4) {
+    if (ENABLED(templates, NAME_TEMPLATE_IS_SHORT))
+      add_feature(features, "is_short", 1.0);
+  } else if (len >= 10) {
+    if (ENABLED(templates, NAME_TEMPLATE_IS_LONG))
+      add_feature(features, "is_long", 1.0);
+  }
+}
+
+/* Character class features */
+static void extract_char_features(const char *token, uint64_t templates,
+                                  NameFeatureList *features) {
+  int len = strlen(token);
+  int has_digit = 0, has_punct = 0, has_hyphen = 0, has_dot = 0;
+
+  for (int i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)token[i];
+    if (isdigit(c))
+      has_digit = 1;
+    if (ispunct(c))
+      has_punct = 1;
+    if (c == '-')
+      has_hyphen = 1;
+    if (c == '.')
+      has_dot = 1;
+  }
+
+  if (has_digit && ENABLED(templates, NAME_TEMPLATE_HAS_DIGIT))
+    add_feature(features, "has_digit", 1.0);
+  if (has_punct && ENABLED(templates, NAME_TEMPLATE_HAS_PUNCT))
+    add_feature(features, "has_punct", 1.0);
+  if (has_hyphen && ENABLED(templates, NAME_TEMPLATE_HAS_HYPHEN))
+    add_feature(features, "has_hyphen", 1.0);
+  if (has_dot && ENABLED(templates, NAME_TEMPLATE_HAS_DOT))
+    add_feature(features, "has_dot", 1.0);
+
+  /* Check if ends with period (abbreviation) */
+  if (len > 1 && token[len - 1] == '.' &&
+      ENABLED(templates, NAME_TEMPLATE_ENDS_WITH_DOT))
+    add_feature(features, "ends_with_dot", 1.0);
+}
+
+/* Neighbouring tokens, with BOS/EOS past the ends of the sequence */
+static void extract_context_features(const char *const *tokens,
+                                     int num_tokens, int position,
+                                     uint64_t templates,
+                                     NameFeatureList *features) {
+  char buf[NAME_FEATURE_LEN];
+
+  /* Previous tokens */
+  for (int i = 1; i <= NAME_FEATURE_WINDOW; i++) {
+    int prev_pos = position - i;
+    if (!ENABLED(templates, NAME_TEMPLATE_PREV_1 + i - 1))
+      continue;
+    if (prev_pos >= 0) {
+      snprintf(buf, sizeof(buf), "prev_%d=%s", i, tokens[prev_pos]);
+      add_feature(features, buf, 0.8);
+    } else {
+      snprintf(buf, sizeof(buf), "prev_%d=BOS", i);
+      add_feature(features, buf, 0.5);
+    }
+  }
+
+  /* Next tokens */
+  for (int i = 1; i <= NAME_FEATURE_WINDOW; i++) {
+    int next_pos = position + i;
+    if (!ENABLED(templates, NAME_TEMPLATE_NEXT_1 + i - 1))
+      continue;
+    if (next_pos < num_tokens) {
+      snprintf(buf, sizeof(buf), "next_%d=%s", i, tokens[next_pos]);
+      add_feature(features, buf, 0.8);
+    } else {
+      snprintf(buf, sizeof(buf), "next_%d=EOS", i);
+      add_feature(features, buf, 0.5);
+    }
+  }
+}
+
+/* Position features */
+static void extract_position_features(int position, int total,
+                                      uint64_t templates,
+                                      NameFeatureList *features) {
+  if (position == 0 && ENABLED(templates, NAME_TEMPLATE_IS_FIRST))
+    add_feature(features, "is_first", 1.0);
+  if (position == total - 1 && ENABLED(templates, NAME_TEMPLATE_IS_LAST))
+    add_feature(features, "is_last", 1.0);
+}
+
+void extract_name_features(const char *const *tokens, int num_tokens,
+                           int position, uint64_t templates,
+                           NameFeatureList *features) {
+  const char *token = tokens[position];
+
+  features->num_features = 0;
+
+  extract_token_features(token, templates, features);
+  extract_affix_features(token, templates, features);
+  extract_case_features(token, templates, features);
+  extract_length_features(token, templates, features);
+  extract_char_features(token, templates, features);
+  extract_context_features(tokens, num_tokens, position, templates, features);
+  extract_position_features(position, num_tokens, templates, features);
+
+  /* Bias feature */
+  if (ENABLED(templates, NAME_TEMPLATE_BIAS))
+    add_feature(features, "bias", 1.0);
+}
+
+int name_feature_template(const char *attribute) {
+  for (int t = 0; t < NUM_NAME_TEMPLATES; t++) {
+    const char *name = template_names[t];
+    size_t len = strlen(name);
+
+    if (name[len - 1] == ':' || name[len - 1] == '=') {
+      if (strncmp(attribute, name, len) == 0)
+        return t;
+    } else if (strcmp(attribute, name) == 0) {
+      return t;
+    }
+  }
+  return -1;
+}
+
+const char *name_template_name(int template_id) {
+  if (template_id < 0 || template_id >= NUM_NAME_TEMPLATES)
+    return NULL;
+  return template_names[template_id];
+}
+
+uint64_t name_model_templates(crfsuite_dictionary_t *attrs) {
+  int num_attrs = attrs->num(attrs);
+  uint64_t templates = 0;
+
+  for (int aid = 0; aid < num_attrs && templates != NAME_TEMPLATES_ALL;
+       aid++) {
+    const char *attr = NULL;
+    int t;
+
+    if (attrs->to_string(attrs, aid, &attr) != 0 || attr == NULL)
+      return NAME_TEMPLATES_ALL;
+    t = name_feature_template(attr);
+    if (t >= 0)
+      templates |= NAME_TEMPLATE_BIT(t);
+    attrs->free(attrs, attr);
+  }
+  return templates;
+}
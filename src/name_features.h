@@ -0,0 +1,97 @@
+/* src/name_features.h */
+#ifndef NAME_FEATURES_H
+#define NAME_FEATURES_H
+
+/*
+ * Feature extraction shared by the trainer and the extension
+ *
+ * A model only scores attribute strings it was trained with, so training
+ * and tagging must generate byte-identical attributes for the same tokens.
+ * This file has no PostgreSQL dependencies and is compiled into both
+ * train_model and the extension. Changing any attribute string here
+ * invalidates the bundled models until they are retrained.
+ */
+
+#include <crfsuite.h>
+#include <stdint.h>
+
+#define NAME_FEATURE_LEN 256        /* Longest attribute string, with NUL */
+#define NAME_FEATURES_PER_TOKEN 100 /* Further attributes are dropped */
+#define NAME_FEATURE_WINDOW 2       /* Neighbours on each side */
+
+/*
+ * Feature templates: every attribute is generated by exactly one of them.
+ * A model without any attribute of a template can skip it entirely.
+ */
+typedef enum {
+  NAME_TEMPLATE_TOKEN,       /* token:<text> */
+  NAME_TEMPLATE_TOKEN_LOWER, /* token_lower:<text> */
+  NAME_TEMPLATE_NOPUNC,      /* nopunc:<text> */
+  NAME_TEMPLATE_PREFIX_1,    /* prefix_1:<text> ... prefix_4:<text> */
+  NAME_TEMPLATE_PREFIX_2,
+  NAME_TEMPLATE_PREFIX_3,
+  NAME_TEMPLATE_PREFIX_4,
+  NAME_TEMPLATE_SUFFIX_1,    /* suffix_1:<text> ... suffix_4:<text> */
+  NAME_TEMPLATE_SUFFIX_2,
+  NAME_TEMPLATE_SUFFIX_3,
+  NAME_TEMPLATE_SUFFIX_4,
+  NAME_TEMPLATE_IS_CAPITALIZED,
+  NAME_TEMPLATE_IS_ALL_CAPS,
+  NAME_TEMPLATE_IS_ALL_LOWER,
+  NAME_TEMPLATE_LENGTH,      /* length:<n> */
+  NAME_TEMPLATE_IS_SINGLE_CHAR,
+  NAME_TEMPLATE_IS_TWO_CHAR,
+  NAME_TEMPLATE_IS_SHORT,
+  NAME_TEMPLATE_IS_LONG,
+  NAME_TEMPLATE_HAS_DIGIT,
+  NAME_TEMPLATE_HAS_PUNCT,
+  NAME_TEMPLATE_HAS_HYPHEN,
+  NAME_TEMPLATE_HAS_DOT,
+  NAME_TEMPLATE_ENDS_WITH_DOT,
+  NAME_TEMPLATE_PREV_1,      /* prev_1=<text> ... next_2=<text> */
+  NAME_TEMPLATE_PREV_2,
+  NAME_TEMPLATE_NEXT_1,
+  NAME_TEMPLATE_NEXT_2,
+  NAME_TEMPLATE_IS_FIRST,
+  NAME_TEMPLATE_IS_LAST,
+  NAME_TEMPLATE_BIAS,
+  NUM_NAME_TEMPLATES
+} NameTemplate;
+
+/* Set of templates, one bit per NameTemplate */
+#define NAME_TEMPLATE_BIT(t) ((uint64_t)1 << (t))
+#define NAME_TEMPLATES_ALL (NAME_TEMPLATE_BIT(NUM_NAME_TEMPLATES) - 1)
+
+/* One attribute of a token */
+typedef struct {
+  char name[NAME_FEATURE_LEN];
+  float value;
+} NameFeature;
+
+/* Attributes of one token, in generation order */
+typedef struct {
+  NameFeature features[NAME_FEATURES_PER_TOKEN];
+  int num_features;
+} NameFeatureList;
+
+/* Fill features with the attributes of tokens[position], a sequence of
+ * num_tokens token strings. Only the templates in the templates set are
+ * generated; pass NAME_TEMPLATES_ALL for all of them.
+ */
+void extract_name_features(const char *const *tokens, int num_tokens,
+                           int position, uint64_t templates,
+                           NameFeatureList *features);
+
+/* Template of an attribute string, or -1 if no template generates it */
+int name_feature_template(const char *attribute);
+
+/* Printable name of a template, e.g. "prefix_1:" or "bias" */
+const char *name_template_name(int template_id);
+
+/* Templates with at least one attribute in a model's dictionary, the only
+ * ones worth extracting for it. Hashed models store no attribute strings
+ * and keep every template.
+ */
+uint64_t name_model_templates(crfsuite_dictionary_t *attrs);
+
+#endif /* NAME_FEATURES_H */
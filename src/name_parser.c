@@ -1,6 +1,7 @@
 /* src/name_parser.c */
 #include "postgres.h"
 /* Postgres headers first */
+#include "lib/stringinfo.h"
 #include "utils/builtins.h"
 #include "utils/json.h"
 #include "utils/jsonb.h"
@@ -9,134 +10,152 @@
 #include "crfsuite_wrapper.h"
 #include "feature_extractor.h"
 #include "name_parser.h"
+#include "parser_probes.h"
+#include "parser_stats.h"
 
 #include <ctype.h>
 #include <string.h>
-#include <sys/time.h>
 
 extern MemoryContext crf_memory_context;
 
 /*
- * Simple tokenizer for name strings
- * Splits on whitespace and some punctuation while preserving meaningful
- * punctuation
+ * Log a parse that took longer than pg_probablepeople.log_min_duration_us.
+ * The statement is left out of the message, since it usually contains the
+ * name; the input is only logged with pg_probablepeople.log_input.
  */
-TokenInfo *tokenize_name_string(const char *input, int *num_tokens) {
-  char *input_copy, *token, *saveptr;
-  TokenInfo *tokens;
-  int capacity = 20; /* Initial capacity */
-  int count = 0;
-  char *delimiters = " \t\n\r";
-
-  if (input == NULL || num_tokens == NULL) {
-    *num_tokens = 0;
-    return NULL;
-  }
-
-  tokens = (TokenInfo *)palloc(capacity * sizeof(TokenInfo));
-  input_copy = pstrdup(input);
-
-  /* Simple whitespace tokenization */
-  token = strtok_r(input_copy, delimiters, &saveptr);
-  while (token != NULL) {
-    /* Resize array if needed */
-    if (count >= capacity) {
-      capacity *= 2;
-      tokens = (TokenInfo *)repalloc(tokens, capacity * sizeof(TokenInfo));
-    }
-
-    /* Clean up token (remove extra punctuation) */
-    char *clean_token;
-    int len;
-
-    clean_token = pstrdup(token);
-    len = strlen(clean_token);
-
-    /* Remove trailing punctuation except for meaningful ones */
-    while (len > 0 &&
-           (clean_token[len - 1] == ',' || clean_token[len - 1] == '.')) {
-      if (clean_token[len - 1] == '.' && len > 1 &&
-          (strcmp(clean_token, "Jr.") == 0 || strcmp(clean_token, "Sr.") == 0 ||
-           strcmp(clean_token, "Dr.") == 0 || strcmp(clean_token, "Mr.") == 0 ||
-           strcmp(clean_token, "Ms.") == 0 ||
-           strcmp(clean_token, "Inc.") == 0 ||
-           strcmp(clean_token, "Corp.") == 0 ||
-           strcmp(clean_token, "Co.") == 0 ||
-           strcmp(clean_token, "Ltd.") == 0 ||
-           strcmp(clean_token, "Esq.") == 0 ||
-           strcmp(clean_token, "Mrs.") == 0)) {
-        break; /* Keep meaningful dots */
-      }
-      clean_token[len - 1] = '\0';
-      len--;
-    }
-
-    if (len > 0) { /* Only add non-empty tokens */
-      tokens[count].text = clean_token;
-      tokens[count].position = count;
-      tokens[count].start_char = 0; /* Simplified for now */
-      tokens[count].end_char = len;
-      tokens[count].is_first = (count == 0);
-      tokens[count].is_last = false; /* Will be set later */
-      count++;
-    } else {
-      pfree(clean_token);
-    }
-
-    token = strtok_r(NULL, delimiters, &saveptr);
-  }
-
-  /* Set last token flag */
-  if (count > 0) {
-    tokens[count - 1].is_last = true;
-  }
-
-  pfree(input_copy);
-  *num_tokens = count;
-  return tokens;
+static void log_slow_parse(const char *input_text, ParseResult *result,
+                           ParseProfile *profile) {
+  FeatureLookupStats *features = &profile->features;
+  StringInfoData detail;
+
+  initStringInfo(&detail);
+  appendStringInfo(&detail,
+                   "Stages (us): tokenize %.3f, features %.3f, lookup %.3f, "
+                   "score %.3f, viterbi %.3f, result %.3f.",
+                   profile->tokenize_ns / 1000.0, features->extract_ns / 1000.0,
+                   features->lookup_ns / 1000.0,
+                   profile->predict.score_ns / 1000.0,
+                   profile->predict.viterbi_ns / 1000.0,
+                   profile->result_ns / 1000.0);
+  if (crf_log_input)
+    appendStringInfo(&detail, " Input: \"%s\".", input_text);
+
+  ereport(LOG,
+          (errmsg("pg_probablepeople: slow parse: duration: %.3f us, "
+                  "input length: %zu, tokens: %d, features: " UINT64_FORMAT
+                  ", in model: " UINT64_FORMAT,
+                  result->processing_time_ns / 1000.0, strlen(input_text),
+                  result->num_tokens, features->lookups,
+                  features->lookups - features->misses),
+           errdetail_internal("%s", detail.data), errhidestmt(true)));
+  pfree(detail.data);
 }
 
 /*
  * Main name parsing function
+ *
+ * If profile is not NULL, the time and work of every stage are stored in
+ * it; profile->features.features_per_token is allocated here.
  */
-ParseResult *parse_name_string(const char *input_text, CRFModel *model) {
+ParseResult *parse_name_string(const char *input_text, CRFModel *model,
+                               ParseProfile *profile) {
   TokenInfo *tokens;
   int num_tokens;
   crfsuite_instance_t *instance;
   int *predicted_labels;
   floatval_t score;
   ParseResult *result;
-  struct timeval start_time, end_time;
+  int64 start_time, stage_start = 0;
   CRFErrorCode crf_result;
+  bool truncated;
+  uint64 *attr_hits;
+  FeatureLookupStats local_stats = {0};
+  FeatureLookupStats *stats;
+  ParseProfile slow_profile;
 
   if (input_text == NULL || model == NULL || !model->is_loaded) {
     return NULL;
   }
 
-  gettimeofday(&start_time, NULL);
+  /* Stage times are needed to log a slow parse */
+  if (profile == NULL && crf_log_min_duration_us >= 0) {
+    memset(&slow_profile, 0, sizeof(slow_profile));
+    slow_profile.features.timed = true;
+    profile = &slow_profile;
+  }
+  stats = profile ? &profile->features : &local_stats;
+
+  start_time = parser_clock_ns();
+  PARSER_PROBE_PARSE_START(input_text);
+
+  /* Tokenize input, reading no more than the limits allow */
+  tokens = tokenize_name_string(input_text, crf_max_input_bytes,
+                                crf_max_tokens, &num_tokens, &truncated);
+  if (profile != NULL || PARSER_PROBES_ENABLED) {
+    stage_start = parser_clock_ns();
+    if (profile != NULL)
+      profile->tokenize_ns = stage_start - start_time;
+    PARSER_PROBE_TOKENIZE_DONE(num_tokens, stage_start - start_time);
+  }
+  if (truncated && crf_oversize_input != OVERSIZE_INPUT_TRUNCATE) {
+    size_t input_bytes = strlen(input_text);
 
-  /* Tokenize input */
-  tokens = tokenize_name_string(input_text, &num_tokens);
+    free_token_info_array(tokens, num_tokens);
+    if (crf_oversize_input == OVERSIZE_INPUT_ERROR) {
+      if (crf_max_input_bytes > 0 && input_bytes > (size_t)crf_max_input_bytes)
+        ereport(ERROR,
+                (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                 errmsg("name is too long to parse"),
+                 errdetail("The name has %zu bytes; "
+                           "pg_probablepeople.max_input_bytes is %d.",
+                           input_bytes, crf_max_input_bytes)));
+      ereport(ERROR, (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                      errmsg("name has too many tokens to parse"),
+                      errdetail("pg_probablepeople.max_tokens is %d.",
+                                crf_max_tokens)));
+    }
+    PARSER_PROBE_PARSE_DONE(0, parser_clock_ns() - start_time);
+    return NULL;
+  }
   if (tokens == NULL || num_tokens == 0) {
+    PARSER_PROBE_PARSE_DONE(0, parser_clock_ns() - start_time);
     return NULL;
   }
 
-  /* Create CRF instance with features */
-  instance = create_crf_instance_from_tokens(tokens, num_tokens, model->attrs);
+  if (profile != NULL && profile != &slow_profile) {
+    memset(stats, 0, sizeof(FeatureLookupStats));
+    stats->timed = true;
+    stats->features_per_token = (int *)palloc0(num_tokens * sizeof(int));
+  }
+
+  /* Create CRF instance with features, counting them when profiling */
+  attr_hits = crf_profile_attributes ? get_attribute_hits(model) : NULL;
+  instance = create_crf_instance_from_tokens(tokens, num_tokens, model->attrs,
+                                             model->feature_templates,
+                                             attr_hits, stats);
+  PARSER_PROBE_FEATURES_DONE(num_tokens, stats->lookups - stats->misses,
+                             parser_clock_ns() - stage_start);
+  parser_stats_count_parse(num_tokens, stats->lookups, stats->misses);
   if (instance == NULL) {
     free_token_info_array(tokens, num_tokens);
+    PARSER_PROBE_PARSE_DONE(0, parser_clock_ns() - start_time);
     return NULL;
   }
+  if (attr_hits != NULL)
+    model->profiled_tokens += num_tokens;
 
   /* Perform CRF prediction */
-  crf_result = predict_sequence(model, instance, &predicted_labels, &score);
+  crf_result = predict_sequence(model, instance, &predicted_labels, &score,
+                                profile ? &profile->predict : NULL);
   if (crf_result != CRF_SUCCESS) {
     free_crf_instance(instance);
     free_token_info_array(tokens, num_tokens);
+    PARSER_PROBE_PARSE_DONE(0, parser_clock_ns() - start_time);
     return NULL;
   }
 
   /* Create result structure */
+  stage_start = parser_clock_ns();
   result = (ParseResult *)palloc0(sizeof(ParseResult));
   result->tokens = (Token *)palloc(num_tokens * sizeof(Token));
   result->num_tokens = num_tokens;
@@ -154,9 +173,13 @@ ParseResult *parse_name_string(const char *input_text, CRFModel *model) {
     result->tokens[i].end_pos = tokens[i].end_char;
   }
 
-  gettimeofday(&end_time, NULL);
-  result->processing_time_ms = (end_time.tv_sec - start_time.tv_sec) * 1000 +
-                               (end_time.tv_usec - start_time.tv_usec) / 1000;
+  result->processing_time_ns = parser_clock_ns() - start_time;
+  if (profile != NULL)
+    profile->result_ns = start_time + result->processing_time_ns - stage_start;
+  PARSER_PROBE_PARSE_DONE(num_tokens, result->processing_time_ns);
+  if (crf_log_min_duration_us >= 0 &&
+      result->processing_time_ns >= (int64)crf_log_min_duration_us * 1000)
+    log_slow_parse(input_text, result, profile);
 
   /* Cleanup */
   pfree(predicted_labels);
@@ -166,21 +189,6 @@ ParseResult *parse_name_string(const char *input_text, CRFModel *model) {
   return result;
 }
 
-/*
- * Free token info array
- */
-void free_token_info_array(TokenInfo *tokens, int num_tokens) {
-  if (tokens == NULL)
-    return;
-
-  for (int i = 0; i < num_tokens; i++) {
-    if (tokens[i].text != NULL) {
-      pfree(tokens[i].text);
-    }
-  }
-  pfree(tokens);
-}
-
 /*
  * Map CRF label ID to name component string
  */
@@ -4,6 +4,7 @@
 
 #include "crfsuite_wrapper.h"
 #include "feature_extractor.h"
+#include "name_tokenizer.h"
 #include "postgres.h"
 
 /* Result structure for column-based parsing */
@@ -20,17 +21,40 @@ typedef struct {
   char *other;
 } ParsedNameCols;
 
+/* Breakdown of one parse, for parse_name_profile() */
+typedef struct {
+  int64 tokenize_ns;
+  FeatureLookupStats features; /* Extraction and lookup */
+  PredictProfile predict;      /* State scores and Viterbi */
+  int64 result_ns;             /* Building the ParseResult */
+} ParseProfile;
+
+/* What to do with an input over pg_probablepeople.max_input_bytes or
+ * max_tokens */
+typedef enum {
+  OVERSIZE_INPUT_TRUNCATE, /* Parse what fits */
+  OVERSIZE_INPUT_ERROR,
+  OVERSIZE_INPUT_NULL /* Return no result */
+} OversizeInputAction;
+
+/* GUCs: limits on the input of one parse, zero for none */
+extern int crf_max_input_bytes;
+extern int crf_max_tokens;
+extern int crf_oversize_input;
+
+/* GUCs: log parses slower than this many microseconds (-1 disables), and
+ * whether to include the input in the message */
+extern int crf_log_min_duration_us;
+extern bool crf_log_input;
+
 /* Core parsing functions */
-ParseResult *parse_name_string(const char *input_text, CRFModel *model);
+ParseResult *parse_name_string(const char *input_text, CRFModel *model,
+                               ParseProfile *profile);
 const char *map_crf_label_to_name_component(int label_id, CRFModel *model);
 JsonbValue *parse_result_to_jsonb(ParseResult *result);
 ParsedNameCols *parse_name_to_cols(ParseResult *result);
 void free_parsed_name_cols(ParsedNameCols *cols);
 
-/* Helper functions */
-TokenInfo *tokenize_name_string(const char *input, int *num_tokens);
-void free_token_info_array(TokenInfo *tokens, int num_tokens);
-
 /* Caching functions - Removed */
 
 /* Label mapping */
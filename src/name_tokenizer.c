@@ -0,0 +1,139 @@
+/* src/name_tokenizer.c */
+#include "postgres.h"
+#include "mb/pg_wchar.h"
+
+#include "name_tokenizer.h"
+
+#include <string.h>
+
+/* Length of input to tokenize under max_bytes, on a character boundary and
+ * if possible on whitespace */
+static int clip_input(const char *input, int len, int max_bytes) {
+  int clip = pg_mbcliplen(input, len, max_bytes);
+
+  /* Keep a token that ends exactly at the limit */
+  if (input[clip] == ' ' || input[clip] == '\t' || input[clip] == '\n' ||
+      input[clip] == '\r')
+    return clip;
+  for (int i = clip; i > 0; i--) {
+    if (input[i - 1] == ' ' || input[i - 1] == '\t' || input[i - 1] == '\n' ||
+        input[i - 1] == '\r')
+      return i;
+  }
+  return clip;
+}
+
+/*
+ * Simple tokenizer for name strings
+ * Splits on whitespace and some punctuation while preserving meaningful
+ * punctuation
+ */
+TokenInfo *tokenize_name_string(const char *input, int max_bytes,
+                                int max_tokens, int *num_tokens,
+                                bool *truncated) {
+  char *input_copy, *token, *saveptr;
+  TokenInfo *tokens;
+  int capacity = 20; /* Initial capacity */
+  int count = 0;
+  int input_len;
+  char *delimiters = " \t\n\r";
+
+  *truncated = false;
+  if (input == NULL || num_tokens == NULL) {
+    *num_tokens = 0;
+    return NULL;
+  }
+
+  /* Copy only what will be tokenized */
+  input_len = strlen(input);
+  if (max_bytes > 0 && input_len > max_bytes) {
+    input_len = clip_input(input, input_len, max_bytes);
+    *truncated = true;
+  }
+  if (max_tokens > 0 && capacity > max_tokens)
+    capacity = max_tokens;
+
+  tokens = (TokenInfo *)palloc(capacity * sizeof(TokenInfo));
+  input_copy = pnstrdup(input, input_len);
+
+  /* Simple whitespace tokenization */
+  token = strtok_r(input_copy, delimiters, &saveptr);
+  while (token != NULL) {
+    /* Resize array if needed */
+    if (count >= capacity && (max_tokens <= 0 || count < max_tokens)) {
+      capacity *= 2;
+      if (max_tokens > 0 && capacity > max_tokens)
+        capacity = max_tokens;
+      tokens = (TokenInfo *)repalloc(tokens, capacity * sizeof(TokenInfo));
+    }
+
+    /* Clean up token (remove extra punctuation) */
+    char *clean_token;
+    int len;
+
+    clean_token = pstrdup(token);
+    len = strlen(clean_token);
+
+    /* Remove trailing punctuation except for meaningful ones */
+    while (len > 0 &&
+           (clean_token[len - 1] == ',' || clean_token[len - 1] == '.')) {
+      if (clean_token[len - 1] == '.' && len > 1 &&
+          (strcmp(clean_token, "Jr.") == 0 || strcmp(clean_token, "Sr.") == 0 ||
+           strcmp(clean_token, "Dr.") == 0 || strcmp(clean_token, "Mr.") == 0 ||
+           strcmp(clean_token, "Ms.") == 0 ||
+           strcmp(clean_token, "Inc.") == 0 ||
+           strcmp(clean_token, "Corp.") == 0 ||
+           strcmp(clean_token, "Co.") == 0 ||
+           strcmp(clean_token, "Ltd.") == 0 ||
+           strcmp(clean_token, "Esq.") == 0 ||
+           strcmp(clean_token, "Mrs.") == 0)) {
+        break; /* Keep meaningful dots */
+      }
+      clean_token[len - 1] = '\0';
+      len--;
+    }
+
+    if (len > 0 && max_tokens > 0 && count == max_tokens) {
+      pfree(clean_token);
+      *truncated = true;
+      break;
+    }
+    if (len > 0) { /* Only add non-empty tokens */
+      tokens[count].text = clean_token;
+      tokens[count].position = count;
+      tokens[count].start_char = 0; /* Simplified for now */
+      tokens[count].end_char = len;
+      tokens[count].is_first = (count == 0);
+      tokens[count].is_last = false; /* Will be set later */
+      count++;
+    } else {
+      pfree(clean_token);
+    }
+
+    token = strtok_r(NULL, delimiters, &saveptr);
+  }
+
+  /* Set last token flag */
+  if (count > 0) {
+    tokens[count - 1].is_last = true;
+  }
+
+  pfree(input_copy);
+  *num_tokens = count;
+  return tokens;
+}
+
+/*
+ * Free token info array
+ */
+void free_token_info_array(TokenInfo *tokens, int num_tokens) {
+  if (tokens == NULL)
+    return;
+
+  for (int i = 0; i < num_tokens; i++) {
+    if (tokens[i].text != NULL) {
+      pfree(tokens[i].text);
+    }
+  }
+  pfree(tokens);
+}
@@ -0,0 +1,20 @@
+/* src/name_tokenizer.h */
+#ifndef NAME_TOKENIZER_H
+#define NAME_TOKENIZER_H
+
+#include "feature_extractor.h"
+
+/*
+ * Split a name string into tokens. Only palloc and friends are used, so the
+ * tokenizer also builds outside the server against a palloc shim.
+ *
+ * At most max_bytes of the input are read, cut back to the last whitespace
+ * when possible, and at most max_tokens tokens are returned; zero means no
+ * limit. *truncated tells whether either limit cut something off.
+ */
+TokenInfo *tokenize_name_string(const char *input, int max_bytes,
+                                int max_tokens, int *num_tokens,
+                                bool *truncated);
+void free_token_info_array(TokenInfo *tokens, int num_tokens);
+
+#endif /* NAME_TOKENIZER_H */
@@ -0,0 +1,65 @@
+/* src/parser_probes.h */
+#ifndef PARSER_PROBES_H
+#define PARSER_PROBES_H
+
+/*
+ * Static tracepoints on the parsing path, for bpftrace or perf
+ *
+ * Built with make SDT_PROBES=1, each probe is a nop instruction plus a note
+ * in the shared object naming it and its arguments; an attached tracer
+ * turns the nop into a trap. Without the flag the macros expand to nothing
+ * and their arguments, including the extra clock reads for elapsed times,
+ * are never evaluated. Times are in nanoseconds. The provider is
+ * pg_probablepeople:
+ *
+ *   parse__start(input)                      char *
+ *   tokenize__done(num_tokens, ns)
+ *   features__done(num_tokens, num_attributes, ns)
+ *   viterbi__start(num_items, num_labels)
+ *   viterbi__done(num_items, ns)
+ *   parse__done(num_tokens, ns)              num_tokens is 0 on failure
+ *   model__load__start(filename, model_type, reload)
+ *   model__load__done(model_type, ret, ns)   ret is a CRFErrorCode
+ */
+
+#ifdef USE_SDT_PROBES
+
+#include <sys/sdt.h>
+
+#define PARSER_PROBES_ENABLED true
+
+#define PARSER_PROBE_PARSE_START(input)                                        \
+  DTRACE_PROBE1(pg_probablepeople, parse__start, input)
+#define PARSER_PROBE_TOKENIZE_DONE(num_tokens, ns)                             \
+  DTRACE_PROBE2(pg_probablepeople, tokenize__done, num_tokens, ns)
+#define PARSER_PROBE_FEATURES_DONE(num_tokens, num_attributes, ns)             \
+  DTRACE_PROBE3(pg_probablepeople, features__done, num_tokens,                 \
+                num_attributes, ns)
+#define PARSER_PROBE_VITERBI_START(num_items, num_labels)                      \
+  DTRACE_PROBE2(pg_probablepeople, viterbi__start, num_items, num_labels)
+#define PARSER_PROBE_VITERBI_DONE(num_items, ns)                               \
+  DTRACE_PROBE2(pg_probablepeople, viterbi__done, num_items, ns)
+#define PARSER_PROBE_PARSE_DONE(num_tokens, ns)                                \
+  DTRACE_PROBE2(pg_probablepeople, parse__done, num_tokens, ns)
+#define PARSER_PROBE_MODEL_LOAD_START(filename, model_type, reload)            \
+  DTRACE_PROBE3(pg_probablepeople, model__load__start, filename, model_type,   \
+                reload)
+#define PARSER_PROBE_MODEL_LOAD_DONE(model_type, ret, ns)                      \
+  DTRACE_PROBE3(pg_probablepeople, model__load__done, model_type, ret, ns)
+
+#else
+
+#define PARSER_PROBES_ENABLED false
+
+#define PARSER_PROBE_PARSE_START(input) ((void)0)
+#define PARSER_PROBE_TOKENIZE_DONE(num_tokens, ns) ((void)0)
+#define PARSER_PROBE_FEATURES_DONE(num_tokens, num_attributes, ns) ((void)0)
+#define PARSER_PROBE_VITERBI_START(num_items, num_labels) ((void)0)
+#define PARSER_PROBE_VITERBI_DONE(num_items, ns) ((void)0)
+#define PARSER_PROBE_PARSE_DONE(num_tokens, ns) ((void)0)
+#define PARSER_PROBE_MODEL_LOAD_START(filename, model_type, reload) ((void)0)
+#define PARSER_PROBE_MODEL_LOAD_DONE(model_type, ret, ns) ((void)0)
+
+#endif /* USE_SDT_PROBES */
+
+#endif /* PARSER_PROBES_H */
@@ -0,0 +1,149 @@
+/* src/parser_stats.c */
+#include "postgres.h"
+/* Postgres headers must come first */
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/timestamp.h"
+
+#include "parser_stats.h"
+
+/*
+ * The counters are atomics rather than fields under an LWLock, so counting
+ * a call never waits for another backend. A snapshot taken while other
+ * backends count may therefore mix values from slightly different moments.
+ */
+typedef struct {
+  pg_atomic_uint64 calls[NUM_STATS_FUNCTIONS];
+  pg_atomic_uint64 time_us[NUM_STATS_FUNCTIONS];
+  pg_atomic_uint64 max_time_us[NUM_STATS_FUNCTIONS];
+  pg_atomic_uint64 tokens;
+  pg_atomic_uint64 feature_lookups;
+  pg_atomic_uint64 feature_misses;
+  pg_atomic_uint64 model_cache_hits;
+  pg_atomic_uint64 model_loads;
+  pg_atomic_uint64 model_load_time_us;
+  pg_atomic_uint64 stats_reset; /* TimestampTz */
+} ParserStats;
+
+/* Shared counters, or local_stats when not preloaded (and in the
+ * postmaster until shared memory exists) */
+static ParserStats *stats = NULL;
+static ParserStats local_stats;
+static bool stats_shared = false;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void stats_clear(ParserStats *s, bool init) {
+  pg_atomic_uint64 *counters = (pg_atomic_uint64 *)s;
+  int n = sizeof(ParserStats) / sizeof(pg_atomic_uint64);
+
+  for (int i = 0; i < n; i++) {
+    if (init)
+      pg_atomic_init_u64(&counters[i], 0);
+    else
+      pg_atomic_write_u64(&counters[i], 0);
+  }
+  pg_atomic_write_u64(&s->stats_reset, (uint64)GetCurrentTimestamp());
+}
+
+#if PG_VERSION_NUM >= 150000
+static void stats_shmem_request(void) {
+  if (prev_shmem_request_hook)
+    prev_shmem_request_hook();
+  RequestAddinShmemSpace(MAXALIGN(sizeof(ParserStats)));
+}
+#endif
+
+static void stats_shmem_startup(void) {
+  bool found;
+
+  if (prev_shmem_startup_hook)
+    prev_shmem_startup_hook();
+
+  LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+  stats = ShmemInitStruct("pg_probablepeople stats", sizeof(ParserStats),
+                          &found);
+  if (!found)
+    stats_clear(stats, true);
+  LWLockRelease(AddinShmemInitLock);
+  stats_shared = true;
+}
+
+void parser_stats_init(void) {
+  stats_clear(&local_stats, true);
+  stats = &local_stats;
+
+  /* Shared memory can only be requested while preloading */
+  if (!process_shared_preload_libraries_in_progress)
+    return;
+
+#if PG_VERSION_NUM >= 150000
+  prev_shmem_request_hook = shmem_request_hook;
+  shmem_request_hook = stats_shmem_request;
+#else
+  RequestAddinShmemSpace(MAXALIGN(sizeof(ParserStats)));
+#endif
+  prev_shmem_startup_hook = shmem_startup_hook;
+  shmem_startup_hook = stats_shmem_startup;
+}
+
+/* Raise *max to value unless it is already larger */
+static void atomic_max(pg_atomic_uint64 *max, uint64 value) {
+  uint64 current = pg_atomic_read_u64(max);
+
+  while (value > current) {
+    if (pg_atomic_compare_exchange_u64(max, &current, value))
+      break;
+  }
+}
+
+void parser_stats_count_call(ParserStatsFunction function,
+                             instr_time elapsed) {
+  uint64 us = INSTR_TIME_GET_MICROSEC(elapsed);
+
+  pg_atomic_fetch_add_u64(&stats->calls[function], 1);
+  pg_atomic_fetch_add_u64(&stats->time_us[function], us);
+  atomic_max(&stats->max_time_us[function], us);
+}
+
+void parser_stats_count_parse(int num_tokens, uint64 lookups, uint64 misses) {
+  pg_atomic_fetch_add_u64(&stats->tokens, num_tokens);
+  pg_atomic_fetch_add_u64(&stats->feature_lookups, lookups);
+  pg_atomic_fetch_add_u64(&stats->feature_misses, misses);
+}
+
+void parser_stats_count_model_cache_hit(void) {
+  pg_atomic_fetch_add_u64(&stats->model_cache_hits, 1);
+}
+
+void parser_stats_count_model_load(instr_time elapsed) {
+  pg_atomic_fetch_add_u64(&stats->model_loads, 1);
+  pg_atomic_fetch_add_u64(&stats->model_load_time_us,
+                          INSTR_TIME_GET_MICROSEC(elapsed));
+}
+
+void parser_stats_snapshot(ParserStatsSnapshot *snapshot) {
+  for (int f = 0; f < NUM_STATS_FUNCTIONS; f++) {
+    snapshot->calls[f] = pg_atomic_read_u64(&stats->calls[f]);
+    snapshot->time_us[f] = pg_atomic_read_u64(&stats->time_us[f]);
+    snapshot->max_time_us[f] = pg_atomic_read_u64(&stats->max_time_us[f]);
+  }
+  snapshot->tokens = pg_atomic_read_u64(&stats->tokens);
+  snapshot->feature_lookups = pg_atomic_read_u64(&stats->feature_lookups);
+  snapshot->feature_misses = pg_atomic_read_u64(&stats->feature_misses);
+  snapshot->model_cache_hits = pg_atomic_read_u64(&stats->model_cache_hits);
+  snapshot->model_loads = pg_atomic_read_u64(&stats->model_loads);
+  snapshot->model_load_time_us =
+      pg_atomic_read_u64(&stats->model_load_time_us);
+  snapshot->stats_reset =
+      (TimestampTz)pg_atomic_read_u64(&stats->stats_reset);
+  snapshot->shared = stats_shared;
+}
+
+void parser_stats_reset(void) { stats_clear(stats, false); }
@@ -0,0 +1,72 @@
+/* src/parser_stats.h */
+#ifndef PARSER_STATS_H
+#define PARSER_STATS_H
+
+#include "postgres.h"
+
+#include "datatype/timestamp.h"
+#include "portability/instr_time.h"
+
+#include <time.h>
+
+/*
+ * Cumulative parser statistics (the pg_probablepeople_stats view)
+ *
+ * With pg_probablepeople in shared_preload_libraries the counters live in
+ * shared memory and cover every backend since the last reset. Otherwise
+ * each backend counts only its own calls.
+ */
+
+/* Monotonic clock in nanoseconds, for the stage times of
+ * parse_name_profile() */
+static inline int64 parser_clock_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* SQL functions whose calls are counted */
+typedef enum {
+  STATS_PARSE_NAME,
+  STATS_TAG_NAME,
+  STATS_PARSE_NAME_COLS,
+  NUM_STATS_FUNCTIONS
+} ParserStatsFunction;
+
+/* Values of all counters at one point in time */
+typedef struct {
+  uint64 calls[NUM_STATS_FUNCTIONS];
+  uint64 time_us[NUM_STATS_FUNCTIONS];     /* Total time of the calls */
+  uint64 max_time_us[NUM_STATS_FUNCTIONS]; /* Slowest call */
+  uint64 tokens;
+  uint64 feature_lookups;
+  uint64 feature_misses; /* Lookups of attributes not in the model */
+  uint64 model_cache_hits;
+  uint64 model_loads;
+  uint64 model_load_time_us;
+  TimestampTz stats_reset;
+  bool shared; /* Counters cover all backends */
+} ParserStatsSnapshot;
+
+/* Call from _PG_init to request and attach the shared counters */
+void parser_stats_init(void);
+
+/* Count one call of a SQL function that took elapsed */
+void parser_stats_count_call(ParserStatsFunction function,
+                             instr_time elapsed);
+
+/* Count a parsed name: its tokens and the attribute lookups done for it,
+ * of which misses were not in the model */
+void parser_stats_count_parse(int num_tokens, uint64 lookups, uint64 misses);
+
+/* Count a call that found its model already loaded in the backend */
+void parser_stats_count_model_cache_hit(void);
+
+/* Count a model load that took elapsed */
+void parser_stats_count_model_load(instr_time elapsed);
+
+void parser_stats_snapshot(ParserStatsSnapshot *snapshot);
+void parser_stats_reset(void);
+
+#endif /* PARSER_STATS_H */
@@ -4,24 +4,95 @@
 #include "access/htup_details.h"
 #include "fmgr.h"
 #include "funcapi.h"
+#include "lib/stringinfo.h"
 #include "miscadmin.h"
+#include "storage/fd.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
 #include "utils/jsonb.h"
+#include "utils/timestamp.h"
 
+#include "attribute_profile.h"
 #include "crfsuite_wrapper.h"
 #include "name_parser.h"
+#include "parser_stats.h"
 
 PG_MODULE_MAGIC;
 
 MemoryContext crf_memory_context = NULL;
 
+/* GUC: count attribute hits in create_crf_instance_from_tokens */
+bool crf_profile_attributes = false;
+
+/* GUCs: input limits, see parse_name_string() */
+int crf_max_input_bytes = 1024;
+int crf_max_tokens = 64;
+int crf_oversize_input = OVERSIZE_INPUT_TRUNCATE;
+
+static const struct config_enum_entry oversize_input_options[] = {
+    {"truncate", OVERSIZE_INPUT_TRUNCATE, false},
+    {"error", OVERSIZE_INPUT_ERROR, false},
+    {"null", OVERSIZE_INPUT_NULL, false},
+    {NULL, 0, false}};
+
+/* GUCs: slow-parse logging, see log_slow_parse() in name_parser.c */
+int crf_log_min_duration_us = -1;
+bool crf_log_input = false;
+
 void _PG_init(void);
 
 void _PG_init(void) {
+  /* Counters first, so that the model loads below are counted */
+  parser_stats_init();
+
   /* Initialize memory context for long-lived model data */
   crf_memory_context = AllocSetContextCreate(
       TopMemoryContext, "CRF Model Context", ALLOCSET_DEFAULT_SIZES);
 
+  DefineCustomBoolVariable(
+      "pg_probablepeople.profile_attributes",
+      "Count how often each model attribute fires.",
+      "Counts are kept per backend and per model; read them with "
+      "attribute_profile() or write them with dump_attribute_profile().",
+      &crf_profile_attributes, false, PGC_USERSET, 0, NULL, NULL, NULL);
+
+  DefineCustomIntVariable(
+      "pg_probablepeople.max_input_bytes",
+      "Longest input, in bytes, that a parse reads.",
+      "Longer inputs are handled as pg_probablepeople.oversize_input says. "
+      "Zero removes the limit.",
+      &crf_max_input_bytes, 1024, 0, INT_MAX, PGC_USERSET, GUC_UNIT_BYTE,
+      NULL, NULL, NULL);
+
+  DefineCustomIntVariable(
+      "pg_probablepeople.max_tokens",
+      "Most tokens that a parse tags.",
+      "Inputs with more tokens are handled as "
+      "pg_probablepeople.oversize_input says. Zero removes the limit.",
+      &crf_max_tokens, 64, 0, INT_MAX, PGC_USERSET, 0, NULL, NULL, NULL);
+
+  DefineCustomEnumVariable(
+      "pg_probablepeople.oversize_input",
+      "What to do with an input over max_input_bytes or max_tokens.",
+      "truncate parses the part within the limits, error raises an error "
+      "and null returns no result.",
+      &crf_oversize_input, OVERSIZE_INPUT_TRUNCATE, oversize_input_options,
+      PGC_USERSET, 0, NULL, NULL, NULL);
+
+  DefineCustomIntVariable(
+      "pg_probablepeople.log_min_duration_us",
+      "Log parses that take at least this many microseconds.",
+      "The message has the input length, token and feature counts and the "
+      "time of each stage. Zero logs every parse, -1 disables logging.",
+      &crf_log_min_duration_us, -1, -1, INT_MAX, PGC_SUSET, 0, NULL, NULL,
+      NULL);
+
+  DefineCustomBoolVariable(
+      "pg_probablepeople.log_input",
+      "Include the input text in slow-parse messages.",
+      "Off by default, since names are often personal data.",
+      &crf_log_input, false, PGC_SUSET, 0, NULL, NULL, NULL);
+
   /* Load default model on startup */
   if (load_default_model() != CRF_SUCCESS) {
     ereport(WARNING,
@@ -29,6 +100,36 @@ void _PG_init(void) {
   }
 }
 
+/*
+ * Get the model to parse with: the generic model, loading the defaults if
+ * it is not loaded yet, or the person model if the generic one is missing
+ */
+static CRFModel *get_parsing_model(void) {
+  CRFModel *model = get_active_model("generic");
+
+  if (model != NULL && model->is_loaded) {
+    parser_stats_count_model_cache_hit();
+    return model;
+  }
+  if (load_default_model() != CRF_SUCCESS)
+    ereport(ERROR, (errmsg("CRF model is not loaded")));
+  model = get_active_model("generic");
+
+  /* Fallback to person model if generic is still not available */
+  if (model == NULL || !model->is_loaded)
+    model = get_active_model("person");
+  return model;
+}
+
+/* Count a call of a SQL function that started at start */
+static void count_call(ParserStatsFunction function, instr_time start) {
+  instr_time elapsed;
+
+  INSTR_TIME_SET_CURRENT(elapsed);
+  INSTR_TIME_SUBTRACT(elapsed, start);
+  parser_stats_count_call(function, elapsed);
+}
+
 /* User context for SRF */
 typedef struct {
   ParseResult *parsed;
@@ -48,6 +149,7 @@ Datum parse_name_crf(PG_FUNCTION_ARGS) {
     CRFModel *model;
     ParseResult *result;
     TupleDesc tupdesc;
+    instr_time start;
 
     funcctx = SRF_FIRSTCALL_INIT();
     oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
@@ -57,30 +159,19 @@ Datum parse_name_crf(PG_FUNCTION_ARGS) {
       MemoryContextSwitchTo(oldcontext);
       SRF_RETURN_DONE(funcctx);
     }
+    INSTR_TIME_SET_CURRENT(start);
     input_text = PG_GETARG_TEXT_PP(0);
     input_str = text_to_cstring(input_text);
 
     /* Get the generic model - directly use it for all name parsing */
-    model = get_active_model("generic");
-    if (model == NULL || !model->is_loaded) {
-      if (load_default_model() != CRF_SUCCESS) {
-        pfree(input_str);
-        MemoryContextSwitchTo(oldcontext);
-        ereport(ERROR, (errmsg("CRF model is not loaded")));
-      }
-      model = get_active_model("generic");
-    }
-
-    /* Fallback to person model if generic is still not available */
-    if (model == NULL || !model->is_loaded) {
-      model = get_active_model("person");
-    }
+    model = get_parsing_model();
 
     /* Parse name using specific model */
     /* Note: parse_name_string allocates result in current context
      * (multi_call_ctx) */
-    result = parse_name_string(input_str, model);
+    result = parse_name_string(input_str, model, NULL);
     pfree(input_str);
+    count_call(STATS_PARSE_NAME, start);
 
     if (result != NULL) {
       userctx = (NameParserContext *)palloc(sizeof(NameParserContext));
@@ -138,41 +229,33 @@ Datum tag_name_crf(PG_FUNCTION_ARGS) {
   ParseResult *result;
   JsonbValue *jbv;
   Jsonb *jb;
+  instr_time start;
 
   if (PG_ARGISNULL(0))
     PG_RETURN_NULL();
 
+  INSTR_TIME_SET_CURRENT(start);
   input_text = PG_GETARG_TEXT_PP(0);
   input_str = text_to_cstring(input_text);
 
   /* Get the generic model - directly use it for all name parsing */
-  model = get_active_model("generic");
-  if (model == NULL || !model->is_loaded) {
-    if (load_default_model() != CRF_SUCCESS) {
-      pfree(input_str);
-      ereport(ERROR, (errmsg("CRF model is not loaded")));
-    }
-    model = get_active_model("generic");
-  }
-
-  /* Fallback to person model if generic is still not available */
-  if (model == NULL || !model->is_loaded) {
-    model = get_active_model("person");
-  }
+  model = get_parsing_model();
 
-  result = parse_name_string(input_str, model);
+  result = parse_name_string(input_str, model, NULL);
   pfree(input_str);
 
-  if (result == NULL)
+  if (result == NULL) {
+    count_call(STATS_TAG_NAME, start);
     PG_RETURN_NULL();
+  }
 
   jbv = parse_result_to_jsonb(result);
+  jb = jbv != NULL ? JsonbValueToJsonb(jbv) : NULL;
+  count_call(STATS_TAG_NAME, start);
 
-  if (jbv == NULL)
+  if (jb == NULL)
     PG_RETURN_NULL();
 
-  jb = JsonbValueToJsonb(jbv);
-
   PG_RETURN_JSONB_P(jb);
 }
 
@@ -187,34 +270,26 @@ Datum parse_name_cols(PG_FUNCTION_ARGS) {
   Datum values[10];
   bool nulls[10];
   HeapTuple tuple;
+  instr_time start;
   int i;
 
   if (PG_ARGISNULL(0))
     PG_RETURN_NULL();
 
+  INSTR_TIME_SET_CURRENT(start);
   input_text = PG_GETARG_TEXT_PP(0);
   input_str = text_to_cstring(input_text);
 
   /* Get the generic model - directly use it for all name parsing */
-  model = get_active_model("generic");
-  if (model == NULL || !model->is_loaded) {
-    if (load_default_model() != CRF_SUCCESS) {
-      pfree(input_str);
-      ereport(ERROR, (errmsg("CRF model is not loaded")));
-    }
-    model = get_active_model("generic");
-  }
-
-  /* Fallback to person model if generic is still not available */
-  if (model == NULL || !model->is_loaded) {
-    model = get_active_model("person");
-  }
+  model = get_parsing_model();
 
-  result = parse_name_string(input_str, model);
+  result = parse_name_string(input_str, model, NULL);
   pfree(input_str);
 
-  if (result == NULL)
+  if (result == NULL) {
+    count_call(STATS_PARSE_NAME_COLS, start);
     PG_RETURN_NULL();
+  }
 
   cols = parse_name_to_cols(result);
 
@@ -277,5 +352,378 @@ Datum parse_name_cols(PG_FUNCTION_ARGS) {
   free_parsed_name_cols(cols);
   /* result is freed by context cleanup */
 
+  count_call(STATS_PARSE_NAME_COLS, start);
   PG_RETURN_DATUM(HeapTupleGetDatum(tuple));
 }
+
+/* Rows of parse_name_profile(), built on the first call */
+#define NUM_PROFILE_STAGES 7
+
+typedef struct {
+  const char *stages[NUM_PROFILE_STAGES];
+  int64 time_ns[NUM_PROFILE_STAGES];
+  int64 operations[NUM_PROFILE_STAGES];
+  bool operations_null[NUM_PROFILE_STAGES];
+  char *details[NUM_PROFILE_STAGES];
+  int num_stages;
+  int current_idx;
+} ParseProfileContext;
+
+static void add_profile_stage(ParseProfileContext *ctx, const char *stage,
+                              int64 time_ns, int64 operations,
+                              bool operations_null, char *detail) {
+  int i = ctx->num_stages++;
+
+  ctx->stages[i] = stage;
+  ctx->time_ns[i] = time_ns;
+  ctx->operations[i] = operations;
+  ctx->operations_null[i] = operations_null;
+  ctx->details[i] = detail;
+}
+
+PG_FUNCTION_INFO_V1(parse_name_profile);
+Datum parse_name_profile(PG_FUNCTION_ARGS) {
+  FuncCallContext *funcctx;
+  ParseProfileContext *userctx;
+
+  if (SRF_IS_FIRSTCALL()) {
+    MemoryContext oldcontext;
+    char *input_str;
+    CRFModel *model;
+    ParseResult *result;
+    ParseProfile profile;
+    TupleDesc tupdesc;
+
+    funcctx = SRF_FIRSTCALL_INIT();
+    oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+    if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+      ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                      errmsg("function returning record called in context "
+                             "that cannot accept type record")));
+    funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+    input_str = text_to_cstring(PG_GETARG_TEXT_PP(0));
+    model = get_parsing_model();
+    memset(&profile, 0, sizeof(profile));
+    result = parse_name_string(input_str, model, &profile);
+
+    userctx = (ParseProfileContext *)palloc0(sizeof(ParseProfileContext));
+    if (result != NULL) {
+      FeatureLookupStats *features = &profile.features;
+      PredictProfile *predict = &profile.predict;
+      StringInfoData per_token;
+
+      /* Attribute strings generated for each token */
+      initStringInfo(&per_token);
+      for (int i = 0; i < result->num_tokens; i++)
+        appendStringInfo(&per_token, "%s%s: %d", i > 0 ? ", " : "",
+                         result->tokens[i].text,
+                         features->features_per_token[i]);
+
+      add_profile_stage(userctx, "tokenize", profile.tokenize_ns,
+                        result->num_tokens, false, pstrdup("tokens"));
+      add_profile_stage(userctx, "features", features->extract_ns,
+                        features->lookups, false, per_token.data);
+      add_profile_stage(
+          userctx, "lookup", features->lookup_ns, features->lookups, false,
+          psprintf(UINT64_FORMAT " hits, " UINT64_FORMAT " misses",
+                   features->lookups - features->misses, features->misses));
+      add_profile_stage(userctx, "score", predict->score_ns,
+                        predict->state_ops, false,
+                        pstrdup("state multiply-adds"));
+      add_profile_stage(userctx, "viterbi", predict->viterbi_ns,
+                        predict->transition_ops, false,
+                        pstrdup("transition additions"));
+      add_profile_stage(userctx, "result", profile.result_ns,
+                        result->num_tokens, false, pstrdup("labels mapped"));
+      add_profile_stage(userctx, "total", result->processing_time_ns, 0, true,
+                        NULL);
+    }
+    pfree(input_str);
+    funcctx->user_fctx = userctx;
+
+    MemoryContextSwitchTo(oldcontext);
+  }
+
+  funcctx = SRF_PERCALL_SETUP();
+  userctx = (ParseProfileContext *)funcctx->user_fctx;
+
+  if (userctx->current_idx < userctx->num_stages) {
+    int i = userctx->current_idx++;
+    Datum values[4];
+    bool nulls[4] = {false, false, false, false};
+    HeapTuple tuple;
+
+    values[0] = CStringGetTextDatum(userctx->stages[i]);
+    values[1] = Int64GetDatum(userctx->time_ns[i]);
+    values[2] = Int64GetDatum(userctx->operations[i]);
+    nulls[2] = userctx->operations_null[i];
+    if (userctx->details[i] != NULL)
+      values[3] = CStringGetTextDatum(userctx->details[i]);
+    else
+      nulls[3] = true;
+
+    tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+    SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+  }
+  SRF_RETURN_DONE(funcctx);
+}
+
+/* Look up a loaded model by type for the profiling functions */
+static CRFModel *get_profiled_model(text *model_type) {
+  char *type = text_to_cstring(model_type);
+  CRFModel *model;
+
+  if (strcmp(type, "person") != 0 && strcmp(type, "company") != 0 &&
+      strcmp(type, "generic") != 0)
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("unknown model type \"%s\"", type),
+                    errhint("Use person, company or generic.")));
+
+  model = get_active_model(type);
+  if (model == NULL || !model->is_loaded)
+    ereport(ERROR, (errmsg("CRF model \"%s\" is not loaded", type)));
+
+  pfree(type);
+  return model;
+}
+
+/* Snapshot of the attributes that fired, for the attribute_profile SRF */
+typedef struct {
+  int *aids;
+  char **attributes;
+  uint64 *hits;
+  int num_entries;
+  int current_idx;
+} AttributeProfileContext;
+
+PG_FUNCTION_INFO_V1(attribute_profile);
+Datum attribute_profile(PG_FUNCTION_ARGS) {
+  FuncCallContext *funcctx;
+  AttributeProfileContext *userctx;
+
+  if (SRF_IS_FIRSTCALL()) {
+    MemoryContext oldcontext;
+    CRFModel *model;
+    TupleDesc tupdesc;
+
+    funcctx = SRF_FIRSTCALL_INIT();
+    oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+    model = get_profiled_model(PG_GETARG_TEXT_PP(0));
+
+    if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+      ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                      errmsg("function returning record called in context "
+                             "that cannot accept type record")));
+    funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+    /* Copy the counts so that the result is consistent across calls */
+    userctx = (AttributeProfileContext *)palloc0(
+        sizeof(AttributeProfileContext));
+    if (model->attr_hits != NULL) {
+      userctx->aids = (int *)palloc(model->num_attrs * sizeof(int));
+      userctx->attributes = (char **)palloc(model->num_attrs * sizeof(char *));
+      userctx->hits = (uint64 *)palloc(model->num_attrs * sizeof(uint64));
+
+      for (int aid = 0; aid < model->num_attrs; aid++) {
+        const char *str = NULL;
+        int n = userctx->num_entries;
+
+        if (model->attr_hits[aid] == 0)
+          continue;
+        model->attrs->to_string(model->attrs, aid, &str);
+        userctx->aids[n] = aid;
+        userctx->attributes[n] = str ? pstrdup(str) : NULL;
+        userctx->hits[n] = model->attr_hits[aid];
+        model->attrs->free(model->attrs, str);
+        userctx->num_entries++;
+      }
+    }
+    funcctx->user_fctx = userctx;
+
+    MemoryContextSwitchTo(oldcontext);
+  }
+
+  funcctx = SRF_PERCALL_SETUP();
+  userctx = (AttributeProfileContext *)funcctx->user_fctx;
+
+  if (userctx->current_idx < userctx->num_entries) {
+    int i = userctx->current_idx++;
+    Datum values[3];
+    bool nulls[3] = {false, false, false};
+    HeapTuple tuple;
+
+    values[0] = Int32GetDatum(userctx->aids[i]);
+    if (userctx->attributes[i] != NULL)
+      values[1] = CStringGetTextDatum(userctx->attributes[i]);
+    else
+      nulls[1] = true; /* Hashed models store no attribute strings */
+    values[2] = Int64GetDatum((int64)userctx->hits[i]);
+
+    tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+    SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+  }
+  SRF_RETURN_DONE(funcctx);
+}
+
+PG_FUNCTION_INFO_V1(dump_attribute_profile);
+Datum dump_attribute_profile(PG_FUNCTION_ARGS) {
+  char *filename = text_to_cstring(PG_GETARG_TEXT_PP(0));
+  char *model_type = text_to_cstring(PG_GETARG_TEXT_PP(1));
+  CRFModel *model = get_profiled_model(PG_GETARG_TEXT_PP(1));
+  FILE *fp;
+  int64 written = 0;
+
+  fp = AllocateFile(filename, "w");
+  if (fp == NULL)
+    ereport(ERROR, (errcode_for_file_access(),
+                    errmsg("could not open file \"%s\" for writing: %m",
+                           filename)));
+
+  /* Format documented in attribute_profile.h */
+  fprintf(fp, "%s\n", ATTRIBUTE_PROFILE_MAGIC);
+  fprintf(fp, "# model: %s\n", model_type);
+  fprintf(fp, "# tokens: " UINT64_FORMAT "\n", model->profiled_tokens);
+
+  for (int aid = 0; model->attr_hits != NULL && aid < model->num_attrs;
+       aid++) {
+    const char *str = NULL;
+
+    if (model->attr_hits[aid] == 0)
+      continue;
+    model->attrs->to_string(model->attrs, aid, &str);
+    fprintf(fp, UINT64_FORMAT "\t%d\t%s\n", model->attr_hits[aid], aid,
+            str ? str : "");
+    model->attrs->free(model->attrs, str);
+    written++;
+  }
+
+  if (FreeFile(fp) != 0)
+    ereport(ERROR, (errcode_for_file_access(),
+                    errmsg("could not write file \"%s\": %m", filename)));
+
+  pfree(model_type);
+  pfree(filename);
+  PG_RETURN_INT64(written);
+}
+
+PG_FUNCTION_INFO_V1(reset_attribute_profile);
+Datum reset_attribute_profile(PG_FUNCTION_ARGS) {
+  reset_attribute_hits(get_active_model("person"));
+  reset_attribute_hits(get_active_model("company"));
+  reset_attribute_hits(get_active_model("generic"));
+  PG_RETURN_VOID();
+}
+
+PG_FUNCTION_INFO_V1(pg_probablepeople_stats);
+Datum pg_probablepeople_stats(PG_FUNCTION_ARGS) {
+  ParserStatsSnapshot snapshot;
+  TupleDesc tupdesc;
+  Datum values[17];
+  bool nulls[17] = {false};
+  int i = 0;
+
+  if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+    ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                    errmsg("function returning record called in context "
+                           "that cannot accept type record")));
+  tupdesc = BlessTupleDesc(tupdesc);
+
+  parser_stats_snapshot(&snapshot);
+
+  /* Calls, total and maximum milliseconds of each function */
+  for (int f = 0; f < NUM_STATS_FUNCTIONS; f++) {
+    values[i++] = Int64GetDatum((int64)snapshot.calls[f]);
+    values[i++] = Float8GetDatum(snapshot.time_us[f] / 1000.0);
+    values[i++] = Float8GetDatum(snapshot.max_time_us[f] / 1000.0);
+  }
+  values[i++] = Int64GetDatum((int64)snapshot.tokens);
+  values[i++] = Int64GetDatum((int64)snapshot.feature_lookups);
+  values[i++] = Int64GetDatum((int64)snapshot.feature_misses);
+  values[i++] = Int64GetDatum((int64)snapshot.model_cache_hits);
+  values[i++] = Int64GetDatum((int64)snapshot.model_loads);
+  values[i++] = Float8GetDatum(snapshot.model_load_time_us / 1000.0);
+  values[i++] = BoolGetDatum(snapshot.shared);
+  values[i++] = TimestampTzGetDatum(snapshot.stats_reset);
+  Assert(i == lengthof(values));
+
+  PG_RETURN_DATUM(
+      HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/* Rows of pg_probablepeople_memory(): the models, then the context */
+static const char *const memory_models[] = {"person", "company", "generic"};
+#define NUM_MEMORY_ROWS (lengthof(memory_models) + 1)
+
+typedef struct {
+  int next_row; /* Skips the models that are not loaded */
+} MemoryRowsContext;
+
+PG_FUNCTION_INFO_V1(pg_probablepeople_memory);
+Datum pg_probablepeople_memory(PG_FUNCTION_ARGS) {
+  FuncCallContext *funcctx;
+  MemoryRowsContext *userctx;
+  int32 num_tokens = PG_GETARG_INT32(0);
+
+  if (SRF_IS_FIRSTCALL()) {
+    MemoryContext oldcontext;
+    TupleDesc tupdesc;
+
+    if (num_tokens < 0)
+      ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                      errmsg("tokens must not be negative")));
+
+    funcctx = SRF_FIRSTCALL_INIT();
+    oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+    if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+      ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                      errmsg("function returning record called in context "
+                             "that cannot accept type record")));
+    funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+    funcctx->user_fctx = palloc0(sizeof(MemoryRowsContext));
+    MemoryContextSwitchTo(oldcontext);
+  }
+
+  funcctx = SRF_PERCALL_SETUP();
+  userctx = (MemoryRowsContext *)funcctx->user_fctx;
+
+  while (userctx->next_row < NUM_MEMORY_ROWS) {
+    int row = userctx->next_row++;
+    Datum values[8];
+    bool nulls[8] = {false};
+    CRFModelMemory mem;
+
+    if (row < lengthof(memory_models)) {
+      /* Skip the models this backend has not loaded */
+      if (!get_model_memory(memory_models[row], num_tokens, &mem))
+        continue;
+      values[0] = CStringGetTextDatum(memory_models[row]);
+      values[1] = Int64GetDatum((int64)mem.file_bytes);
+      values[2] = Int64GetDatum((int64)mem.buffer_bytes);
+      values[3] = Int64GetDatum((int64)mem.structure_bytes);
+      values[4] = Int64GetDatum((int64)mem.cqdb_bytes);
+      values[5] = Int64GetDatum((int64)mem.tagger_bytes);
+      values[6] = Int64GetDatum((int64)mem.cache_bytes);
+      values[7] = Int64GetDatum((int64)(mem.buffer_bytes + mem.structure_bytes +
+                                        mem.cqdb_bytes + mem.cache_bytes));
+    } else {
+      /* Everything palloc()ed for the models, including the caches */
+      values[0] = CStringGetTextDatum("crf_memory_context");
+      for (int i = 1; i < 7; i++)
+        nulls[i] = true;
+      values[7] = Int64GetDatum(
+          (int64)MemoryContextMemAllocated(crf_memory_context, true));
+    }
+    SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heap_form_tuple(
+                                 funcctx->tuple_desc, values, nulls)));
+  }
+  SRF_RETURN_DONE(funcctx);
+}
+
+PG_FUNCTION_INFO_V1(pg_probablepeople_stats_reset);
+Datum pg_probablepeople_stats_reset(PG_FUNCTION_ARGS) {
+  parser_stats_reset();
+  PG_RETURN_VOID();
+}
@@ -9,13 +9,82 @@
 /* Initial capacity for sequences array */
 #define INITIAL_CAPACITY 1000
 
-/* Helper function to allocate and copy string */
-static char *strdup_safe(const char *s) {
-  if (s == NULL)
-    return NULL;
-  char *copy = malloc(strlen(s) + 1);
-  if (copy)
-    strcpy(copy, s);
+/* Size of each read from the input file; the window only grows beyond this
+ * when a single <Name> element does not fit */
+#define READ_CHUNK_SIZE (1024 * 1024)
+
+/* Default size of an arena block */
+#define ARENA_BLOCK_SIZE (1024 * 1024)
+
+/* Number of distinct labels shared through interning */
+#define MAX_INTERNED_LABELS 256
+
+/* Streaming reader state */
+typedef struct {
+  FILE *fp;
+  char *buf;    /* Input window, always NUL-terminated at end */
+  size_t cap;   /* Usable size of buf, excluding the terminator */
+  size_t start; /* Offset of the first unconsumed byte */
+  size_t end;   /* Offset one past the last valid byte */
+  bool eof;
+  bool failed;
+
+  /* Tokens of the element being parsed, copied out once it is complete */
+  LabeledToken *scratch;
+  int scratch_capacity;
+
+  /* Labels repeat on every token, so each distinct one is stored once */
+  char *labels[MAX_INTERNED_LABELS];
+  int num_labels;
+} XmlReader;
+
+/* Allocate size bytes from the arena with the given alignment */
+static void *arena_alloc(TrainingData *data, size_t size, size_t align) {
+  ArenaBlock *block = data->arena;
+  size_t offset = 0;
+
+  if (block)
+    offset = (block->used + align - 1) & ~(align - 1);
+
+  if (!block || offset + size > block->size) {
+    size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+
+    block = malloc(sizeof(ArenaBlock) + block_size);
+    if (!block)
+      return NULL;
+    block->next = data->arena;
+    block->used = 0;
+    block->size = block_size;
+    data->arena = block;
+    data->arena_bytes += block_size;
+    offset = 0;
+  }
+
+  block->used = offset + size;
+  return block->data + offset;
+}
+
+/* Copy len bytes of s into the arena as a NUL-terminated string */
+static char *arena_strndup(TrainingData *data, const char *s, size_t len) {
+  char *copy = arena_alloc(data, len + 1, 1);
+  if (copy) {
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+  }
+  return copy;
+}
+
+/* Return the shared copy of a label, storing it on first use */
+static char *intern_label(XmlReader *reader, TrainingData *data,
+                          const char *label) {
+  for (int i = 0; i < reader->num_labels; i++) {
+    if (strcmp(reader->labels[i], label) == 0)
+      return reader->labels[i];
+  }
+
+  char *copy = arena_strndup(data, label, strlen(label));
+  if (copy && reader->num_labels < MAX_INTERNED_LABELS)
+    reader->labels[reader->num_labels++] = copy;
   return copy;
 }
 
@@ -59,48 +128,43 @@ static int extract_tag_name(const char *start, char *buf, size_t bufsize,
   return (i > 0) ? 0 : -1;
 }
 
-/* Extract text content between current position and next '<' */
-static char *extract_text_content(const char *start, const char **endptr) {
+/* Locate text content between current position and next '<', trimmed of
+ * surrounding whitespace. Returns the start of the text and its length. */
+static const char *extract_text_content(const char *start, const char **endptr,
+                                        size_t *len) {
   const char *p = start;
-  const char *text_start = p;
 
   /* Find end of text (next tag or end) */
   while (*p && *p != '<')
     p++;
+  *endptr = p;
 
-  if (p == text_start) {
-    *endptr = p;
-    return NULL;
-  }
+  /* Trim leading/trailing whitespace */
+  while (start < p && isspace((unsigned char)*start))
+    start++;
+  while (p > start && isspace((unsigned char)p[-1]))
+    p--;
 
-  /* Copy and trim whitespace */
-  size_t len = p - text_start;
-  char *text = malloc(len + 1);
-  if (!text) {
-    *endptr = p;
-    return NULL;
-  }
-  memcpy(text, text_start, len);
-  text[len] = '\0';
+  *len = p - start;
+  return start;
+}
 
-  /* Trim leading/trailing whitespace */
-  char *trimmed = text;
-  while (*trimmed && isspace((unsigned char)*trimmed))
-    trimmed++;
-
-  char *end = trimmed + strlen(trimmed) - 1;
-  while (end > trimmed && isspace((unsigned char)*end))
-    *end-- = '\0';
-
-  if (trimmed != text) {
-    char *result = strdup_safe(trimmed);
-    free(text);
-    *endptr = p;
-    return result;
-  }
+/* Find the end of the element whose content starts at s, i.e. the byte
+ * after the '>' of its closing </Name> tag. Returns NULL when the closing
+ * tag is not (yet) in the window. */
+static char *find_name_element_end(char *s) {
+  while ((s = strstr(s, "</Name")) != NULL) {
+    char c = s[6];
 
-  *endptr = p;
-  return text;
+    if (c == '>' || c == ' ') {
+      char *gt = strchr(s + 6, '>');
+      return gt ? gt + 1 : NULL;
+    }
+    if (c == '\0')
+      return NULL;
+    s += 6;
+  }
+  return NULL;
 }
 
 /* Add a sequence to the training data */
@@ -118,22 +182,36 @@ static int add_sequence(TrainingData *data, LabeledSequence *seq) {
   return 0;
 }
 
-/* Parse a single <Name>...</Name> element */
-static int parse_name_element(const char *start, const char **endptr,
-                              LabeledSequence *seq) {
+/* Append a token to the reader's scratch array */
+static int add_scratch_token(XmlReader *reader, int num_tokens,
+                             LabeledToken *token) {
+  if (num_tokens >= reader->scratch_capacity) {
+    int new_capacity =
+        reader->scratch_capacity ? reader->scratch_capacity * 2 : 32;
+    LabeledToken *new_tokens =
+        realloc(reader->scratch, new_capacity * sizeof(LabeledToken));
+    if (!new_tokens)
+      return -1;
+    reader->scratch = new_tokens;
+    reader->scratch_capacity = new_capacity;
+  }
+  reader->scratch[num_tokens] = *token;
+  return 0;
+}
+
+/* Parse a single <Name>...</Name> element held in a NUL-terminated window
+ * and add it to data. Returns 0 on success, -1 on allocation failure. */
+static int parse_name_element(XmlReader *reader, TrainingData *data,
+                              const char *start) {
   const char *p = start;
   char tag_name[64];
   bool is_closing;
-
-  seq->tokens = malloc(MAX_TOKENS_PER_NAME * sizeof(LabeledToken));
-  if (!seq->tokens)
-    return -1;
-  seq->num_tokens = 0;
+  int num_tokens = 0;
 
   /* Skip to content after <Name> */
   p = find_tag_end(p);
   if (!p)
-    return -1;
+    return 0;
 
   /* Parse tokens until </Name> */
   while (*p) {
@@ -144,24 +222,20 @@ static int parse_name_element(const char *start, const char **endptr,
       if (extract_tag_name(p, tag_name, sizeof(tag_name), &is_closing) == 0) {
         if (is_closing && strcmp(tag_name, "Name") == 0) {
           /* Found </Name>, done with this sequence */
-          p = find_tag_end(p);
-          *endptr = p;
-          return 0;
+          break;
         }
 
         if (!is_closing) {
           /* This is a label tag like <GivenName>, <Surname>, etc. */
-          char *label = strdup_safe(tag_name);
 
           /* Move past opening tag */
           p = find_tag_end(p);
-          if (!p) {
-            free(label);
-            return -1;
-          }
+          if (!p)
+            break;
 
           /* Extract text content */
-          char *text = extract_text_content(p, &p);
+          size_t text_len;
+          const char *text = extract_text_content(p, &p, &text_len);
 
           /* Skip closing tag */
           if (*p == '<') {
@@ -171,22 +245,27 @@ static int parse_name_element(const char *start, const char **endptr,
                     0 &&
                 closing) {
               p = find_tag_end(p);
+              if (!p)
+                break;
             }
           }
 
           /* Add token if we have text */
-          if (text && strlen(text) > 0 &&
-              seq->num_tokens < MAX_TOKENS_PER_NAME) {
-            seq->tokens[seq->num_tokens].text = text;
-            seq->tokens[seq->num_tokens].label = label;
-            seq->num_tokens++;
-          } else {
-            free(text);
-            free(label);
+          if (text_len > 0) {
+            LabeledToken token;
+
+            token.text = arena_strndup(data, text, text_len);
+            token.label = intern_label(reader, data, tag_name);
+            if (!token.text || !token.label ||
+                add_scratch_token(reader, num_tokens, &token) != 0)
+              return -1;
+            num_tokens++;
           }
         } else {
           /* Unexpected closing tag, skip */
           p = find_tag_end(p);
+          if (!p)
+            break;
         }
       } else {
         p++;
@@ -197,11 +276,62 @@ static int parse_name_element(const char *start, const char **endptr,
     }
   }
 
-  *endptr = p;
-  return 0;
+  if (num_tokens == 0)
+    return 0;
+
+  /* Move the tokens into an exactly sized array */
+  LabeledSequence seq;
+  seq.tokens = arena_alloc(data, num_tokens * sizeof(LabeledToken),
+                           sizeof(void *));
+  if (!seq.tokens)
+    return -1;
+  memcpy(seq.tokens, reader->scratch, num_tokens * sizeof(LabeledToken));
+  seq.num_tokens = num_tokens;
+
+  return add_sequence(data, &seq);
 }
 
-/* Parse entire XML file */
+/* Move unconsumed bytes to the front of the window and read more input.
+ * Returns false once nothing more can be read. */
+static bool reader_fill(XmlReader *reader, TrainingData *data) {
+  if (reader->eof || reader->failed)
+    return false;
+
+  if (reader->start > 0) {
+    memmove(reader->buf, reader->buf + reader->start,
+            reader->end - reader->start);
+    reader->end -= reader->start;
+    reader->start = 0;
+  }
+
+  if (reader->end == reader->cap) {
+    /* The pending element is larger than the window; grow it */
+    size_t new_cap = reader->cap * 2;
+    char *new_buf = realloc(reader->buf, new_cap + 1);
+    if (!new_buf) {
+      reader->failed = true;
+      return false;
+    }
+    reader->buf = new_buf;
+    reader->cap = new_cap;
+  }
+
+  size_t n =
+      fread(reader->buf + reader->end, 1, reader->cap - reader->end, reader->fp);
+  reader->end += n;
+  reader->buf[reader->end] = '\0';
+  data->input_bytes += n;
+
+  if (n == 0) {
+    if (ferror(reader->fp))
+      reader->failed = true;
+    reader->eof = true;
+    return false;
+  }
+  return true;
+}
+
+/* Parse XML file, streaming it through a fixed-size window */
 TrainingData *parse_training_file(const char *filename) {
   FILE *fp = fopen(filename, "r");
   if (!fp) {
@@ -209,78 +339,158 @@ TrainingData *parse_training_file(const char *filename) {
     return NULL;
   }
 
-  /* Read entire file into memory */
-  fseek(fp, 0, SEEK_END);
-  long file_size = ftell(fp);
-  fseek(fp, 0, SEEK_SET);
+  XmlReader reader;
+  memset(&reader, 0, sizeof(reader));
+  reader.fp = fp;
+  reader.cap = READ_CHUNK_SIZE;
+  reader.buf = malloc(reader.cap + 1);
 
-  char *content = malloc(file_size + 1);
-  if (!content) {
+  /* Allocate training data structure */
+  TrainingData *data = calloc(1, sizeof(TrainingData));
+  if (data)
+    data->sequences = malloc(INITIAL_CAPACITY * sizeof(LabeledSequence));
+
+  if (!reader.buf || !data || !data->sequences) {
+    fprintf(stderr, "Error: Out of memory\n");
+    free(reader.buf);
+    free_training_data(data);
     fclose(fp);
     return NULL;
   }
+  data->capacity = INITIAL_CAPACITY;
+  reader.buf[0] = '\0';
 
-  size_t read_size = fread(content, 1, file_size, fp);
-  content[read_size] = '\0';
+  char tag_name[64];
+  bool is_closing;
+
+  for (;;) {
+    char *p = reader.buf + reader.start;
+    char *limit = reader.buf + reader.end;
+
+    /* Everything outside of tags is ignored at the top level */
+    p = memchr(p, '<', limit - p);
+    if (!p) {
+      reader.start = reader.end;
+      if (!reader_fill(&reader, data))
+        break;
+      continue;
+    }
+    reader.start = p - reader.buf;
+
+    /* Make sure the whole tag is in the window */
+    char *tag_end = memchr(p, '>', limit - p);
+    if (!tag_end) {
+      if (reader_fill(&reader, data))
+        continue;
+      break;
+    }
+
+    if (extract_tag_name(p, tag_name, sizeof(tag_name), &is_closing) != 0) {
+      reader.start++;
+      continue;
+    }
+
+    if (is_closing || strcmp(tag_name, "Name") != 0) {
+      /* Skip other tags */
+      reader.start = tag_end + 1 - reader.buf;
+      continue;
+    }
+
+    /* Found <Name>; wait until the whole element is in the window */
+    char *element_end = find_name_element_end(tag_end + 1);
+    if (!element_end) {
+      if (reader_fill(&reader, data))
+        continue;
+      if (reader.failed)
+        break;
+      /* Unterminated element at end of input; the window may have moved */
+      p = reader.buf + reader.start;
+      element_end = reader.buf + reader.end;
+    }
+
+    char saved = *element_end;
+    *element_end = '\0';
+    if (parse_name_element(&reader, data, p) != 0)
+      reader.failed = true;
+    *element_end = saved;
+    reader.start = element_end - reader.buf;
+
+    if (reader.failed)
+      break;
+  }
+
+  if (reader.failed) {
+    fprintf(stderr, "Error: Failed to read %s\n", filename);
+    free_training_data(data);
+    data = NULL;
+  }
+
+  free(reader.scratch);
+  free(reader.buf);
   fclose(fp);
+  return data;
+}
 
-  /* Allocate training data structure */
-  TrainingData *data = malloc(sizeof(TrainingData));
-  if (!data) {
-    free(content);
-    return NULL;
+/* Parse and merge the labeled XML files */
+TrainingData *parse_training_files(char **files, int num_files) {
+  TrainingData *data = NULL;
+
+  for (int i = 0; i < num_files; i++) {
+    TrainingData *part = parse_training_file(files[i]);
+
+    if (!part) {
+      fprintf(stderr, "Error: Failed to parse %s\n", files[i]);
+      free_training_data(data);
+      return NULL;
+    }
+    if (!data) {
+      data = part;
+    } else if (merge_training_data(data, part) != 0) {
+      fprintf(stderr, "Error: Out of memory\n");
+      free_training_data(part);
+      free_training_data(data);
+      return NULL;
+    }
   }
+  return data;
+}
 
-  data->sequences = malloc(INITIAL_CAPACITY * sizeof(LabeledSequence));
-  if (!data->sequences) {
-    free(data);
-    free(content);
-    return NULL;
+/* Move all sequences of src into dst and free src */
+int merge_training_data(TrainingData *dst, TrainingData *src) {
+  int total = dst->num_sequences + src->num_sequences;
+
+  if (total > dst->capacity) {
+    LabeledSequence *new_seqs =
+        realloc(dst->sequences, total * sizeof(LabeledSequence));
+    if (!new_seqs)
+      return -1;
+    dst->sequences = new_seqs;
+    dst->capacity = total;
   }
-  data->num_sequences = 0;
-  data->capacity = INITIAL_CAPACITY;
 
-  /* Parse content */
-  const char *p = content;
-  char tag_name[64];
-  bool is_closing;
+  memcpy(dst->sequences + dst->num_sequences, src->sequences,
+         src->num_sequences * sizeof(LabeledSequence));
+  dst->num_sequences = total;
 
-  while (*p) {
-    p = skip_whitespace(p);
+  /* Hand the arena over, keeping dst's current block at the head */
+  if (src->arena) {
+    ArenaBlock *tail = src->arena;
+    while (tail->next)
+      tail = tail->next;
 
-    if (*p == '<') {
-      if (extract_tag_name(p, tag_name, sizeof(tag_name), &is_closing) == 0) {
-        if (!is_closing && strcmp(tag_name, "Name") == 0) {
-          /* Found <Name> element */
-          LabeledSequence seq;
-          memset(&seq, 0, sizeof(seq));
-
-          if (parse_name_element(p, &p, &seq) == 0 && seq.num_tokens > 0) {
-            add_sequence(data, &seq);
-          } else {
-            /* Free failed sequence */
-            for (int i = 0; i < seq.num_tokens; i++) {
-              free(seq.tokens[i].text);
-              free(seq.tokens[i].label);
-            }
-            free(seq.tokens);
-          }
-        } else {
-          /* Skip other tags */
-          p = find_tag_end(p);
-          if (!p)
-            break;
-        }
-      } else {
-        p++;
-      }
+    if (dst->arena) {
+      tail->next = dst->arena->next;
+      dst->arena->next = src->arena;
     } else {
-      p++;
+      dst->arena = src->arena;
     }
   }
+  dst->arena_bytes += src->arena_bytes;
+  dst->input_bytes += src->input_bytes;
 
-  free(content);
-  return data;
+  free(src->sequences);
+  free(src);
+  return 0;
 }
 
 /* Free training data */
@@ -288,13 +498,11 @@ void free_training_data(TrainingData *data) {
   if (!data)
     return;
 
-  for (int i = 0; i < data->num_sequences; i++) {
-    LabeledSequence *seq = &data->sequences[i];
-    for (int j = 0; j < seq->num_tokens; j++) {
-      free(seq->tokens[j].text);
-      free(seq->tokens[j].label);
-    }
-    free(seq->tokens);
+  ArenaBlock *block = data->arena;
+  while (block) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
   }
   free(data->sequences);
   free(data);
@@ -308,11 +516,16 @@ void print_training_summary(TrainingData *data) {
   printf("Training data summary:\n");
   printf("  Total sequences: %d\n", data->num_sequences);
 
-  int total_tokens = 0;
+  long total_tokens = 0;
+  int max_tokens = 0;
   for (int i = 0; i < data->num_sequences; i++) {
     total_tokens += data->sequences[i].num_tokens;
+    if (data->sequences[i].num_tokens > max_tokens)
+      max_tokens = data->sequences[i].num_tokens;
   }
-  printf("  Total tokens: %d\n", total_tokens);
+  printf("  Total tokens: %ld\n", total_tokens);
+  printf("  Longest sequence: %d tokens\n", max_tokens);
+  printf("  Arena memory: %zu bytes\n", data->arena_bytes);
 
   /* Print first few examples */
   printf("\nFirst 5 examples:\n");
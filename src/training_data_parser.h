@@ -3,9 +3,7 @@
 #define TRAINING_DATA_PARSER_H
 
 #include <stdbool.h>
-
-/* Maximum tokens per name sequence */
-#define MAX_TOKENS_PER_NAME 32
+#include <stddef.h>
 
 /* A single labeled token from training data */
 typedef struct {
@@ -19,16 +17,46 @@ typedef struct {
   int num_tokens;
 } LabeledSequence;
 
-/* Collection of training sequences */
+/* Block of arena memory backing token arrays and strings */
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t used;
+  size_t size;
+  char data[];
+} ArenaBlock;
+
+/* Collection of training sequences
+ *
+ * Token arrays and all strings are carved out of the arena, so a sequence
+ * must not be freed on its own; free_training_data releases everything.
+ */
 typedef struct {
   LabeledSequence *sequences;
   int num_sequences;
   int capacity;
+  ArenaBlock *arena;   /* Arena blocks, most recent first */
+  size_t arena_bytes;  /* Total bytes reserved by the arena */
+  size_t input_bytes;  /* Bytes of XML read to build this data */
 } TrainingData;
 
-/* Parse XML training file into TrainingData structure */
+/* Parse XML training file into TrainingData structure
+ *
+ * The file is read in fixed-size chunks, so memory use is bounded by the
+ * parsed data rather than the size of the export.
+ */
 TrainingData *parse_training_file(const char *filename);
 
+/* Move all sequences of src into dst and free src
+ * Returns 0 on success, -1 on allocation failure (src is left intact)
+ */
+int merge_training_data(TrainingData *dst, TrainingData *src);
+
+/* Parse several XML training files into one TrainingData
+ * Returns NULL, after printing an error, if a file can't be parsed or
+ * memory runs out.
+ */
+TrainingData *parse_training_files(char **files, int num_files);
+
 /* Free training data */
 void free_training_data(TrainingData *data);
 
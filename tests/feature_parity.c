@@ -0,0 +1,227 @@
+/* tests/feature_parity.c - Golden test of the shared feature extraction
+ *
+ * Runs labeled XML files through the trainer's conversion (build_crf_data)
+ * and, token by token, through extract_name_features as the extension calls
+ * it, and fails unless both give the same attribute strings and values in
+ * the same order. With -m, every attribute the extension would look up must
+ * also be in the given model, and extraction restricted to the templates the
+ * model has attributes for, as the extension does after loading it, must
+ * drop exactly the attributes of the other templates. With -n, the
+ * attributes of the first sequences are printed for comparison with
+ * tests/expected/name_features.out.
+ */
+#include "crf_trainer.h"
+#include "name_features.h"
+#include "training_data_parser.h"
+
+#include <crfsuite.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Mismatches reported in detail before the rest are only counted */
+#define MAX_REPORTED 10
+
+static void print_usage(const char *prog) {
+  printf("Usage: %s [options] <labeled.xml> [labeled.xml ...]\n", prog);
+  printf("\nOptions:\n");
+  printf("  -m, --model FILE  Also require every attribute to be in FILE\n");
+  printf("  -n, --print N     Print the attributes of the first N "
+         "sequences\n");
+  printf("  -h, --help        Show this help message\n");
+}
+
+/* Check that pruned holds the attributes of full whose template is in
+ * templates, in the same order; returns mismatches */
+static int compare_pruned(NameFeatureList *full, NameFeatureList *pruned,
+                          uint64_t templates, int seq, int pos) {
+  int k = 0;
+
+  for (int f = 0; f < full->num_features; f++) {
+    int t = name_feature_template(full->features[f].name);
+
+    if (t < 0 || !(templates & NAME_TEMPLATE_BIT(t)))
+      continue;
+    if (k >= pruned->num_features ||
+        strcmp(full->features[f].name, pruned->features[k].name) != 0 ||
+        full->features[f].value != pruned->features[k].value) {
+      fprintf(stderr, "Pruning mismatch: sequence %d token %d: %s\n", seq,
+              pos, full->features[f].name);
+      return 1;
+    }
+    k++;
+  }
+  return k == pruned->num_features ? 0 : 1;
+}
+
+/* Compare one token's attributes from both paths; returns mismatches */
+static int compare_token(crfsuite_dictionary_t *attrs, crfsuite_item_t *item,
+                         NameFeatureList *features, int seq, int pos,
+                         const char *token, int reported) {
+  int n = item->num_contents > features->num_features ? item->num_contents
+                                                      : features->num_features;
+
+  for (int k = 0; k < n; k++) {
+    const char *trained = NULL;
+    const char *served =
+        k < features->num_features ? features->features[k].name : "(none)";
+    double trained_value = 0, served_value = 0;
+    int same;
+
+    if (k < item->num_contents) {
+      attrs->to_string(attrs, item->contents[k].aid, &trained);
+      trained_value = item->contents[k].value;
+    }
+    if (k < features->num_features)
+      served_value = features->features[k].value;
+
+    same = trained && strcmp(trained, served) == 0 &&
+           trained_value == served_value;
+    if (!same && reported < MAX_REPORTED)
+      fprintf(stderr,
+              "Mismatch: sequence %d token %d (%s) attribute %d: trainer "
+              "%s=%g, extension %s=%g\n",
+              seq, pos, token, k, trained ? trained : "(none)", trained_value,
+              served, served_value);
+    if (trained)
+      attrs->free(attrs, trained);
+    if (!same)
+      return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  const char *model_file = NULL;
+  crfsuite_model_t *model = NULL;
+  crfsuite_dictionary_t *model_attrs = NULL;
+  TrainingData *data;
+  crfsuite_data_t crf_data;
+  NameFeatureList features, pruned;
+  uint64_t templates = NAME_TEMPLATES_ALL;
+  long long tokens = 0, lookups = 0, missing = 0;
+  int num_print = 0, mismatches = 0, ret = 1;
+
+  static struct option long_options[] = {{"model", required_argument, 0, 'm'},
+                                         {"print", required_argument, 0, 'n'},
+                                         {"help", no_argument, 0, 'h'},
+                                         {0, 0, 0, 0}};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "m:n:h", long_options, NULL)) != -1) {
+    switch (opt) {
+    case 'm':
+      model_file = optarg;
+      break;
+    case 'n':
+      num_print = atoi(optarg);
+      break;
+    case 'h':
+      print_usage(argv[0]);
+      return 0;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc - optind < 1) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (model_file) {
+    if (crfsuite_create_instance_from_file(model_file, (void **)&model) != 0) {
+      fprintf(stderr, "Error: Could not load model: %s\n", model_file);
+      return 1;
+    }
+    model->get_attrs(model, &model_attrs);
+    templates = name_model_templates(model_attrs);
+  }
+
+  data = parse_training_files(&argv[optind], argc - optind);
+  if (!data)
+    goto release;
+
+  /* The trainer's path, threaded conversion and ID remapping included */
+  memset(&crf_data, 0, sizeof(crf_data));
+  if (build_crf_data(data, &crf_data, 0) != 0) {
+    fprintf(stderr, "Error: Failed to convert training data\n");
+    goto cleanup;
+  }
+
+  for (int i = 0; i < data->num_sequences; i++) {
+    LabeledSequence *seq = &data->sequences[i];
+    crfsuite_instance_t *inst = &crf_data.instances[i];
+    const char **texts = malloc((seq->num_tokens > 0 ? seq->num_tokens : 1) *
+                                sizeof(const char *));
+
+    if (!texts) {
+      fprintf(stderr, "Error: Out of memory\n");
+      goto cleanup;
+    }
+    for (int j = 0; j < seq->num_tokens; j++)
+      texts[j] = seq->tokens[j].text;
+
+    /* The extension's path: the same token strings, one token at a time */
+    for (int j = 0; j < seq->num_tokens; j++) {
+      extract_name_features(texts, seq->num_tokens, j, NAME_TEMPLATES_ALL,
+                            &features);
+      tokens++;
+
+      if (j >= inst->num_items)
+        mismatches++;
+      else
+        mismatches += compare_token(crf_data.attrs, &inst->items[j],
+                                    &features, i, j, texts[j], mismatches);
+
+      if (model_attrs) {
+        extract_name_features(texts, seq->num_tokens, j, templates, &pruned);
+        mismatches += compare_pruned(&features, &pruned, templates, i, j);
+      }
+
+      for (int k = 0; k < features.num_features; k++) {
+        if (i < num_print)
+          printf("%d\t%d\t%s\t%s=%g\n", i, j, texts[j],
+                 features.features[k].name, features.features[k].value);
+        if (model_attrs) {
+          lookups++;
+          if (model_attrs->to_id(model_attrs, features.features[k].name) < 0) {
+            if (missing < MAX_REPORTED)
+              fprintf(stderr, "Missing from model: %s (sequence %d token %d)\n",
+                      features.features[k].name, i, j);
+            missing++;
+          }
+        }
+      }
+    }
+    if (inst->num_items != seq->num_tokens)
+      mismatches++;
+    free(texts);
+  }
+
+  fprintf(stderr, "%d sequences, %lld tokens: %d mismatched token%s",
+          data->num_sequences, tokens, mismatches, mismatches == 1 ? "" : "s");
+  if (model_attrs)
+    fprintf(stderr, ", %lld of %lld attributes missing from %s", missing,
+            lookups, model_file);
+  fprintf(stderr, "\n");
+  for (int t = 0; t < NUM_NAME_TEMPLATES; t++) {
+    if (!(templates & NAME_TEMPLATE_BIT(t)))
+      fprintf(stderr, "Template disabled for %s: %s\n", model_file,
+              name_template_name(t));
+  }
+  ret = mismatches == 0 && missing == 0 ? 0 : 1;
+
+cleanup:
+  free_crf_data(&crf_data);
+  free_training_data(data);
+release:
+  if (model_attrs)
+    model_attrs->release(model_attrs);
+  if (model)
+    model->release(model);
+  return ret;
+}
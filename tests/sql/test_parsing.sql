@@ -43,5 +43,50 @@ SELECT * FROM parse_name_cols('Mr. John Doe');
 SELECT * FROM parse_name_cols('Google Inc.');
 SELECT prefix, given_name, surname, suffix, corporation_name FROM parse_name_cols('Dr. Jane Smith PhD');
 
+-- Test 13: Attribute profiling
+SELECT count(*) FROM attribute_profile();
+SET pg_probablepeople.profile_attributes = on;
+SELECT count(*) FROM parse_name('John Doe');
+SELECT count(*) > 0 AS fired FROM attribute_profile();
+SELECT count(*) FROM attribute_profile() WHERE hits <= 0;
+SELECT reset_attribute_profile();
+SELECT count(*) FROM attribute_profile();
+RESET pg_probablepeople.profile_attributes;
+SELECT attribute_profile('address');
+
+-- Test 14: Parser statistics (per session unless preloaded)
+SELECT pg_probablepeople_stats_reset();
+SELECT count(*) FROM parse_name('John Doe');
+SELECT tag_name('Google Inc.') IS NOT NULL AS tagged;
+SELECT count(*) FROM parse_name_cols('Jane Smith');
+SELECT parse_name_calls, tag_name_calls, parse_name_cols_calls, tokens FROM pg_probablepeople_stats;
+SELECT feature_lookups > 0 AND feature_misses <= feature_lookups AS lookups_counted, model_cache_hits, model_loads FROM pg_probablepeople_stats;
+SELECT pg_probablepeople_stats_reset();
+SELECT parse_name_calls + tag_name_calls + parse_name_cols_calls AS calls FROM pg_probablepeople_stats;
+
+-- Test 15: Stage profile of one call
+SELECT stage, operations, detail FROM parse_name_profile('John Doe');
+SELECT sum(time_ns) FILTER (WHERE stage = 'total') >= sum(time_ns) FILTER (WHERE stage <> 'total') AS consistent FROM parse_name_profile('Mr. John Doe');
+
+-- Test 16: Memory of the loaded models
+SELECT model, file_bytes, buffer_bytes = file_bytes AS read_into_memory, cqdb_bytes > 0 AS has_cqdb, cache_bytes > 0 AS profiled, total_bytes > 0 AS allocated FROM pg_probablepeople_memory() ORDER BY model;
+SELECT (SELECT tagger_bytes FROM pg_probablepeople_memory(8) WHERE model = 'generic') > (SELECT tagger_bytes FROM pg_probablepeople_memory(2) WHERE model = 'generic') AS tagger_grows;
+
+-- Test 17: Input limits
+SELECT count(*) FROM parse_name(repeat('Smith ', 10000));
+SET pg_probablepeople.max_tokens = 2;
+SELECT count(*) FROM parse_name('Mr. John Quincy Doe');
+SET pg_probablepeople.oversize_input = 'null';
+SELECT tag_name('Mr. John Quincy Doe') IS NULL AS skipped;
+SELECT count(*) FROM parse_name('John Doe');
+SET pg_probablepeople.oversize_input = 'error';
+SELECT count(*) FROM parse_name('Mr. John Quincy Doe');
+RESET pg_probablepeople.max_tokens;
+SET pg_probablepeople.max_input_bytes = 8;
+SELECT count(*) FROM parse_name('Jonathan Doe');
+RESET pg_probablepeople.oversize_input;
+SELECT count(*) FROM parse_name('Jonathan Doe');
+RESET pg_probablepeople.max_input_bytes;
+
 -- Clean up
 DROP EXTENSION pg_probablepeople;
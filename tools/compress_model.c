@@ -0,0 +1,398 @@
+/* tools/compress_model.c - Prune small weights and compact a CRF model */
+#include "attribute_profile.h"
+#include "crf_cross_validation.h"
+#include "crf_trainer.h"
+#include "training_data_parser.h"
+
+#include <crfsuite.h>
+#include <crf1d.h>
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+/* Throughput is the best of this many passes over the evaluation data */
+#define EVAL_ROUNDS 3
+
+/* Accuracy and speed of one model on the evaluation data */
+typedef struct {
+  double item_accuracy;
+  double instance_accuracy;
+  double macro_f1;
+  double tokens_per_second;
+} EvalResult;
+
+static void print_usage(const char *prog) {
+  printf("Usage: %s [options] <input.crfsuite> <output.crfsuite> "
+         "[labeled.xml ...]\n",
+         prog);
+  printf("\nDrop state features whose weight is close to zero, remove the "
+         "attributes\nleft without features and renumber the rest, then "
+         "write the smaller model.\nIf labeled XML files are given, both "
+         "models are evaluated on them.\n");
+  printf("\nOptions:\n");
+  printf("  -w, --threshold W   Drop state features with |weight| < W "
+         "(default: 0.01)\n");
+  printf("  --profile FILE      Attribute profile from "
+         "dump_attribute_profile(); also\n"
+         "                      drop attributes that fired too rarely\n");
+  printf("  --min-hits N        Hits an attribute needs in the profile "
+         "(default: 1)\n");
+  printf("  -h, --help          Show this help message\n");
+}
+
+static long long file_size(const char *filename) {
+  struct stat st;
+  return stat(filename, &st) == 0 ? (long long)st.st_size : -1;
+}
+
+static double elapsed_seconds(struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Mark the attributes of model that fired fewer than min_hits times in
+ * profile; returns the number marked, or -1 on error */
+static int mark_cold_attributes(crf1dm_t *model, const AttributeProfile *profile,
+                                uint64_t min_hits, char *drop) {
+  const int A = crf1dm_get_num_attrs(model);
+  int num_cold = 0;
+
+  if (profile->hashed) {
+    fprintf(stderr, "Error: The profile was recorded with a hashed model and "
+                    "has no attribute strings\n");
+    return -1;
+  }
+  for (int a = 0; a < A; a++) {
+    drop[a] = attribute_profile_hits(profile, crf1dm_to_attr(model, a)) <
+              min_hits;
+    num_cold += drop[a];
+  }
+  return num_cold;
+}
+
+/* Write the features of model with |weight| >= threshold to filename,
+ * leaving out every state feature of the attributes marked in drop
+ *
+ * Transition features are always kept: there are at most L * L of them and
+ * they are scored once per token pair whatever their weight. Attributes are
+ * renumbered in the order their first surviving feature appears, as the
+ * trainer does when it saves a model. Labels keep their IDs, since removing
+ * one would change the label set Viterbi decodes over.
+ */
+static int compress_model(crf1dm_t *model, const char *filename,
+                          double threshold, const char *drop) {
+  const int K = crf1dm_get_num_features(model);
+  const int L = crf1dm_get_num_labels(model);
+  const int A = crf1dm_get_num_attrs(model);
+  int *fmap = malloc((K > 0 ? K : 1) * sizeof(int));
+  int *amap = malloc((A > 0 ? A : 1) * sizeof(int));
+  int *fids = malloc((K > 0 ? K : 1) * sizeof(int));
+  crf1dmw_t *writer = NULL;
+  int J = 0, B = 0, ret = -1;
+
+  if (!fmap || !amap || !fids) {
+    fprintf(stderr, "Error: Out of memory\n");
+    goto cleanup;
+  }
+  for (int a = 0; a < A; a++)
+    amap[a] = -1;
+
+  writer = crf1mmw(filename);
+  if (!writer) {
+    fprintf(stderr, "Error: Could not create %s\n", filename);
+    goto cleanup;
+  }
+
+  if (crf1dmw_open_features(writer) != 0)
+    goto cleanup;
+  for (int k = 0; k < K; k++) {
+    crf1dm_feature_t f;
+
+    fmap[k] = -1;
+    if (crf1dm_get_feature(model, k, &f) != 0)
+      goto cleanup;
+    if (f.type == FT_STATE) {
+      if (fabs(f.weight) < threshold || (drop && drop[f.src]))
+        continue;
+      if (amap[f.src] < 0)
+        amap[f.src] = B++;
+      f.src = amap[f.src];
+    }
+    fmap[k] = J++;
+    if (crf1dmw_put_feature(writer, fmap[k], &f) != 0)
+      goto cleanup;
+  }
+  if (crf1dmw_close_features(writer) != 0)
+    goto cleanup;
+
+  if (crf1dmw_open_labels(writer, L) != 0)
+    goto cleanup;
+  for (int l = 0; l < L; l++) {
+    if (crf1dmw_put_label(writer, l, crf1dm_to_label(model, l)) != 0)
+      goto cleanup;
+  }
+  if (crf1dmw_close_labels(writer) != 0)
+    goto cleanup;
+
+  if (crf1dmw_open_attrs(writer, B) != 0)
+    goto cleanup;
+  for (int a = 0; a < A; a++) {
+    if (amap[a] >= 0 &&
+        crf1dmw_put_attr(writer, amap[a], crf1dm_to_attr(model, a)) != 0)
+      goto cleanup;
+  }
+  if (crf1dmw_close_attrs(writer) != 0)
+    goto cleanup;
+
+  /* References are copied into fids because v1 models store them encoded;
+   * the writer drops the ones fmap marks as removed */
+  if (crf1dmw_open_labelrefs(writer, L + 2) != 0)
+    goto cleanup;
+  for (int l = 0; l < L; l++) {
+    feature_refs_t ref;
+
+    crf1dm_get_labelref(model, l, &ref);
+    for (int r = 0; r < ref.num_features; r++)
+      fids[r] = crf1dm_get_featureid(&ref, r);
+    ref.fids = fids;
+    if (crf1dmw_put_labelref(writer, l, &ref, fmap) != 0)
+      goto cleanup;
+  }
+  if (crf1dmw_close_labelrefs(writer) != 0)
+    goto cleanup;
+
+  if (crf1dmw_open_attrrefs(writer, B) != 0)
+    goto cleanup;
+  for (int a = 0; a < A; a++) {
+    feature_refs_t ref;
+
+    if (amap[a] < 0)
+      continue;
+    crf1dm_get_attrref(model, a, &ref);
+    for (int r = 0; r < ref.num_features; r++)
+      fids[r] = crf1dm_get_featureid(&ref, r);
+    ref.fids = fids;
+    if (crf1dmw_put_attrref(writer, amap[a], &ref, fmap) != 0)
+      goto cleanup;
+  }
+  if (crf1dmw_close_attrrefs(writer) != 0)
+    goto cleanup;
+
+  ret = 0;
+
+cleanup:
+  if (writer && crf1dmw_close(writer) != 0)
+    ret = -1;
+  if (ret != 0)
+    fprintf(stderr, "Error: Failed to write %s\n", filename);
+  free(fids);
+  free(amap);
+  free(fmap);
+  return ret;
+}
+
+/* Evaluate the model saved at model_file on crf_data */
+static int evaluate(crfsuite_data_t *crf_data, const char *model_file,
+                    EvalResult *result) {
+  int num_labels = crf_data->labels->num(crf_data->labels);
+  double best = 0;
+
+  for (int round = 0; round < EVAL_ROUNDS; round++) {
+    crfsuite_evaluation_t eval;
+    struct timespec start;
+    double seconds;
+
+    crfsuite_evaluation_init(&eval, num_labels);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (evaluate_crf_model(crf_data, -1, model_file, &eval) != 0) {
+      crfsuite_evaluation_finish(&eval);
+      fprintf(stderr, "Error: Could not evaluate %s\n", model_file);
+      return -1;
+    }
+    seconds = elapsed_seconds(&start);
+    crfsuite_evaluation_finalize(&eval);
+
+    result->item_accuracy = eval.item_accuracy;
+    result->instance_accuracy = eval.inst_accuracy;
+    result->macro_f1 = eval.macro_fmeasure;
+    if (round == 0 || seconds < best)
+      best = seconds;
+    result->tokens_per_second = best > 0 ? eval.item_total_num / best : 0;
+    crfsuite_evaluation_finish(&eval);
+  }
+  return 0;
+}
+
+static void print_model_row(const char *name, crf1dm_t *model,
+                            const char *filename) {
+  printf("%-8s %9d %10d %7d %12lld", name, crf1dm_get_num_features(model),
+         crf1dm_get_num_attrs(model), crf1dm_get_num_labels(model),
+         file_size(filename));
+}
+
+static void print_eval_columns(EvalResult *result) {
+  printf(" %9.4f %9.4f %9.4f %10.0f", result->item_accuracy,
+         result->instance_accuracy, result->macro_f1,
+         result->tokens_per_second);
+}
+
+int main(int argc, char *argv[]) {
+  double threshold = 0.01;
+  const char *profile_file = NULL;
+  uint64_t min_hits = 1;
+  AttributeProfile *profile = NULL;
+  char *drop = NULL;
+  const char *input_file, *output_file;
+  crf1dm_t *input = NULL, *output = NULL;
+  TrainingData *data = NULL;
+  crfsuite_data_t crf_data;
+  EvalResult before, after;
+  int evaluated = 0, ret = 1;
+
+  static struct option long_options[] = {
+      {"threshold", required_argument, 0, 'w'},
+      {"profile", required_argument, 0, 1001},
+      {"min-hits", required_argument, 0, 1002},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "w:h", long_options, NULL)) != -1) {
+    switch (opt) {
+    case 'w':
+      threshold = atof(optarg);
+      if (threshold < 0) {
+        fprintf(stderr, "Error: Threshold must not be negative\n");
+        return 1;
+      }
+      break;
+    case 1001:
+      profile_file = optarg;
+      break;
+    case 1002:
+      min_hits = strtoull(optarg, NULL, 10);
+      break;
+    case 'h':
+      print_usage(argv[0]);
+      return 0;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc - optind < 2) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  input_file = argv[optind];
+  output_file = argv[optind + 1];
+  if (strcmp(input_file, output_file) == 0) {
+    fprintf(stderr, "Error: Input and output must be different files\n");
+    return 1;
+  }
+
+  memset(&crf_data, 0, sizeof(crf_data));
+
+  input = crf1dm_new(input_file);
+  if (!input) {
+    fprintf(stderr, "Error: Could not load model: %s\n", input_file);
+    return 1;
+  }
+
+  /* Hashed IDs can be neither renumbered nor stored in a v1 model */
+  if (crf1dm_get_hash_bits(input) > 0) {
+    fprintf(stderr, "Error: %s is a hashed model and cannot be compressed\n",
+            input_file);
+    goto cleanup;
+  }
+
+  if (profile_file) {
+    int A = crf1dm_get_num_attrs(input);
+    int num_cold;
+
+    profile = read_attribute_profile(profile_file);
+    drop = calloc(A > 0 ? A : 1, 1);
+    if (!profile || !drop)
+      goto cleanup;
+    num_cold = mark_cold_attributes(input, profile, min_hits, drop);
+    if (num_cold < 0)
+      goto cleanup;
+    printf("Profile %s (%llu tokens): %d of %d attributes fired fewer than "
+           "%llu times\n",
+           profile_file, (unsigned long long)profile->tokens, num_cold, A,
+           (unsigned long long)min_hits);
+  }
+
+  if (compress_model(input, output_file, threshold, drop) != 0)
+    goto cleanup;
+
+  output = crf1dm_new(output_file);
+  if (!output) {
+    fprintf(stderr, "Error: Could not reload %s\n", output_file);
+    goto cleanup;
+  }
+
+  if (optind + 2 < argc) {
+    data = parse_training_files(&argv[optind + 2], argc - optind - 2);
+    if (!data || build_crf_data(data, &crf_data, 0) != 0)
+      goto cleanup;
+    printf("\nEvaluating on %d sequences...\n", crf_data.num_instances);
+    if (evaluate(&crf_data, input_file, &before) != 0 ||
+        evaluate(&crf_data, output_file, &after) != 0)
+      goto cleanup;
+    evaluated = 1;
+  }
+
+  printf("\nThreshold: %g\n\n", threshold);
+  printf("%-8s %9s %10s %7s %12s", "", "features", "attributes", "labels",
+         "bytes");
+  if (evaluated)
+    printf(" %9s %9s %9s %10s", "item_acc", "inst_acc", "macro_f1",
+           "tokens/s");
+  printf("\n");
+
+  print_model_row("input", input, input_file);
+  if (evaluated)
+    print_eval_columns(&before);
+  printf("\n");
+
+  print_model_row("output", output, output_file);
+  if (evaluated)
+    print_eval_columns(&after);
+  printf("\n");
+
+  printf("%-8s %9d %10d %7d %12lld", "delta",
+         crf1dm_get_num_features(output) - crf1dm_get_num_features(input),
+         crf1dm_get_num_attrs(output) - crf1dm_get_num_attrs(input),
+         crf1dm_get_num_labels(output) - crf1dm_get_num_labels(input),
+         file_size(output_file) - file_size(input_file));
+  if (evaluated)
+    printf(" %+9.4f %+9.4f %+9.4f %+10.0f",
+           after.item_accuracy - before.item_accuracy,
+           after.instance_accuracy - before.instance_accuracy,
+           after.macro_f1 - before.macro_f1,
+           after.tokens_per_second - before.tokens_per_second);
+  printf("\n");
+
+  printf("\nModel saved to: %s\n", output_file);
+  ret = 0;
+
+cleanup:
+  if (data) {
+    free_crf_data(&crf_data);
+    free_training_data(data);
+  }
+  if (output)
+    crf1dm_close(output);
+  crf1dm_close(input);
+  free(drop);
+  free_attribute_profile(profile);
+  return ret;
+}
@@ -0,0 +1,769 @@
+/* tools/convert_model.c - Rewrite a CRF model in the version 2 format */
+#include "attribute_profile.h"
+#include "crf_trainer.h"
+#include "training_data_parser.h"
+
+#include <crfsuite.h>
+#include <crf1d.h>
+
+#include <getopt.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Replay timings are the best of this many passes */
+#define REPLAY_ROUNDS 5
+
+/* Simulated caches for the replay: a 32 KiB, 8-way L1D and a 1 MiB,
+ * 16-way L2 with 64-byte lines and LRU replacement */
+#define CACHE_LINE_SHIFT 6
+#define PAGE_SHIFT 12
+#define L1_SETS 64
+#define L1_WAYS 8
+#define L2_SETS 1024
+#define L2_WAYS 16
+
+/* Hit-mass fractions reported for the hot working set */
+static const double coverage_levels[] = {0.5, 0.9, 0.99};
+#define NUM_COVERAGE_LEVELS 3
+
+/* A set-associative LRU cache; each set lists line numbers + 1, most
+ * recently used first, and 0 marks an empty way */
+typedef struct {
+  int sets;
+  int ways;
+  uint64_t *tags;
+  uint64_t misses;
+} SimCache;
+
+/* Result of replaying the evaluation data against one model */
+typedef struct {
+  uint64_t tokens;
+  uint64_t lookups;
+  uint64_t l1_misses;
+  uint64_t l2_misses;
+  long long hw_misses; /* -1 if hardware counters are unavailable */
+  double ns_per_token;
+} ReplayResult;
+
+static void print_usage(const char *prog) {
+  printf("Usage: %s [options] <input.crfsuite> <output.crfsuite> "
+         "[labeled.xml ...]\n",
+         prog);
+  printf("\nRewrite a model in the version 2 format, which the extension maps "
+         "and\nuses in place instead of parsing. The output is reloaded and "
+         "checked\nagainst the input before the tool reports success.\n");
+  printf("\nWith --reorder, attributes are renumbered by how often they fire, "
+         "so the\nstate features of hot attributes share cache lines and "
+         "pages. Frequencies\ncome from --profile, or else from the labeled "
+         "XML files. If XML files are\ngiven, their attribute lookups are "
+         "replayed against both layouts.\n");
+  printf("\nOptions:\n");
+  printf("  -r, --reorder        Renumber attributes by descending "
+         "frequency\n");
+  printf("  --profile FILE       Attribute profile from "
+         "dump_attribute_profile()\n");
+  printf("  -h, --help           Show this help message\n");
+}
+
+static long long file_size(const char *filename) {
+  struct stat st;
+  return stat(filename, &st) == 0 ? (long long)st.st_size : -1;
+}
+
+/* Open a model and report how long crf1dm_new took */
+static crf1dm_t *open_model(const char *filename, double *ms) {
+  struct timespec start, end;
+  crf1dm_t *model;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  model = crf1dm_new(filename);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  *ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+  return model;
+}
+
+/* Check that two models have the same labels, attributes and features;
+ * amap gives the ID in b of every attribute ID of a (NULL: unchanged) */
+static int compare_models(crf1dm_t *a, crf1dm_t *b, const int *amap) {
+  int L = crf1dm_get_num_labels(a);
+  int A = crf1dm_get_num_attrs(a);
+
+  int hash_bits = crf1dm_get_hash_bits(a);
+
+  if (L != crf1dm_get_num_labels(b) || A != crf1dm_get_num_attrs(b) ||
+      hash_bits != crf1dm_get_hash_bits(b) ||
+      crf1dm_get_num_features(a) != crf1dm_get_num_features(b)) {
+    fprintf(stderr, "Error: Model sizes differ\n");
+    return -1;
+  }
+
+  for (int l = 0; l < L; l++) {
+    const char *str = crf1dm_to_label(a, l);
+    if (strcmp(str, crf1dm_to_label(b, l)) != 0 || crf1dm_to_lid(b, str) != l) {
+      fprintf(stderr, "Error: Label %d differs\n", l);
+      return -1;
+    }
+  }
+
+  for (int aid = 0; aid < A; aid++) {
+    const char *str = crf1dm_to_attr(a, aid);
+    int bid = amap ? amap[aid] : aid;
+    feature_refs_t ra, rb;
+
+    /* Hashed models have no attribute strings */
+    if (hash_bits == 0 && (strcmp(str, crf1dm_to_attr(b, bid)) != 0 ||
+                           crf1dm_to_aid(b, str) != bid)) {
+      fprintf(stderr, "Error: Attribute %d differs\n", aid);
+      return -1;
+    }
+
+    /* Feature ids are renumbered, so compare what each reference points to */
+    crf1dm_get_attrref(a, aid, &ra);
+    crf1dm_get_attrref(b, bid, &rb);
+    if (ra.num_features != rb.num_features) {
+      fprintf(stderr, "Error: Features of attribute %d differ\n", aid);
+      return -1;
+    }
+    for (int r = 0; r < ra.num_features; r++) {
+      crf1dm_feature_t fa, fb;
+
+      crf1dm_get_feature(a, crf1dm_get_featureid(&ra, r), &fa);
+      crf1dm_get_feature(b, crf1dm_get_featureid(&rb, r), &fb);
+      if (fa.type != fb.type || fb.src != bid || fa.dst != fb.dst ||
+          fa.weight != fb.weight) {
+        fprintf(stderr, "Error: Feature %d of attribute %d differs\n", r,
+                aid);
+        return -1;
+      }
+    }
+  }
+
+  for (int l = 0; l < L; l++) {
+    feature_refs_t ra, rb;
+
+    crf1dm_get_labelref(a, l, &ra);
+    crf1dm_get_labelref(b, l, &rb);
+    if (ra.num_features != rb.num_features) {
+      fprintf(stderr, "Error: Transitions from label %d differ\n", l);
+      return -1;
+    }
+    for (int r = 0; r < ra.num_features; r++) {
+      crf1dm_feature_t fa, fb;
+
+      crf1dm_get_feature(a, crf1dm_get_featureid(&ra, r), &fa);
+      crf1dm_get_feature(b, crf1dm_get_featureid(&rb, r), &fb);
+      if (fa.src != fb.src || fa.dst != fb.dst || fa.weight != fb.weight) {
+        fprintf(stderr, "Error: Transition %d of label %d differs\n", r, l);
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+/* Map the attribute IDs of crf_data to those of model (-1: unknown) */
+static int *map_data_attributes(crfsuite_data_t *crf_data, crf1dm_t *model) {
+  int num = crf_data->attrs->num(crf_data->attrs);
+  int *map = malloc((num > 0 ? num : 1) * sizeof(int));
+
+  if (!map)
+    return NULL;
+  for (int i = 0; i < num; i++) {
+    const char *str = NULL;
+
+    crf_data->attrs->to_string(crf_data->attrs, i, &str);
+    map[i] = str ? crf1dm_to_aid(model, str) : -1;
+    crf_data->attrs->free(crf_data->attrs, str);
+  }
+  return map;
+}
+
+/* Count how often each attribute of model fires, from a profile or from the
+ * attributes of crf_data */
+static uint64_t *count_attributes(crf1dm_t *model,
+                                  const AttributeProfile *profile,
+                                  crfsuite_data_t *crf_data) {
+  const int A = crf1dm_get_num_attrs(model);
+  uint64_t *freq = calloc(A > 0 ? A : 1, sizeof(uint64_t));
+  int *map = NULL;
+
+  if (!freq)
+    return NULL;
+
+  if (profile) {
+    for (int a = 0; a < A; a++)
+      freq[a] = attribute_profile_hits(profile, crf1dm_to_attr(model, a));
+    return freq;
+  }
+
+  map = map_data_attributes(crf_data, model);
+  if (!map) {
+    free(freq);
+    return NULL;
+  }
+  for (int i = 0; i < crf_data->num_instances; i++) {
+    crfsuite_instance_t *inst = &crf_data->instances[i];
+
+    for (int t = 0; t < inst->num_items; t++) {
+      crfsuite_item_t *item = &inst->items[t];
+
+      for (int c = 0; c < item->num_contents; c++) {
+        int aid = map[item->contents[c].aid];
+        if (aid >= 0)
+          freq[aid]++;
+      }
+    }
+  }
+  free(map);
+  return freq;
+}
+
+/* Sort attribute IDs by descending frequency, keeping the original order
+ * among equals */
+static const uint64_t *sort_freq;
+
+static int compare_by_frequency(const void *a, const void *b) {
+  int x = *(const int *)a, y = *(const int *)b;
+
+  if (sort_freq[x] != sort_freq[y])
+    return sort_freq[x] > sort_freq[y] ? -1 : 1;
+  return x - y;
+}
+
+/* Attribute IDs ordered by descending frequency */
+static int *frequency_order(const uint64_t *freq, int A) {
+  int *order = malloc((A > 0 ? A : 1) * sizeof(int));
+
+  if (!order)
+    return NULL;
+  for (int a = 0; a < A; a++)
+    order[a] = a;
+  sort_freq = freq;
+  qsort(order, A, sizeof(int), compare_by_frequency);
+  return order;
+}
+
+/* Write model as v2 with attribute order[i] renumbered to i
+ *
+ * crf1dm_write_v2 lays the state features out in CSR form by attribute ID,
+ * so the features are renumbered along with the attributes and those of
+ * the hottest attributes end up next to each other. Labels and transitions
+ * are unchanged.
+ */
+static int write_reordered(crf1dm_t *model, const int *order, const int *amap,
+                           const char *filename) {
+  crf1dm_source_t src;
+  const char **labels, **attrs;
+  crf1dm_feature_t *features;
+  int ret = CRFSUITEERR_OUTOFMEMORY;
+
+  memset(&src, 0, sizeof(src));
+  src.num_labels = crf1dm_get_num_labels(model);
+  src.num_attrs = crf1dm_get_num_attrs(model);
+  src.num_features = crf1dm_get_num_features(model);
+
+  labels = calloc(src.num_labels + 1, sizeof(char *));
+  attrs = calloc(src.num_attrs + 1, sizeof(char *));
+  features = calloc(src.num_features + 1, sizeof(crf1dm_feature_t));
+  if (!labels || !attrs || !features)
+    goto cleanup;
+
+  for (int l = 0; l < src.num_labels; l++)
+    labels[l] = crf1dm_to_label(model, l);
+  for (int a = 0; a < src.num_attrs; a++)
+    attrs[a] = crf1dm_to_attr(model, order[a]);
+  for (int k = 0; k < src.num_features; k++) {
+    crf1dm_get_feature(model, k, &features[k]);
+    if (features[k].type == FT_STATE)
+      features[k].src = amap[features[k].src];
+  }
+
+  src.labels = labels;
+  src.attrs = attrs;
+  src.features = features;
+  ret = crf1dm_write_v2(filename, &src);
+
+cleanup:
+  free(features);
+  free(attrs);
+  free(labels);
+  return ret;
+}
+
+static int init_cache(SimCache *cache, int sets, int ways) {
+  cache->sets = sets;
+  cache->ways = ways;
+  cache->misses = 0;
+  cache->tags = calloc((size_t)sets * ways, sizeof(uint64_t));
+  return cache->tags ? 0 : -1;
+}
+
+/* Access one line; returns 1 on a miss */
+static int cache_access(SimCache *cache, uint64_t line) {
+  uint64_t *set = cache->tags + (line % cache->sets) * cache->ways;
+  int miss = 0;
+  int w;
+
+  for (w = 0; w < cache->ways && set[w] != line + 1; w++)
+    ;
+  if (w == cache->ways) {
+    miss = 1;
+    cache->misses++;
+    w = cache->ways - 1;
+  }
+  memmove(set + 1, set, w * sizeof(uint64_t));
+  set[0] = line + 1;
+  return miss;
+}
+
+/* Access every line of [p, p + size) in L1, and in L2 on an L1 miss */
+static void cache_range(SimCache *l1, SimCache *l2, const void *p,
+                        size_t size) {
+  uint64_t first = (uintptr_t)p >> CACHE_LINE_SHIFT;
+  uint64_t last = ((uintptr_t)p + (size ? size : 1) - 1) >> CACHE_LINE_SHIFT;
+
+  for (uint64_t line = first; line <= last; line++) {
+    if (cache_access(l1, line))
+      cache_access(l2, line);
+  }
+}
+
+/* Hardware cache-miss counter for this process, or -1 */
+static int open_miss_counter(void) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* Look up the attributes of every token of crf_data in model, as the tagger
+ * does when it scores states: the attribute string, then its row of state
+ * features. With caches, every line touched is passed through them. */
+static double replay_pass(crf1dm_t *model, crfsuite_data_t *crf_data,
+                          const int *map, SimCache *l1, SimCache *l2,
+                          uint64_t *lookups) {
+  double sum = 0;
+
+  for (int i = 0; i < crf_data->num_instances; i++) {
+    crfsuite_instance_t *inst = &crf_data->instances[i];
+
+    for (int t = 0; t < inst->num_items; t++) {
+      crfsuite_item_t *item = &inst->items[t];
+
+      for (int c = 0; c < item->num_contents; c++) {
+        int aid = map[item->contents[c].aid];
+        const int *dst;
+        const floatval_t *weight;
+        const char *str;
+        int n;
+
+        if (aid < 0)
+          continue;
+        str = crf1dm_to_attr(model, aid);
+        n = crf1dm_get_state_weights(model, aid, &dst, &weight);
+        for (int r = 0; r < n; r++)
+          sum += weight[r] * dst[r];
+        if (l1) {
+          cache_range(l1, l2, str, strlen(str) + 1);
+          cache_range(l1, l2, dst, n * sizeof(int));
+          cache_range(l1, l2, weight, n * sizeof(floatval_t));
+          (*lookups)++;
+        }
+      }
+    }
+  }
+  return sum;
+}
+
+/* Replay crf_data against a v2 model: simulated cache misses first, then
+ * the best of REPLAY_ROUNDS timed passes with hardware counters if the
+ * kernel provides them */
+static int replay(crf1dm_t *model, crfsuite_data_t *crf_data,
+                  ReplayResult *result) {
+  SimCache l1, l2;
+  int *map = map_data_attributes(crf_data, model);
+  int counter;
+  volatile double sink;
+
+  memset(result, 0, sizeof(*result));
+  if (!map || init_cache(&l1, L1_SETS, L1_WAYS) != 0 ||
+      init_cache(&l2, L2_SETS, L2_WAYS) != 0) {
+    fprintf(stderr, "Error: Out of memory\n");
+    free(map);
+    return -1;
+  }
+
+  for (int i = 0; i < crf_data->num_instances; i++)
+    result->tokens += crf_data->instances[i].num_items;
+
+  sink = replay_pass(model, crf_data, map, &l1, &l2, &result->lookups);
+  result->l1_misses = l1.misses;
+  result->l2_misses = l2.misses;
+  free(l2.tags);
+  free(l1.tags);
+
+  counter = open_miss_counter();
+  result->hw_misses = -1;
+  for (int round = 0; round < REPLAY_ROUNDS; round++) {
+    struct timespec start, end;
+    long long misses = -1;
+    double ns;
+
+    if (counter >= 0) {
+      ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+      ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    sink = replay_pass(model, crf_data, map, NULL, NULL, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (counter >= 0) {
+      ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(counter, &misses, sizeof(misses)) != sizeof(misses))
+        misses = -1;
+    }
+
+    ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) /
+         (result->tokens ? result->tokens : 1);
+    if (round == 0 || ns < result->ns_per_token)
+      result->ns_per_token = ns;
+    if (misses >= 0 && (result->hw_misses < 0 || misses < result->hw_misses))
+      result->hw_misses = misses;
+  }
+  (void)sink;
+
+  if (counter >= 0)
+    close(counter);
+  free(map);
+  return 0;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+/* Number of distinct units of 1 << shift bytes in sorted line numbers */
+static long count_units(const uint64_t *lines, long n, int shift) {
+  long units = 0;
+
+  for (long i = 0; i < n; i++) {
+    if (i == 0 ||
+        lines[i] >> (shift - CACHE_LINE_SHIFT) !=
+            lines[i - 1] >> (shift - CACHE_LINE_SHIFT))
+      units++;
+  }
+  return units;
+}
+
+/* Cache lines and pages of the state features of the hottest attributes of
+ * a v2 model that together account for fraction of all hits; freq and
+ * order are indexed by the attribute IDs of model */
+static int working_set(crf1dm_t *model, const uint64_t *freq,
+                       const int *order, double fraction, int *num_attrs,
+                       long *lines, long *pages) {
+  const int A = crf1dm_get_num_attrs(model);
+  uint64_t total = 0, covered = 0;
+  uint64_t *touched;
+  long n = 0, capacity = 1024;
+
+  for (int a = 0; a < A; a++)
+    total += freq[a];
+
+  touched = malloc(capacity * sizeof(uint64_t));
+  if (!touched)
+    return -1;
+
+  *num_attrs = 0;
+  for (int i = 0; i < A && total > 0 && covered < fraction * total; i++) {
+    int aid = order[i];
+    const int *dst;
+    const floatval_t *weight;
+    int k = crf1dm_get_state_weights(model, aid, &dst, &weight);
+    const void *starts[2] = {dst, weight};
+    size_t sizes[2] = {k * sizeof(int), k * sizeof(floatval_t)};
+
+    covered += freq[aid];
+    (*num_attrs)++;
+    for (int s = 0; s < 2 && k > 0; s++) {
+      uint64_t first = (uintptr_t)starts[s] >> CACHE_LINE_SHIFT;
+      uint64_t last = ((uintptr_t)starts[s] + sizes[s] - 1) >> CACHE_LINE_SHIFT;
+
+      for (uint64_t line = first; line <= last; line++) {
+        if (n == capacity) {
+          uint64_t *grown = realloc(touched, 2 * capacity * sizeof(uint64_t));
+          if (!grown) {
+            free(touched);
+            return -1;
+          }
+          touched = grown;
+          capacity *= 2;
+        }
+        touched[n++] = line;
+      }
+    }
+  }
+
+  qsort(touched, n, sizeof(uint64_t), compare_u64);
+  *lines = count_units(touched, n, CACHE_LINE_SHIFT);
+  *pages = count_units(touched, n, PAGE_SHIFT);
+  free(touched);
+  return 0;
+}
+
+static void print_replay_row(const char *name, ReplayResult *r) {
+  double tokens = r->tokens ? (double)r->tokens : 1;
+
+  printf("%-8s %9.2f %9.2f %9.2f", name, r->lookups / tokens,
+         r->l1_misses / tokens, r->l2_misses / tokens);
+  if (r->hw_misses >= 0)
+    printf(" %9.2f", r->hw_misses / tokens);
+  else
+    printf(" %9s", "n/a");
+  printf(" %9.1f\n", r->ns_per_token);
+}
+
+/* Report the hot working set and the replay for the original layout (base)
+ * and the reordered one (output) */
+static int report_locality(crf1dm_t *base, crf1dm_t *output,
+                           const uint64_t *freq, const int *order,
+                           crfsuite_data_t *crf_data) {
+  const int A = crf1dm_get_num_attrs(base);
+  uint64_t *out_freq = malloc((A > 0 ? A : 1) * sizeof(uint64_t));
+  int *out_order = malloc((A > 0 ? A : 1) * sizeof(int));
+
+  if (!out_freq || !out_order) {
+    free(out_freq);
+    free(out_order);
+    return -1;
+  }
+  /* In the output, attribute i is order[i] of the input */
+  for (int i = 0; i < A; i++) {
+    out_freq[i] = freq[order[i]];
+    out_order[i] = i;
+  }
+
+  printf("\nState features of the hottest attributes:\n");
+  printf("%-8s %9s %12s %12s %12s %12s\n", "hits", "attrs", "lines(in)",
+         "lines(out)", "pages(in)", "pages(out)");
+  for (int c = 0; c < NUM_COVERAGE_LEVELS; c++) {
+    int na, nb;
+    long lines_in, lines_out, pages_in, pages_out;
+
+    if (working_set(base, freq, order, coverage_levels[c], &na, &lines_in,
+                    &pages_in) != 0 ||
+        working_set(output, out_freq, out_order, coverage_levels[c], &nb,
+                    &lines_out, &pages_out) != 0) {
+      free(out_freq);
+      free(out_order);
+      return -1;
+    }
+    printf("%7.0f%% %9d %12ld %12ld %12ld %12ld\n", coverage_levels[c] * 100,
+           na, lines_in, lines_out, pages_in, pages_out);
+  }
+  free(out_freq);
+  free(out_order);
+
+  if (crf_data) {
+    ReplayResult before, after;
+
+    if (replay(base, crf_data, &before) != 0 ||
+        replay(output, crf_data, &after) != 0)
+      return -1;
+    printf("\nReplay of %d sequences (%llu tokens), per token:\n",
+           crf_data->num_instances, (unsigned long long)before.tokens);
+    printf("%-8s %9s %9s %9s %9s %9s\n", "", "lookups", "L1 miss", "L2 miss",
+           "hw miss", "ns");
+    print_replay_row("input", &before);
+    print_replay_row("output", &after);
+    if (before.hw_misses < 0)
+      printf("(L1/L2 are simulated: %d KiB %d-way and %d KiB %d-way LRU; "
+             "hardware\ncounters are not available)\n",
+             (L1_SETS * L1_WAYS) >> (10 - CACHE_LINE_SHIFT), L1_WAYS,
+             (L2_SETS * L2_WAYS) >> (10 - CACHE_LINE_SHIFT), L2_WAYS);
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  const char *input_file, *output_file;
+  const char *profile_file = NULL;
+  char base_file[4096];
+  crf1dm_t *input = NULL, *output = NULL, *base = NULL;
+  AttributeProfile *profile = NULL;
+  TrainingData *data = NULL;
+  crfsuite_data_t crf_data;
+  uint64_t *freq = NULL;
+  int *order = NULL, *amap = NULL;
+  double input_ms, output_ms;
+  int reorder = 0, status = 1;
+  int ret;
+
+  static struct option long_options[] = {
+      {"reorder", no_argument, 0, 'r'},
+      {"profile", required_argument, 0, 1001},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "rh", long_options, NULL)) != -1) {
+    switch (opt) {
+    case 'r':
+      reorder = 1;
+      break;
+    case 1001:
+      profile_file = optarg;
+      break;
+    case 'h':
+      print_usage(argv[0]);
+      return 0;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc - optind < 2) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  input_file = argv[optind];
+  output_file = argv[optind + 1];
+  if (strcmp(input_file, output_file) == 0) {
+    fprintf(stderr, "Error: Input and output must be different files\n");
+    return 1;
+  }
+  if ((profile_file || optind + 2 < argc) && !reorder) {
+    fprintf(stderr, "Error: --profile and labeled XML files are only used "
+                    "with --reorder\n");
+    return 1;
+  }
+  if (reorder && !profile_file && optind + 2 == argc) {
+    fprintf(stderr, "Error: --reorder needs --profile or labeled XML files\n");
+    return 1;
+  }
+
+  memset(&crf_data, 0, sizeof(crf_data));
+
+  input = open_model(input_file, &input_ms);
+  if (!input) {
+    fprintf(stderr, "Error: Could not load model: %s\n", input_file);
+    return 1;
+  }
+
+  if (!reorder) {
+    ret = crf1dm_save_v2(input, output_file);
+  } else {
+    const int A = crf1dm_get_num_attrs(input);
+
+    /* Hashed IDs are fixed by the hash function */
+    if (crf1dm_get_hash_bits(input) > 0) {
+      fprintf(stderr, "Error: %s is a hashed model and cannot be reordered\n",
+              input_file);
+      goto cleanup;
+    }
+
+    if (profile_file) {
+      profile = read_attribute_profile(profile_file);
+      if (!profile)
+        goto cleanup;
+      if (profile->hashed) {
+        fprintf(stderr, "Error: %s was recorded with a hashed model and has "
+                        "no attribute strings\n",
+                profile_file);
+        goto cleanup;
+      }
+    }
+    if (optind + 2 < argc) {
+      data = parse_training_files(&argv[optind + 2], argc - optind - 2);
+      if (!data || build_crf_data(data, &crf_data, 0) != 0)
+        goto cleanup;
+    }
+
+    freq = count_attributes(input, profile, &crf_data);
+    order = freq ? frequency_order(freq, A) : NULL;
+    amap = malloc((A > 0 ? A : 1) * sizeof(int));
+    if (!order || !amap) {
+      fprintf(stderr, "Error: Out of memory\n");
+      goto cleanup;
+    }
+    for (int i = 0; i < A; i++)
+      amap[order[i]] = i;
+
+    ret = write_reordered(input, order, amap, output_file);
+  }
+  if (ret != 0) {
+    fprintf(stderr, "Error: Could not write %s (error %d)\n", output_file,
+            ret);
+    goto cleanup;
+  }
+
+  output = open_model(output_file, &output_ms);
+  if (!output) {
+    fprintf(stderr, "Error: Could not reload %s\n", output_file);
+    goto cleanup;
+  }
+  ret = compare_models(input, output, amap);
+
+  printf("%-8s %7s %9s %10s %7s %12s %9s\n", "", "version", "features",
+         "attributes", "labels", "bytes", "load_ms");
+  printf("%-8s %7d %9d %10d %7d %12lld %9.3f\n", "input",
+         crf1dm_get_version(input), crf1dm_get_num_features(input),
+         crf1dm_get_num_attrs(input), crf1dm_get_num_labels(input),
+         file_size(input_file), input_ms);
+  printf("%-8s %7d %9d %10d %7d %12lld %9.3f\n", "output",
+         crf1dm_get_version(output), crf1dm_get_num_features(output),
+         crf1dm_get_num_attrs(output), crf1dm_get_num_labels(output),
+         file_size(output_file), output_ms);
+
+  if (ret != 0) {
+    fprintf(stderr, "Error: Converted model does not match the input\n");
+    goto cleanup;
+  }
+
+  /* Compare against the input in the v2 layout with its original IDs */
+  if (reorder) {
+    snprintf(base_file, sizeof(base_file), "%s.base", output_file);
+    if (crf1dm_save_v2(input, base_file) != 0 ||
+        !(base = crf1dm_new(base_file))) {
+      fprintf(stderr, "Error: Could not write %s\n", base_file);
+      unlink(base_file);
+      goto cleanup;
+    }
+    ret = report_locality(base, output, freq, order, data ? &crf_data : NULL);
+    crf1dm_close(base);
+    unlink(base_file);
+    if (ret != 0)
+      goto cleanup;
+  }
+
+  printf("\nModel saved to: %s\n", output_file);
+  status = 0;
+
+cleanup:
+  if (data) {
+    free_crf_data(&crf_data);
+    free_training_data(data);
+  }
+  free(amap);
+  free(order);
+  free(freq);
+  free_attribute_profile(profile);
+  if (output)
+    crf1dm_close(output);
+  crf1dm_close(input);
+  return status;
+}
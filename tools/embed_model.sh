@@ -0,0 +1,49 @@
+#!/bin/sh
+# tools/embed_model.sh - Generate a C source file that embeds a model
+#
+# Usage: tools/embed_model.sh TYPE MODEL_FILE > src/embedded_model.c
+#
+# TYPE is the model type the data replaces (person, company or generic).
+set -e
+
+if [ $# -ne 2 ]; then
+  echo "Usage: $0 TYPE MODEL_FILE" >&2
+  exit 1
+fi
+
+type=$1
+file=$2
+
+case "$type" in
+  person|company|generic) ;;
+  *)
+    echo "Error: Model type must be person, company or generic: $type" >&2
+    exit 1
+    ;;
+esac
+
+if [ ! -r "$file" ]; then
+  echo "Error: Cannot read model file: $file" >&2
+  exit 1
+fi
+
+size=$(wc -c < "$file" | tr -d ' ')
+
+cat <<HEADER
+/* src/embedded_model.c - generated by tools/embed_model.sh from $file; do not edit */
+#include "postgres.h"
+
+#include "crfsuite_wrapper.h"
+
+const char embedded_model_type[] = "$type";
+const size_t embedded_model_size = $size;
+
+/* Aligned so that a v2 model can be used in place */
+const unsigned char embedded_model_data[] pg_attribute_aligned(64) = {
+HEADER
+
+od -An -v -tx1 "$file" |
+  sed -e 's/^ *//' -e 's/ *$//' -e '/^$/d' \
+      -e 's/\([0-9a-f][0-9a-f]\)/0x\1,/g' -e 's/^/  /'
+
+echo "};"
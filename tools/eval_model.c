@@ -0,0 +1,272 @@
+/* tools/eval_model.c - Accuracy and tagging speed of a model on labeled data
+ *
+ * Tags every labeled name the way the extension does once a name is
+ * tokenized: attributes from the shared feature library restricted to the
+ * templates the model has, dictionary lookup, then Viterbi. The gold tokens
+ * are tagged as they are, so accuracy does not depend on the tokenizer.
+ * Per-label F1 and sequence accuracy are printed together with names per
+ * second and per-name latency percentiles, so that a retrained model can be
+ * judged on both.
+ */
+#include "name_features.h"
+#include "training_data_parser.h"
+
+#include <crfsuite.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static void print_usage(const char *prog) {
+  printf("Usage: %s [options] <model.crfsuite> <labeled.xml> "
+         "[labeled.xml ...]\n",
+         prog);
+  printf("\nTag the labeled names with the model and report per-label "
+         "precision, recall\nand F1, token and sequence accuracy, names per "
+         "second and per-name latency.\n");
+  printf("\nOptions:\n");
+  printf("  -n, --passes N  Timed passes over the names (default: 3)\n");
+  printf("  -h, --help      Show this help message\n");
+}
+
+static double elapsed_ns(const struct timespec *start,
+                         const struct timespec *end) {
+  return (end->tv_sec - start->tv_sec) * 1e9 +
+         (end->tv_nsec - start->tv_nsec);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* Tag one sequence into labels; returns 0 on success */
+static int tag_sequence(LabeledSequence *seq, crfsuite_dictionary_t *attrs,
+                        uint64_t templates, crfsuite_tagger_t *tagger,
+                        const char **texts, NameFeatureList *features,
+                        int *labels) {
+  crfsuite_instance_t instance;
+  floatval_t score;
+  int ret;
+
+  for (int i = 0; i < seq->num_tokens; i++)
+    texts[i] = seq->tokens[i].text;
+
+  crfsuite_instance_init(&instance);
+  for (int i = 0; i < seq->num_tokens; i++) {
+    crfsuite_item_t item;
+
+    crfsuite_item_init(&item);
+    extract_name_features(texts, seq->num_tokens, i, templates, features);
+    for (int j = 0; j < features->num_features; j++) {
+      int aid = attrs->to_id(attrs, features->features[j].name);
+
+      if (aid >= 0) {
+        crfsuite_attribute_t attr;
+
+        crfsuite_attribute_set(&attr, aid, features->features[j].value);
+        crfsuite_item_append_attribute(&item, &attr);
+      }
+    }
+    crfsuite_instance_append(&instance, &item, 0);
+    crfsuite_item_finish(&item);
+  }
+
+  ret = tagger->set(tagger, &instance);
+  if (ret == 0)
+    ret = tagger->viterbi(tagger, labels, &score);
+  crfsuite_instance_finish(&instance);
+  return ret;
+}
+
+static void print_accuracy(crfsuite_evaluation_t *eval,
+                           crfsuite_dictionary_t *labels, int num_labels) {
+  double macro_f1 = 0;
+
+  printf("%-32s %8s %8s %8s %9s %9s %9s\n", "label", "ref", "model",
+         "match", "precision", "recall", "F1");
+  for (int l = 0; l <= num_labels; l++) {
+    const crfsuite_label_evaluation_t *lev = &eval->tbl[l];
+    const char *name = NULL;
+
+    if (lev->num_observation == 0 && lev->num_model == 0)
+      continue;
+    if (l < num_labels)
+      labels->to_string(labels, l, &name);
+    printf("%-32s %8d %8d %8d", name ? name : "(not in model)",
+           lev->num_observation, lev->num_model, lev->num_correct);
+    if (lev->num_observation > 0)
+      printf(" %9.4f %9.4f %9.4f\n", lev->precision, lev->recall,
+             lev->fmeasure);
+    else
+      printf(" %9s %9s %9s\n", "-", "-", "-");
+    if (name)
+      labels->free(labels, name);
+  }
+  /* eval has a slot for gold labels the model lacks, and its macro average
+   * is divided by that count too; average over the model's labels alone,
+   * as compress_model and train_model --cv do */
+  for (int l = 0; l < num_labels; l++)
+    macro_f1 += eval->tbl[l].fmeasure;
+  if (num_labels > 0)
+    macro_f1 /= num_labels;
+  printf("\nMacro-average F1:   %.4f\n", macro_f1);
+  printf("Token accuracy:     %d / %d (%.4f)\n", eval->item_total_correct,
+         eval->item_total_num, eval->item_accuracy);
+  printf("Sequence accuracy:  %d / %d (%.4f)\n", eval->inst_total_correct,
+         eval->inst_total_num, eval->inst_accuracy);
+}
+
+int main(int argc, char *argv[]) {
+  int passes = 3;
+  const char *model_file;
+  crfsuite_model_t *model = NULL;
+  crfsuite_dictionary_t *attrs = NULL, *labels = NULL;
+  crfsuite_tagger_t *tagger = NULL;
+  crfsuite_evaluation_t eval;
+  TrainingData *data = NULL;
+  NameFeatureList *features = NULL;
+  const char **texts = NULL;
+  int *predicted = NULL, *reference = NULL;
+  double *latencies = NULL;
+  double total_ns = 0;
+  uint64_t templates;
+  int num_labels, max_tokens = 1, num_timed = 0, ret = 1;
+
+  static struct option long_options[] = {{"passes", required_argument, 0, 'n'},
+                                         {"help", no_argument, 0, 'h'},
+                                         {0, 0, 0, 0}};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "n:h", long_options, NULL)) != -1) {
+    switch (opt) {
+    case 'n':
+      passes = atoi(optarg);
+      if (passes < 1) {
+        fprintf(stderr, "Error: Passes must be at least 1\n");
+        return 1;
+      }
+      break;
+    case 'h':
+      print_usage(argv[0]);
+      return 0;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc - optind < 2) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  model_file = argv[optind];
+
+  if (crfsuite_create_instance_from_file(model_file, (void **)&model) != 0) {
+    fprintf(stderr, "Error: Could not load model: %s\n", model_file);
+    return 1;
+  }
+  model->get_attrs(model, &attrs);
+  model->get_labels(model, &labels);
+  if (model->get_tagger(model, &tagger) != 0) {
+    fprintf(stderr, "Error: Could not create a tagger\n");
+    goto release;
+  }
+  templates = name_model_templates(attrs);
+  num_labels = labels->num(labels);
+
+  data = parse_training_files(&argv[optind + 1], argc - optind - 1);
+  if (!data || data->num_sequences == 0) {
+    if (data)
+      fprintf(stderr, "Error: No labeled names to evaluate\n");
+    goto cleanup;
+  }
+  for (int i = 0; i < data->num_sequences; i++) {
+    if (data->sequences[i].num_tokens > max_tokens)
+      max_tokens = data->sequences[i].num_tokens;
+  }
+
+  features = malloc(sizeof(NameFeatureList));
+  texts = malloc(max_tokens * sizeof(const char *));
+  predicted = malloc(max_tokens * sizeof(int));
+  reference = malloc(max_tokens * sizeof(int));
+  latencies = malloc((size_t)passes * data->num_sequences * sizeof(double));
+  if (!features || !texts || !predicted || !reference || !latencies) {
+    fprintf(stderr, "Error: Out of memory\n");
+    goto cleanup;
+  }
+
+  /* Gold labels the model does not know count against the extra last slot */
+  crfsuite_evaluation_init(&eval, num_labels + 1);
+
+  /* Pass 0 is scored and warms caches; the others are timed */
+  for (int pass = 0; pass <= passes; pass++) {
+    for (int i = 0; i < data->num_sequences; i++) {
+      LabeledSequence *seq = &data->sequences[i];
+      struct timespec start, end;
+
+      if (seq->num_tokens == 0)
+        continue;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      if (tag_sequence(seq, attrs, templates, tagger, texts, features,
+                       predicted) != 0) {
+        fprintf(stderr, "Error: Tagging failed for sequence %d\n", i);
+        goto finish;
+      }
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      if (pass > 0) {
+        latencies[num_timed++] = elapsed_ns(&start, &end);
+        total_ns += latencies[num_timed - 1];
+        continue;
+      }
+      for (int j = 0; j < seq->num_tokens; j++) {
+        int lid = labels->to_id(labels, seq->tokens[j].label);
+        reference[j] = lid >= 0 ? lid : num_labels;
+      }
+      crfsuite_evaluation_accmulate(&eval, reference, predicted,
+                                    seq->num_tokens);
+    }
+  }
+  crfsuite_evaluation_finalize(&eval);
+  if (num_timed == 0) {
+    fprintf(stderr, "Error: No labeled names to evaluate\n");
+    goto finish;
+  }
+
+  printf("Model: %s (%d labels)\n\n", model_file, num_labels);
+  print_accuracy(&eval, labels, num_labels);
+
+  qsort(latencies, num_timed, sizeof(double), compare_doubles);
+  printf("\nSpeed over %d pass%s of %d names:\n", passes,
+         passes == 1 ? "" : "es", eval.inst_total_num);
+  printf("  Names/sec:        %.0f\n",
+         total_ns > 0 ? num_timed / (total_ns / 1e9) : 0);
+  printf("  Latency p50:      %.1f us\n",
+         latencies[(num_timed - 1) / 2] / 1000);
+  printf("  Latency p99:      %.1f us\n",
+         latencies[(int)((num_timed - 1) * 0.99)] / 1000);
+  printf("  Latency max:      %.1f us\n", latencies[num_timed - 1] / 1000);
+  ret = 0;
+
+finish:
+  crfsuite_evaluation_finish(&eval);
+cleanup:
+  free(features);
+  free(texts);
+  free(predicted);
+  free(reference);
+  free(latencies);
+  free_training_data(data);
+release:
+  if (tagger)
+    tagger->release(tagger);
+  if (labels)
+    labels->release(labels);
+  if (attrs)
+    attrs->release(attrs);
+  model->release(model);
+  return ret;
+}
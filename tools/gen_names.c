@@ -0,0 +1,552 @@
+/* tools/gen_names.c - Synthetic name corpus for benchmarks
+ *
+ * Learns from labeled XML which label sequences occur (the templates) and
+ * which tokens fill each label, then draws any number of names: a template
+ * picked with its observed frequency, each label filled with a token picked
+ * with its observed frequency. Tokens are drawn from names written in the
+ * same case as the template's source (all upper case or not), so that
+ * "VALERY TRUJILLO" style names stay consistent. A share of the output
+ * repeats earlier names, to exercise caches, and the token-count
+ * distribution can be replaced. Output is labeled XML in the format of
+ * name_data/, CSV, or plain text with one name per line.
+ */
+#include "training_data_parser.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Longest template kept, in tokens */
+#define MAX_TEMPLATE_TOKENS 64
+
+/* Earlier names kept for duplicates */
+#define DUPLICATE_POOL_SIZE 65536
+
+typedef enum { FORMAT_TEXT, FORMAT_CSV, FORMAT_XML } OutputFormat;
+
+/* Tokens seen with one label in names of one case; a token appears once per
+ * occurrence, so a uniform pick follows its frequency */
+typedef struct {
+  char **tokens;
+  int num_tokens;
+  int capacity;
+} TokenPool;
+
+typedef struct {
+  char *label;
+  TokenPool pools[2]; /* Indexed by upper */
+} LabelPool;
+
+typedef struct {
+  LabeledSequence *source;
+  int *labels; /* Indexes into the label pools */
+  bool upper;  /* Source name is written in upper case */
+} Template;
+
+typedef struct {
+  LabelPool *labels;
+  int num_labels;
+  Template *templates;
+  int num_templates;
+  /* Templates by token count, and the weight of each count */
+  int *by_length[MAX_TEMPLATE_TOKENS + 1];
+  int num_by_length[MAX_TEMPLATE_TOKENS + 1];
+  double length_weight[MAX_TEMPLATE_TOKENS + 1];
+} Corpus;
+
+static void print_usage(const char *prog) {
+  printf("Usage: %s [options] <labeled.xml> [labeled.xml ...]\n", prog);
+  printf("\nGenerate names with the label sequences and tokens of the "
+         "labeled data.\n");
+  printf("\nOptions:\n");
+  printf("  -n, --count N          Names to generate, k and M suffixes "
+         "allowed\n"
+         "                         (default: 1M)\n");
+  printf("  -f, --format FORMAT    text, csv or xml (default: text)\n");
+  printf("  -d, --duplicates R     Share of names repeating an earlier "
+         "one, 0 to 1\n"
+         "                         (default: 0)\n");
+  printf("  -l, --lengths SPEC     Token-count weights, e.g. 1:10,2:60,3:30; "
+         "counts\n"
+         "                         left out are not generated (default: as "
+         "observed)\n");
+  printf("  -s, --seed N           Random seed (default: 1)\n");
+  printf("  -o, --output FILE      Write to FILE instead of stdout\n");
+  printf("  -h, --help             Show this help message\n");
+}
+
+/* xorshift64*: fast, and the same stream for the same seed everywhere */
+static uint64_t rng_state;
+
+static uint64_t next_random(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ULL;
+}
+
+static int random_below(int n) { return (int)(next_random() % (uint64_t)n); }
+
+static double random_unit(void) {
+  return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Parse a count with an optional k or M suffix; returns -1 if invalid */
+static long parse_count(const char *arg) {
+  char *end;
+  long n;
+
+  errno = 0;
+  n = strtol(arg, &end, 10);
+  if (errno != 0 || end == arg || n < 0)
+    return -1;
+  if (*end == 'k' || *end == 'K') {
+    n *= 1000;
+    end++;
+  } else if (*end == 'm' || *end == 'M') {
+    n *= 1000000;
+    end++;
+  }
+  return *end == '\0' ? n : -1;
+}
+
+/* Parse "count:weight,..." into weights; returns 0 on success */
+static int parse_lengths(const char *spec, double *weights) {
+  const char *p = spec;
+
+  for (int i = 0; i <= MAX_TEMPLATE_TOKENS; i++)
+    weights[i] = 0;
+  while (*p) {
+    char *end;
+    long count = strtol(p, &end, 10);
+    double weight;
+
+    if (end == p || *end != ':' || count < 1 || count > MAX_TEMPLATE_TOKENS)
+      return -1;
+    p = end + 1;
+    weight = strtod(p, &end);
+    if (end == p || weight < 0)
+      return -1;
+    weights[count] = weight;
+    p = end;
+    if (*p == ',')
+      p++;
+    else if (*p != '\0')
+      return -1;
+  }
+  return 0;
+}
+
+/* True if the name has letters and none of them is lower case */
+static bool is_upper_case(LabeledSequence *seq) {
+  bool letters = false;
+
+  for (int i = 0; i < seq->num_tokens; i++) {
+    for (const char *c = seq->tokens[i].text; *c; c++) {
+      if (islower((unsigned char)*c))
+        return false;
+      if (isupper((unsigned char)*c))
+        letters = true;
+    }
+  }
+  return letters;
+}
+
+static int find_label(Corpus *corpus, const char *label) {
+  LabelPool *pools;
+
+  for (int i = 0; i < corpus->num_labels; i++) {
+    if (strcmp(corpus->labels[i].label, label) == 0)
+      return i;
+  }
+  pools = realloc(corpus->labels, (corpus->num_labels + 1) * sizeof(LabelPool));
+  if (!pools)
+    return -1;
+  corpus->labels = pools;
+  memset(&pools[corpus->num_labels], 0, sizeof(LabelPool));
+  pools[corpus->num_labels].label = (char *)label;
+  return corpus->num_labels++;
+}
+
+static int add_token(TokenPool *pool, char *token) {
+  if (pool->num_tokens == pool->capacity) {
+    int capacity = pool->capacity ? pool->capacity * 2 : 64;
+    char **tokens = realloc(pool->tokens, capacity * sizeof(char *));
+
+    if (!tokens)
+      return -1;
+    pool->tokens = tokens;
+    pool->capacity = capacity;
+  }
+  pool->tokens[pool->num_tokens++] = token;
+  return 0;
+}
+
+/* Build templates and token pools; strings stay in data */
+static int learn_corpus(TrainingData *data, Corpus *corpus) {
+  memset(corpus, 0, sizeof(Corpus));
+  corpus->templates = calloc(data->num_sequences, sizeof(Template));
+  if (!corpus->templates)
+    return -1;
+
+  for (int s = 0; s < data->num_sequences; s++) {
+    LabeledSequence *seq = &data->sequences[s];
+    Template *tmpl = &corpus->templates[corpus->num_templates];
+
+    if (seq->num_tokens == 0 || seq->num_tokens > MAX_TEMPLATE_TOKENS)
+      continue;
+    tmpl->source = seq;
+    tmpl->upper = is_upper_case(seq);
+    tmpl->labels = malloc(seq->num_tokens * sizeof(int));
+    if (!tmpl->labels)
+      return -1;
+    for (int i = 0; i < seq->num_tokens; i++) {
+      int l = find_label(corpus, seq->tokens[i].label);
+
+      if (l < 0 ||
+          add_token(&corpus->labels[l].pools[tmpl->upper],
+                    seq->tokens[i].text) != 0)
+        return -1;
+      tmpl->labels[i] = l;
+    }
+    corpus->num_by_length[seq->num_tokens]++;
+    corpus->num_templates++;
+  }
+
+  for (int n = 1; n <= MAX_TEMPLATE_TOKENS; n++) {
+    if (corpus->num_by_length[n] == 0)
+      continue;
+    corpus->by_length[n] = malloc(corpus->num_by_length[n] * sizeof(int));
+    if (!corpus->by_length[n])
+      return -1;
+    corpus->length_weight[n] = corpus->num_by_length[n];
+    corpus->num_by_length[n] = 0;
+  }
+  for (int t = 0; t < corpus->num_templates; t++) {
+    int n = corpus->templates[t].source->num_tokens;
+    corpus->by_length[n][corpus->num_by_length[n]++] = t;
+  }
+  return 0;
+}
+
+static void free_corpus(Corpus *corpus) {
+  for (int l = 0; l < corpus->num_labels; l++) {
+    free(corpus->labels[l].pools[0].tokens);
+    free(corpus->labels[l].pools[1].tokens);
+  }
+  free(corpus->labels);
+  for (int t = 0; t < corpus->num_templates; t++)
+    free(corpus->templates[t].labels);
+  free(corpus->templates);
+  for (int n = 0; n <= MAX_TEMPLATE_TOKENS; n++)
+    free(corpus->by_length[n]);
+}
+
+static Template *pick_template(Corpus *corpus, double total_weight) {
+  double r = random_unit() * total_weight;
+  int n, last = 0, pick;
+
+  for (n = 1; n <= MAX_TEMPLATE_TOKENS; n++) {
+    if (corpus->length_weight[n] <= 0)
+      continue;
+    last = n;
+    if (r < corpus->length_weight[n])
+      break;
+    r -= corpus->length_weight[n];
+  }
+  /* Rounding can run past the last count */
+  if (n > MAX_TEMPLATE_TOKENS)
+    n = last;
+  pick = random_below(corpus->num_by_length[n]);
+  return &corpus->templates[corpus->by_length[n][pick]];
+}
+
+/* Token for a label, in the template's case if the label was seen in it */
+static const char *pick_token(LabelPool *pool, bool upper) {
+  TokenPool *tokens = &pool->pools[upper];
+
+  if (tokens->num_tokens == 0)
+    tokens = &pool->pools[!upper];
+  return tokens->tokens[random_below(tokens->num_tokens)];
+}
+
+/* Append text to buf, decoding the XML entities of the labeled data */
+static void append_plain(char *buf, size_t size, size_t *len,
+                         const char *text) {
+  static const struct {
+    const char *entity;
+    char c;
+  } entities[] = {{"&amp;", '&'},  {"&lt;", '<'},   {"&gt;", '>'},
+                  {"&quot;", '"'}, {"&apos;", '\''}};
+
+  while (*text && *len + 1 < size) {
+    char c = *text++;
+
+    if (c == '&') {
+      for (size_t e = 0; e < sizeof(entities) / sizeof(entities[0]); e++) {
+        size_t n = strlen(entities[e].entity) - 1;
+
+        if (strncmp(text, entities[e].entity + 1, n) == 0) {
+          c = entities[e].c;
+          text += n;
+          break;
+        }
+      }
+    }
+    buf[(*len)++] = c;
+  }
+  buf[*len] = '\0';
+}
+
+static void append_raw(char *buf, size_t size, size_t *len, const char *text) {
+  int n = snprintf(buf + *len, size - *len, "%s", text);
+
+  if (n > 0)
+    *len = *len + n < size ? *len + n : size - 1;
+}
+
+/* Format one name as an output line, without the newline */
+static void format_name(Template *tmpl, Corpus *corpus, OutputFormat format,
+                        char *buf, size_t size) {
+  int num_tokens = tmpl->source->num_tokens;
+  size_t len = 0;
+
+  buf[0] = '\0';
+  if (format == FORMAT_XML)
+    append_raw(buf, size, &len, "  <Name>");
+  for (int i = 0; i < num_tokens; i++) {
+    LabelPool *pool = &corpus->labels[tmpl->labels[i]];
+    const char *token = pick_token(pool, tmpl->upper);
+
+    if (i > 0)
+      append_raw(buf, size, &len, " ");
+    if (format == FORMAT_XML) {
+      /* Tokens are still escaped as in the labeled data */
+      append_raw(buf, size, &len, "<");
+      append_raw(buf, size, &len, pool->label);
+      append_raw(buf, size, &len, ">");
+      append_raw(buf, size, &len, token);
+      append_raw(buf, size, &len, "</");
+      append_raw(buf, size, &len, pool->label);
+      append_raw(buf, size, &len, ">");
+    } else {
+      append_plain(buf, size, &len, token);
+    }
+  }
+  if (format == FORMAT_XML)
+    append_raw(buf, size, &len, "</Name>");
+}
+
+static void write_csv_field(FILE *out, const char *text) {
+  fputc('"', out);
+  for (const char *c = text; *c; c++) {
+    if (*c == '"')
+      fputc('"', out);
+    fputc(*c, out);
+  }
+  fputc('"', out);
+}
+
+int main(int argc, char *argv[]) {
+  long count = 1000000;
+  OutputFormat format = FORMAT_TEXT;
+  double duplicates = 0;
+  const char *lengths = NULL;
+  const char *output_file = NULL;
+  uint64_t seed = 1;
+  TrainingData *data = NULL;
+  Corpus corpus;
+  char **pool = NULL;
+  long pool_size = 0, num_duplicates = 0;
+  double total_weight = 0;
+  FILE *out = stdout;
+  char line[16384];
+  int ret = 1;
+
+  static struct option long_options[] = {
+      {"count", required_argument, 0, 'n'},
+      {"format", required_argument, 0, 'f'},
+      {"duplicates", required_argument, 0, 'd'},
+      {"lengths", required_argument, 0, 'l'},
+      {"seed", required_argument, 0, 's'},
+      {"output", required_argument, 0, 'o'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "n:f:d:l:s:o:h", long_options,
+                            NULL)) != -1) {
+    switch (opt) {
+    case 'n':
+      count = parse_count(optarg);
+      if (count < 0) {
+        fprintf(stderr, "Error: Invalid count: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'f':
+      if (strcmp(optarg, "text") == 0) {
+        format = FORMAT_TEXT;
+      } else if (strcmp(optarg, "csv") == 0) {
+        format = FORMAT_CSV;
+      } else if (strcmp(optarg, "xml") == 0) {
+        format = FORMAT_XML;
+      } else {
+        fprintf(stderr, "Error: Format must be text, csv or xml\n");
+        return 1;
+      }
+      break;
+    case 'd':
+      duplicates = atof(optarg);
+      if (duplicates < 0 || duplicates > 1) {
+        fprintf(stderr, "Error: Duplicate share must be between 0 and 1\n");
+        return 1;
+      }
+      break;
+    case 'l':
+      lengths = optarg;
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'o':
+      output_file = optarg;
+      break;
+    case 'h':
+      print_usage(argv[0]);
+      return 0;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (optind >= argc) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  /* xorshift must not start at zero */
+  rng_state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+
+  data = parse_training_files(&argv[optind], argc - optind);
+  if (!data)
+    return 1;
+
+  if (learn_corpus(data, &corpus) != 0) {
+    fprintf(stderr, "Error: Out of memory\n");
+    goto cleanup;
+  }
+  if (corpus.num_templates == 0) {
+    fprintf(stderr, "Error: No labeled names to learn from\n");
+    goto cleanup;
+  }
+
+  if (lengths) {
+    double weights[MAX_TEMPLATE_TOKENS + 1];
+
+    if (parse_lengths(lengths, weights) != 0) {
+      fprintf(stderr, "Error: Invalid lengths: %s\n", lengths);
+      goto cleanup;
+    }
+    for (int n = 1; n <= MAX_TEMPLATE_TOKENS; n++) {
+      if (weights[n] > 0 && corpus.num_by_length[n] == 0) {
+        fprintf(stderr, "Error: No labeled name has %d tokens\n", n);
+        goto cleanup;
+      }
+      corpus.length_weight[n] = weights[n];
+    }
+  }
+  for (int n = 1; n <= MAX_TEMPLATE_TOKENS; n++)
+    total_weight += corpus.length_weight[n];
+  if (total_weight <= 0) {
+    fprintf(stderr, "Error: All length weights are zero\n");
+    goto cleanup;
+  }
+
+  if (duplicates > 0) {
+    pool = calloc(DUPLICATE_POOL_SIZE, sizeof(char *));
+    if (!pool) {
+      fprintf(stderr, "Error: Out of memory\n");
+      goto cleanup;
+    }
+  }
+
+  if (output_file) {
+    out = fopen(output_file, "w");
+    if (!out) {
+      fprintf(stderr, "Error: Cannot open %s for writing\n", output_file);
+      goto cleanup;
+    }
+  }
+
+  if (format == FORMAT_XML)
+    fprintf(out, "<NameCollection>\n");
+  else if (format == FORMAT_CSV)
+    fprintf(out, "name\n");
+
+  for (long i = 0; i < count; i++) {
+    const char *name;
+
+    if (pool_size > 0 && random_unit() < duplicates) {
+      name = pool[random_below(pool_size < DUPLICATE_POOL_SIZE
+                                   ? (int)pool_size
+                                   : DUPLICATE_POOL_SIZE)];
+      num_duplicates++;
+    } else {
+      format_name(pick_template(&corpus, total_weight), &corpus, format, line,
+                  sizeof(line));
+      name = line;
+      /* Keep the first names, then replace one at random once the pool
+       * is full so that later names can repeat too */
+      if (pool) {
+        long slot = pool_size < DUPLICATE_POOL_SIZE
+                        ? pool_size
+                        : random_below(DUPLICATE_POOL_SIZE);
+        char *copy = strdup(line);
+
+        if (copy) {
+          free(pool[slot]);
+          pool[slot] = copy;
+          pool_size++;
+        }
+      }
+    }
+
+    if (format == FORMAT_CSV)
+      write_csv_field(out, name);
+    else
+      fputs(name, out);
+    fputc('\n', out);
+  }
+
+  if (format == FORMAT_XML)
+    fprintf(out, "</NameCollection>\n");
+
+  if (ferror(out)) {
+    fprintf(stderr, "Error: Failed writing output\n");
+  } else {
+    fprintf(stderr,
+            "Generated %ld names (%ld repeated) from %d templates and %d "
+            "labels\n",
+            count, num_duplicates, corpus.num_templates, corpus.num_labels);
+    ret = 0;
+  }
+  if (out != stdout && fclose(out) != 0 && ret == 0) {
+    fprintf(stderr, "Error: Failed writing %s\n", output_file);
+    ret = 1;
+  }
+
+cleanup:
+  if (pool) {
+    for (int i = 0; i < DUPLICATE_POOL_SIZE; i++)
+      free(pool[i]);
+    free(pool);
+  }
+  free_corpus(&corpus);
+  free_training_data(data);
+  return ret;
+}
@@ -0,0 +1,309 @@
+/* tools/inspect_model.c - Report the size and per-token cost of a CRF model */
+#include "crf_trainer.h"
+#include "name_features.h"
+#include "training_data_parser.h"
+
+#include <crfsuite.h>
+#include <crf1d.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* More than enough for the sections of either format */
+#define MAX_SECTIONS 32
+
+/* Upper bounds of the features-per-attribute histogram buckets */
+static const int bucket_limits[] = {0, 1, 2, 4, 8, 16, 32, 64};
+#define NUM_BUCKETS 8
+
+static void print_usage(const char *prog) {
+  printf("Usage: %s [options] <model.crfsuite> [labeled.xml ...]\n", prog);
+  printf("\nReport section sizes, features per attribute and transition "
+         "density of a\nmodel. If labeled XML files are given, their tokens "
+         "are run through the\ntrainer's feature extraction to estimate "
+         "the lookups and multiply-adds\nthe tagger performs per token.\n");
+  printf("\nOptions:\n");
+  printf("  -d, --dump    Also print every label, attribute and feature\n");
+  printf("  -h, --help    Show this help message\n");
+}
+
+static long long file_size(const char *filename) {
+  struct stat st;
+  return stat(filename, &st) == 0 ? (long long)st.st_size : -1;
+}
+
+static void print_sections(crf1dm_t *model, long long total) {
+  crf1dm_section_t sections[MAX_SECTIONS];
+  int n = crf1dm_get_sections(model, sections, MAX_SECTIONS);
+  long long used = 0;
+
+  if (n > MAX_SECTIONS)
+    n = MAX_SECTIONS;
+
+  printf("\n%-16s %10s %10s %7s\n", "section", "offset", "bytes", "share");
+  for (int i = 0; i < n; i++) {
+    used += sections[i].size;
+    printf("%-16s %10u %10u %6.1f%%\n", sections[i].name, sections[i].offset,
+           sections[i].size, 100.0 * sections[i].size / total);
+  }
+  if (total > used)
+    printf("%-16s %10s %10lld %6.1f%%\n", "(padding)", "",
+           total - used, 100.0 * (total - used) / total);
+}
+
+static int compare_ints(const void *a, const void *b) {
+  return *(const int *)a - *(const int *)b;
+}
+
+/* Features per attribute, as a summary and a histogram */
+static int print_attribute_features(crf1dm_t *model) {
+  const int A = crf1dm_get_num_attrs(model);
+  int *counts = malloc((A > 0 ? A : 1) * sizeof(int));
+  int buckets[NUM_BUCKETS + 1] = {0};
+  long long total = 0;
+
+  if (!counts) {
+    fprintf(stderr, "Error: Out of memory\n");
+    return -1;
+  }
+
+  for (int a = 0; a < A; a++) {
+    feature_refs_t ref;
+    int b = 0;
+
+    crf1dm_get_attrref(model, a, &ref);
+    counts[a] = ref.num_features;
+    total += ref.num_features;
+    while (b < NUM_BUCKETS && counts[a] > bucket_limits[b])
+      b++;
+    buckets[b]++;
+  }
+  qsort(counts, A, sizeof(int), compare_ints);
+
+  printf("\nFeatures per attribute: min %d, median %d, mean %.2f, max %d\n",
+         A > 0 ? counts[0] : 0, A > 0 ? counts[A / 2] : 0,
+         A > 0 ? (double)total / A : 0.0, A > 0 ? counts[A - 1] : 0);
+  printf("%-10s %10s %7s\n", "features", "attributes", "share");
+  for (int b = 0; b <= NUM_BUCKETS; b++) {
+    char range[32];
+
+    if (b == NUM_BUCKETS)
+      snprintf(range, sizeof(range), "%d+", bucket_limits[b - 1] + 1);
+    else if (b == 0 || bucket_limits[b] == bucket_limits[b - 1] + 1)
+      snprintf(range, sizeof(range), "%d", bucket_limits[b]);
+    else
+      snprintf(range, sizeof(range), "%d-%d", bucket_limits[b - 1] + 1,
+               bucket_limits[b]);
+    printf("%-10s %10d %6.1f%%\n", range, buckets[b],
+           A > 0 ? 100.0 * buckets[b] / A : 0.0);
+  }
+
+  free(counts);
+  return 0;
+}
+
+/* Attributes per feature template; the extension skips empty templates */
+static void print_templates(crf1dm_t *model) {
+  const int A = crf1dm_get_num_attrs(model);
+  int counts[NUM_NAME_TEMPLATES] = {0};
+  int other = 0, disabled = 0;
+
+  if (crf1dm_get_hash_bits(model) > 0) {
+    printf("\nFeature templates: hashed model, all enabled\n");
+    return;
+  }
+  for (int a = 0; a < A; a++) {
+    const char *attr = crf1dm_to_attr(model, a);
+    int t = attr ? name_feature_template(attr) : -1;
+
+    if (t >= 0)
+      counts[t]++;
+    else
+      other++;
+  }
+
+  printf("\n%-16s %10s\n", "template", "attributes");
+  for (int t = 0; t < NUM_NAME_TEMPLATES; t++) {
+    printf("%-16s %10d%s\n", name_template_name(t), counts[t],
+           counts[t] == 0 ? "  (disabled)" : "");
+    disabled += counts[t] == 0;
+  }
+  if (other > 0)
+    printf("%-16s %10d\n", "(no template)", other);
+  printf("%d of %d templates disabled\n", disabled, NUM_NAME_TEMPLATES);
+}
+
+/* Nonzero entries of the L x L transition matrix */
+static void print_transitions(crf1dm_t *model) {
+  const int L = crf1dm_get_num_labels(model);
+  int num_trans = 0, nonzero = 0;
+
+  for (int l = 0; l < L; l++) {
+    feature_refs_t ref;
+
+    crf1dm_get_labelref(model, l, &ref);
+    for (int r = 0; r < ref.num_features; r++) {
+      crf1dm_feature_t f;
+
+      crf1dm_get_feature(model, crf1dm_get_featureid(&ref, r), &f);
+      num_trans++;
+      nonzero += f.weight != 0;
+    }
+  }
+  printf("\nTransition matrix: %d x %d, %d stored, %d nonzero "
+         "(%.1f%% dense)\n",
+         L, L, num_trans, nonzero,
+         L > 0 ? 100.0 * nonzero / ((double)L * L) : 0.0);
+}
+
+/* Estimate the work the tagger does per token on crf_data
+ *
+ * For every attribute of a token, the tagger looks the attribute string up
+ * and, if the model knows it, adds weight * value to the state score of
+ * each of its features. Viterbi then does L * L additions for every token
+ * after the first of a sequence.
+ */
+static int print_token_costs(crf1dm_t *model, crfsuite_data_t *crf_data) {
+  const int L = crf1dm_get_num_labels(model);
+  int num = crf_data->attrs->num(crf_data->attrs);
+  int *map = malloc((num > 0 ? num : 1) * sizeof(int));
+  long long tokens = 0, lookups = 0, found = 0, state_ops = 0, trans_ops = 0;
+  double t;
+
+  if (!map) {
+    fprintf(stderr, "Error: Out of memory\n");
+    return -1;
+  }
+  for (int i = 0; i < num; i++) {
+    const char *str = NULL;
+
+    crf_data->attrs->to_string(crf_data->attrs, i, &str);
+    map[i] = str ? crf1dm_to_aid(model, str) : -1;
+    crf_data->attrs->free(crf_data->attrs, str);
+  }
+
+  for (int i = 0; i < crf_data->num_instances; i++) {
+    crfsuite_instance_t *inst = &crf_data->instances[i];
+
+    tokens += inst->num_items;
+    if (inst->num_items > 1)
+      trans_ops += (long long)(inst->num_items - 1) * L * L;
+    for (int t = 0; t < inst->num_items; t++) {
+      crfsuite_item_t *item = &inst->items[t];
+
+      lookups += item->num_contents;
+      for (int c = 0; c < item->num_contents; c++) {
+        int aid = map[item->contents[c].aid];
+        feature_refs_t ref;
+
+        if (aid < 0)
+          continue;
+        found++;
+        crf1dm_get_attrref(model, aid, &ref);
+        state_ops += ref.num_features;
+      }
+    }
+  }
+  free(map);
+
+  t = tokens > 0 ? (double)tokens : 1;
+  printf("\nPer token on %d sequences (%lld tokens):\n",
+         crf_data->num_instances, tokens);
+  printf("  %-26s %10.2f\n", "attribute lookups", lookups / t);
+  printf("  %-26s %10.2f (%.1f%%)\n", "attributes in the model", found / t,
+         lookups > 0 ? 100.0 * found / lookups : 0.0);
+  printf("  %-26s %10.2f\n", "state multiply-adds", state_ops / t);
+  printf("  %-26s %10.2f\n", "transition adds (Viterbi)", trans_ops / t);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  const char *model_file;
+  crf1dm_t *model;
+  TrainingData *data = NULL;
+  crfsuite_data_t crf_data;
+  int dump = 0, num_state = 0, ret = 1;
+  long long total;
+
+  static struct option long_options[] = {{"dump", no_argument, 0, 'd'},
+                                         {"help", no_argument, 0, 'h'},
+                                         {0, 0, 0, 0}};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "dh", long_options, NULL)) != -1) {
+    switch (opt) {
+    case 'd':
+      dump = 1;
+      break;
+    case 'h':
+      print_usage(argv[0]);
+      return 0;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc - optind < 1) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  model_file = argv[optind];
+
+  memset(&crf_data, 0, sizeof(crf_data));
+
+  model = crf1dm_new(model_file);
+  if (!model) {
+    fprintf(stderr, "Error: Could not load model: %s\n", model_file);
+    return 1;
+  }
+
+  for (int a = 0; a < crf1dm_get_num_attrs(model); a++) {
+    feature_refs_t ref;
+
+    crf1dm_get_attrref(model, a, &ref);
+    num_state += ref.num_features;
+  }
+
+  total = file_size(model_file);
+
+  printf("Model: %s\n", model_file);
+  printf("  version %d, %lld bytes", crf1dm_get_version(model), total);
+  if (crf1dm_get_hash_bits(model) > 0)
+    printf(", attributes hashed to %d bits", crf1dm_get_hash_bits(model));
+  printf("\n  %d labels, %d attributes, %d features (%d state, %d "
+         "transition)\n",
+         crf1dm_get_num_labels(model), crf1dm_get_num_attrs(model),
+         crf1dm_get_num_features(model), num_state,
+         crf1dm_get_num_features(model) - num_state);
+
+  print_sections(model, total);
+  if (print_attribute_features(model) != 0)
+    goto cleanup;
+  print_templates(model);
+  print_transitions(model);
+
+  if (optind + 1 < argc) {
+    data = parse_training_files(&argv[optind + 1], argc - optind - 1);
+    if (!data || build_crf_data(data, &crf_data, 0) != 0 ||
+        print_token_costs(model, &crf_data) != 0)
+      goto cleanup;
+  }
+
+  if (dump) {
+    printf("\n");
+    crf1dm_dump(model, stdout);
+  }
+  ret = 0;
+
+cleanup:
+  if (data) {
+    free_crf_data(&crf_data);
+    free_training_data(data);
+  }
+  crf1dm_close(model);
+  return ret;
+}
@@ -1,4 +1,5 @@
 /* tools/train_model.c - Standalone CRF training tool */
+#include "../src/crf_cross_validation.h"
 #include "../src/crf_trainer.h"
 #include "../src/training_data_parser.h"
 
@@ -6,6 +7,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/* Limits for --grid */
+#define MAX_GRID_AXES 4
+#define MAX_GRID_VALUES 16
 
 static void print_usage(const char *prog) {
   printf("Usage: %s [OPTIONS] <input_file> -o <output_file>\n", prog);
@@ -16,10 +23,40 @@ static void print_usage(const char *prog) {
   printf("  -p, --person FILE      Person training data (for generic model)\n");
   printf(
       "  -c, --company FILE     Company training data (for generic model)\n");
+  printf("  --c1 VALUE             L1 regularization coefficient (default: "
+         "0); a\n"
+         "                         positive value trains a sparse model with "
+         "OWL-QN\n");
   printf("  --c2 VALUE             L2 regularization coefficient (default: "
          "1.0)\n");
   printf("  --max-iter VALUE       Maximum iterations (default: 100)\n");
   printf("  --epsilon VALUE        Convergence threshold (default: 0.0001)\n");
+  printf("  --hash-bits K          Hash attributes into 2^K IDs and save a v2 "
+         "model\n"
+         "                         without attribute strings (default: off)\n");
+  printf("  --profile FILE         Attribute profile from "
+         "dump_attribute_profile(); only\n"
+         "                         attributes that fired are trained\n");
+  printf("  --min-hits N           Hits an attribute needs in the profile "
+         "(default: 1)\n");
+  printf("  --keep-duplicates      Train on every sequence instead of "
+         "collapsing\n"
+         "                         identical ones into weighted instances\n");
+  printf("  --collapse-duplicates  Also collapse them for L2SGD, which then "
+         "learns a\n"
+         "                         slightly different model (OWL-QN always "
+         "does)\n");
+  printf("  --threads N            Threads for data conversion (default: one "
+         "per CPU)\n");
+  printf("  --cv K                 K-fold cross-validation; -o then saves a "
+         "model\n"
+         "                         trained with the best configuration\n");
+  printf("  --grid KEY=V1,V2,...   Values to sweep during cross-validation "
+         "(keys:\n"
+         "                         c1, c2, max_iter, hash_bits); may be "
+         "repeated\n");
+  printf("  --parse-only           Only parse the input and report reader "
+         "throughput\n");
   printf("  -v, --verbose          Verbose output\n");
   printf("  -h, --help             Show this help\n");
   printf("\nExamples:\n");
@@ -30,6 +67,119 @@ static void print_usage(const char *prog) {
          "name_data/company_labeled.xml -o "
          "include/generic_learned_settings.crfsuite\n",
          prog);
+  printf("  %s name_data/person_labeled.xml --cv 5 --grid c2=0.1,1,10 -o "
+         "person.crfsuite\n",
+         prog);
+}
+
+/* Values of one hyperparameter to sweep */
+typedef struct {
+  char key[32];
+  double values[MAX_GRID_VALUES];
+  int num_values;
+} GridAxis;
+
+/* Parse "key=v1,v2,..." into axis */
+static int parse_grid_axis(const char *spec, GridAxis *axis) {
+  const char *eq = strchr(spec, '=');
+
+  if (!eq || eq == spec || (size_t)(eq - spec) >= sizeof(axis->key))
+    return -1;
+  memcpy(axis->key, spec, eq - spec);
+  axis->key[eq - spec] = '\0';
+  if (strcmp(axis->key, "max-iter") == 0)
+    strcpy(axis->key, "max_iter");
+  if (strcmp(axis->key, "hash-bits") == 0)
+    strcpy(axis->key, "hash_bits");
+  if (strcmp(axis->key, "c1") != 0 && strcmp(axis->key, "c2") != 0 &&
+      strcmp(axis->key, "max_iter") != 0 &&
+      strcmp(axis->key, "hash_bits") != 0)
+    return -1;
+
+  axis->num_values = 0;
+  const char *p = eq + 1;
+  while (*p) {
+    char *end;
+    double value = strtod(p, &end);
+
+    if (end == p || (*end != ',' && *end != '\0') ||
+        axis->num_values >= MAX_GRID_VALUES)
+      return -1;
+    axis->values[axis->num_values++] = value;
+    p = (*end == ',') ? end + 1 : end;
+  }
+  return axis->num_values > 0 ? 0 : -1;
+}
+
+/* Expand the grid axes into one TrainingConfig per combination */
+static TrainingConfig *expand_grid(TrainingConfig *base, GridAxis *axes,
+                                   int num_axes, int *num_points) {
+  int n = 1;
+  for (int a = 0; a < num_axes; a++)
+    n *= axes[a].num_values;
+
+  TrainingConfig *grid = malloc(n * sizeof(TrainingConfig));
+  if (!grid)
+    return NULL;
+
+  for (int i = 0; i < n; i++) {
+    int rest = i;
+
+    grid[i] = *base;
+    /* The last axis varies fastest */
+    for (int a = num_axes - 1; a >= 0; a--) {
+      double value = axes[a].values[rest % axes[a].num_values];
+
+      rest /= axes[a].num_values;
+      if (strcmp(axes[a].key, "c1") == 0)
+        grid[i].c1 = value;
+      else if (strcmp(axes[a].key, "c2") == 0)
+        grid[i].c2 = value;
+      else if (strcmp(axes[a].key, "hash_bits") == 0)
+        grid[i].hash_bits = (int)value;
+      else
+        grid[i].max_iterations = (int)value;
+    }
+  }
+  *num_points = n;
+  return grid;
+}
+
+/* Parse the given files and report reader throughput and peak memory */
+static int run_parse_benchmark(char **files, int num_files, int verbose) {
+  struct timespec start, end;
+  TrainingData *data = NULL;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  data = parse_training_files(files, num_files);
+  if (!data)
+    return 1;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds =
+      (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  double megabytes = data->input_bytes / (1024.0 * 1024.0);
+  long total_tokens = 0;
+  struct rusage usage;
+
+  for (int i = 0; i < data->num_sequences; i++)
+    total_tokens += data->sequences[i].num_tokens;
+  getrusage(RUSAGE_SELF, &usage);
+
+  if (verbose) {
+    print_training_summary(data);
+    printf("\n");
+  }
+
+  printf("Parsed %.1f MB in %.3f s (%.1f MB/s)\n", megabytes, seconds,
+         seconds > 0 ? megabytes / seconds : 0.0);
+  printf("  Sequences: %d\n", data->num_sequences);
+  printf("  Tokens: %ld\n", total_tokens);
+  printf("  Arena memory: %.1f MB\n", data->arena_bytes / (1024.0 * 1024.0));
+  printf("  Peak RSS: %.1f MB\n", usage.ru_maxrss / 1024.0);
+
+  free_training_data(data);
+  return 0;
 }
 
 int main(int argc, char *argv[]) {
@@ -39,6 +189,10 @@ int main(int argc, char *argv[]) {
   char *company_file = NULL;
   char *model_type = "person";
   int verbose = 0;
+  int parse_only = 0;
+  int cv_folds = 0;
+  GridAxis grid_axes[MAX_GRID_AXES];
+  int num_grid_axes = 0;
   TrainingConfig config;
 
   init_training_config(&config);
@@ -51,6 +205,16 @@ int main(int argc, char *argv[]) {
       {"c2", required_argument, 0, 1001},
       {"max-iter", required_argument, 0, 1002},
       {"epsilon", required_argument, 0, 1003},
+      {"parse-only", no_argument, 0, 1004},
+      {"threads", required_argument, 0, 1005},
+      {"cv", required_argument, 0, 1006},
+      {"grid", required_argument, 0, 1007},
+      {"c1", required_argument, 0, 1008},
+      {"hash-bits", required_argument, 0, 1009},
+      {"profile", required_argument, 0, 1010},
+      {"min-hits", required_argument, 0, 1011},
+      {"keep-duplicates", no_argument, 0, 1012},
+      {"collapse-duplicates", no_argument, 0, 1013},
       {"verbose", no_argument, 0, 'v'},
       {"help", no_argument, 0, 'h'},
       {0, 0, 0, 0}};
@@ -80,6 +244,41 @@ int main(int argc, char *argv[]) {
     case 1003:
       config.epsilon = atof(optarg);
       break;
+    case 1004:
+      parse_only = 1;
+      break;
+    case 1005:
+      config.num_threads = atoi(optarg);
+      break;
+    case 1006:
+      cv_folds = atoi(optarg);
+      break;
+    case 1007:
+      if (num_grid_axes >= MAX_GRID_AXES ||
+          parse_grid_axis(optarg, &grid_axes[num_grid_axes]) != 0) {
+        fprintf(stderr, "Error: Invalid --grid specification: %s\n", optarg);
+        return 1;
+      }
+      num_grid_axes++;
+      break;
+    case 1008:
+      config.c1 = atof(optarg);
+      break;
+    case 1009:
+      config.hash_bits = atoi(optarg);
+      break;
+    case 1010:
+      config.profile_file = optarg;
+      break;
+    case 1011:
+      config.min_hits = strtoul(optarg, NULL, 10);
+      break;
+    case 1012:
+      config.keep_duplicates = true;
+      break;
+    case 1013:
+      config.collapse_duplicates = true;
+      break;
     case 'v':
       verbose = 1;
       break;
@@ -97,6 +296,70 @@ int main(int argc, char *argv[]) {
     input_file = argv[optind];
   }
 
+  if (parse_only) {
+    char *files[2];
+    int num_files = 0;
+
+    if (strcmp(model_type, "generic") == 0) {
+      if (person_file)
+        files[num_files++] = person_file;
+      if (company_file)
+        files[num_files++] = company_file;
+    } else if (input_file) {
+      files[num_files++] = input_file;
+    }
+    if (num_files == 0) {
+      fprintf(stderr, "Error: Input file is required\n");
+      print_usage(argv[0]);
+      return 1;
+    }
+    return run_parse_benchmark(files, num_files, verbose);
+  }
+
+  if (num_grid_axes > 0 && cv_folds == 0) {
+    fprintf(stderr, "Error: --grid requires --cv\n");
+    return 1;
+  }
+
+  if (cv_folds != 0) {
+    TrainingData *data;
+    TrainingConfig *grid;
+    int num_points;
+
+    if (strcmp(model_type, "generic") == 0) {
+      if (!person_file || !company_file) {
+        fprintf(stderr,
+                "Error: Generic model requires both -p and -c options\n");
+        return 1;
+      }
+      data = load_generic_training_data(person_file, company_file);
+    } else {
+      if (!input_file) {
+        fprintf(stderr, "Error: Input file is required\n");
+        print_usage(argv[0]);
+        return 1;
+      }
+      data = parse_training_file(input_file);
+    }
+    if (!data) {
+      fprintf(stderr, "Error: Failed to parse training file\n");
+      return 1;
+    }
+
+    grid = expand_grid(&config, grid_axes, num_grid_axes, &num_points);
+    if (!grid) {
+      fprintf(stderr, "Error: Out of memory\n");
+      free_training_data(data);
+      return 1;
+    }
+
+    int ret = cross_validate_crf_model(data, cv_folds, grid, num_points,
+                                       config.num_threads, output_file);
+    free(grid);
+    free_training_data(data);
+    return ret == 0 ? 0 : 1;
+  }
+
   /* Validate arguments */
   if (!output_file) {
     fprintf(stderr, "Error: Output file is required (-o)\n");